@@ -483,6 +483,9 @@ void __init twl4030_mmc_init(struct twl4030_hsmmc_info *controllers)
 		if (c->power_saving)
 			mmc->slots[0].power_saving = 1;
 
+		if (c->ddr)
+			mmc->slots[0].ddr = 1;
+
 		/* NOTE:  MMC slots should have a Vcc regulator set up.
 		 * This may be from a TWL4030-family chip, another
 		 * controllable regulator, or a fixed supply.
@@ -93,6 +93,9 @@ struct omap_mmc_platform_data {
 		/* nonremovable e.g. eMMC */
 		unsigned nonremovable:1;
 
+		/* eMMC dual data rate, needs the DDR bit in CON (OMAP4) */
+		unsigned ddr:1;
+
 		/* Try to sleep or power off when possible */
 		unsigned power_saving:1;
 
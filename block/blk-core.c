@@ -127,6 +127,8 @@ void blk_rq_init(struct request_queue *q, struct request *rq)
 	rq->tag = -1;
 	rq->ref_count = 1;
 	rq->start_time = jiffies;
+	if (q && blk_queue_lat_stat(q))
+		rq->start_time_ns = blk_lat_clock();
 }
 EXPORT_SYMBOL(blk_rq_init);
 
@@ -510,6 +512,14 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 		return NULL;
 	}
 
+	q->comp_stats = alloc_percpu(struct blk_comp_stats);
+	if (!q->comp_stats) {
+		bdi_destroy(&q->backing_dev_info);
+		kmem_cache_free(blk_requestq_cachep, q);
+		return NULL;
+	}
+	q->comp_ipi_max_ns = BLK_COMP_IPI_MAX_NS;
+
 	init_timer(&q->unplug_timer);
 	setup_timer(&q->timeout, blk_rq_timed_out_timer, (unsigned long) q);
 	INIT_LIST_HEAD(&q->timeout_list);
@@ -573,6 +583,7 @@ blk_init_queue_node(request_fn_proc *rfn, spinlock_t *lock, int node_id)
 
 	q->node = node_id;
 	if (blk_init_free_list(q)) {
+		free_percpu(q->comp_stats);
 		kmem_cache_free(blk_requestq_cachep, q);
 		return NULL;
 	}
@@ -1123,6 +1134,8 @@ void init_request_from_bio(struct request *req, struct bio *bio)
 
 	if (unlikely(bio_rw_flagged(bio, BIO_RW_DISCARD))) {
 		req->cmd_flags |= REQ_DISCARD;
+		if (bio_rw_flagged(bio, BIO_RW_SECURE))
+			req->cmd_flags |= REQ_SECURE;
 		if (bio_rw_flagged(bio, BIO_RW_BARRIER))
 			req->cmd_flags |= REQ_SOFTBARRIER;
 	} else if (unlikely(bio_rw_flagged(bio, BIO_RW_BARRIER)))
@@ -1267,7 +1280,7 @@ get_rq:
 	spin_lock_irq(q->queue_lock);
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
 	    bio_flagged(bio, BIO_CPU_AFFINE))
-		req->cpu = blk_cpu_to_group(smp_processor_id());
+		req->cpu = smp_processor_id();
 	if (queue_should_plug(q) && elv_queue_empty(q))
 		blk_plug_device(q);
 	add_request(q, req);
@@ -1476,6 +1489,12 @@ static inline void __generic_make_request(struct bio *bio)
 			goto end_io;
 		}
 
+		if (bio_rw_flagged(bio, BIO_RW_SECURE) &&
+		    !blk_queue_secdiscard(q)) {
+			err = -EOPNOTSUPP;
+			goto end_io;
+		}
+
 		trace_block_bio_queue(q, bio);
 
 		ret = q->make_request_fn(q, bio);
@@ -1745,6 +1764,41 @@ static void blk_account_io_done(struct request *req)
 	}
 }
 
+static int blk_lat_bucket(u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	if (us >= 1ULL << (BLK_LAT_BUCKETS - 2))
+		return BLK_LAT_BUCKETS - 1;
+	return fls((u32) us);
+}
+
+static void blk_account_io_latency(struct request *req)
+{
+	struct blk_lat_stats *stats = &req->q->lat_stats;
+	int type;
+
+	/*
+	 * Only requests that were allocated and started with the
+	 * histograms enabled have both timestamps.
+	 */
+	if (!req->start_time_ns || !req->io_start_time_ns ||
+	    req == &req->q->bar_rq)
+		return;
+
+	if (rq_data_dir(req) == READ)
+		type = BLK_LAT_READ;
+	else if (rq_is_sync(req))
+		type = BLK_LAT_SYNC_WRITE;
+	else
+		type = BLK_LAT_WRITE;
+
+	stats->queue[type][blk_lat_bucket(req->io_start_time_ns -
+					  req->start_time_ns)]++;
+	stats->service[type][blk_lat_bucket(blk_lat_clock() -
+					    req->io_start_time_ns)]++;
+}
+
 /**
  * blk_peek_request - peek at the top of a request queue
  * @q: request queue to peek at
@@ -1896,6 +1950,9 @@ void blk_start_request(struct request *req)
 	if (unlikely(blk_bidi_rq(req)))
 		req->next_rq->resid_len = blk_rq_bytes(req->next_rq);
 
+	if (req->start_time_ns)
+		req->io_start_time_ns = blk_lat_clock();
+
 	blk_add_timer(req);
 }
 EXPORT_SYMBOL(blk_start_request);
@@ -2115,6 +2172,7 @@ static void blk_finish_request(struct request *req, int error)
 	blk_delete_timer(req);
 
 	blk_account_io_done(req);
+	blk_account_io_latency(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -2406,6 +2464,49 @@ int blk_lld_busy(struct request_queue *q)
 }
 EXPORT_SYMBOL_GPL(blk_lld_busy);
 
+/**
+ * blk_poll - spin for an I/O completion instead of sleeping for it
+ * @q : the queue the I/O was submitted to
+ * @done : returns non-zero once the caller's I/O has completed
+ * @data : passed to @done
+ *
+ * Description:
+ *    For fast devices the wakeup and context switch after the completion
+ *    interrupt can take longer than the I/O itself.  If polling has been
+ *    enabled on @q, this calls the driver's poll function, if it set one
+ *    with blk_queue_poll_fn(), until @done returns true or io_poll_usecs
+ *    have passed.  Must be called from process context, after the I/O
+ *    has been unplugged.
+ *
+ * Return:
+ *    1 - The I/O completed while polling
+ *    0 - Polling is off or gave up, the caller has to sleep
+ */
+int blk_poll(struct request_queue *q, int (*done)(void *), void *data)
+{
+	u64 end;
+
+	if (!blk_queue_poll(q))
+		return 0;
+
+	end = blk_lat_clock() + (u64) q->poll_usecs * NSEC_PER_USEC;
+	do {
+		if (q->poll_fn)
+			q->poll_fn(q);
+		if (done(data)) {
+			atomic_long_inc(&q->poll_hits);
+			return 1;
+		}
+		if (need_resched())
+			break;
+		cpu_relax();
+	} while (blk_lat_clock() < end);
+
+	atomic_long_inc(&q->poll_misses);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_poll);
+
 /**
  * blk_rq_unprep_clone - Helper function to free all bios in a cloned request
  * @rq: the clone request to be cleaned up
@@ -366,6 +366,14 @@ static int attempt_merge(struct request_queue *q, struct request *req,
 	if (!rq_mergeable(req) || !rq_mergeable(next))
 		return 0;
 
+	/*
+	 * Don't merge file system requests and discard requests, nor
+	 * discard requests and secure discard requests
+	 */
+	if ((req->cmd_flags & (REQ_DISCARD | REQ_SECURE)) !=
+	    (next->cmd_flags & (REQ_DISCARD | REQ_SECURE)))
+		return 0;
+
 	/*
 	 * not contiguous
 	 */
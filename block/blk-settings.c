@@ -80,6 +80,20 @@ void blk_queue_lld_busy(struct request_queue *q, lld_busy_fn *fn)
 }
 EXPORT_SYMBOL_GPL(blk_queue_lld_busy);
 
+/**
+ * blk_queue_poll_fn - set driver completion polling function
+ * @q:		queue
+ * @fn:		reaps completed requests, returns how many it found
+ *
+ * Called by blk_poll() from process context without the queue lock
+ * held, possibly on several CPUs at once.
+ */
+void blk_queue_poll_fn(struct request_queue *q, poll_fn *fn)
+{
+	q->poll_fn = fn;
+}
+EXPORT_SYMBOL_GPL(blk_queue_poll_fn);
+
 /**
  * blk_set_default_limits - reset limits to default values
  * @lim:  the queue_limits structure to reset
@@ -144,6 +158,7 @@ void blk_queue_make_request(struct request_queue *q, make_request_fn *mfn)
 	blk_queue_dma_alignment(q, 511);
 	blk_queue_congestion_threshold(q);
 	q->nr_batching = BLK_BATCH_REQ;
+	q->poll_usecs = BLK_POLL_USECS;
 
 	q->unplug_thresh = 4;		/* hmm */
 	q->unplug_delay = msecs_to_jiffies(3);	/* 3 milliseconds */
@@ -36,12 +36,33 @@ static void blk_done_softirq(struct softirq_action *h)
 }
 
 #if defined(CONFIG_SMP) && defined(CONFIG_USE_GENERIC_SMP_HELPERS)
+/*
+ * Fold the delivery time of a completion IPI into the queue's running
+ * average.  Several CPUs may do this at once without any locking, the
+ * result only has to be good enough to pick a completion policy.
+ */
+static void blk_comp_ipi_sample(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	u64 ns = blk_lat_clock() - rq->ipi_time_ns;
+	unsigned long avg = q->comp_ipi_ns;
+
+	if (ns > NSEC_PER_SEC)
+		ns = NSEC_PER_SEC;
+
+	q->comp_ipi_ns = avg - avg / 8 + (unsigned long) ns / 8;
+	rq->ipi_time_ns = 0;
+}
+
 static void trigger_softirq(void *data)
 {
 	struct request *rq = data;
 	unsigned long flags;
 	struct list_head *list;
 
+	if (rq->ipi_time_ns)
+		blk_comp_ipi_sample(rq);
+
 	local_irq_save(flags);
 	list = &__get_cpu_var(blk_cpu_done);
 	list_add_tail(&rq->csd.list, list);
@@ -64,6 +85,9 @@ static int raise_blk_irq(int cpu, struct request *rq)
 		data->info = rq;
 		data->flags = 0;
 
+		if (test_bit(QUEUE_FLAG_SAME_ADAPT, &rq->q->queue_flags))
+			rq->ipi_time_ns = blk_lat_clock();
+
 		__smp_call_function_single(cpu, data, 0);
 		return 0;
 	}
@@ -101,29 +125,53 @@ static struct notifier_block __cpuinitdata blk_cpu_notifier = {
 	.notifier_call	= blk_cpu_notify,
 };
 
+/*
+ * Whether a completion has to run on the exact CPU that submitted the
+ * request, rather than anywhere in that CPU's group.  Adaptive mode does
+ * so while IPIs are cheap, and sends every BLK_COMP_SAMPLE'th completion
+ * regardless so that the average notices when they get cheap again.
+ */
+#define BLK_COMP_SAMPLE		64
+
+static int blk_comp_force(struct request_queue *q,
+			  struct blk_comp_stats *stats)
+{
+	if (test_bit(QUEUE_FLAG_SAME_FORCE, &q->queue_flags))
+		return 1;
+	if (!test_bit(QUEUE_FLAG_SAME_ADAPT, &q->queue_flags))
+		return 0;
+
+	return q->comp_ipi_ns <= q->comp_ipi_max_ns ||
+		!((stats->local + stats->remote) % BLK_COMP_SAMPLE);
+}
+
 void __blk_complete_request(struct request *req)
 {
 	struct request_queue *q = req->q;
+	struct blk_comp_stats *stats;
 	unsigned long flags;
-	int ccpu, cpu, group_cpu;
+	int ccpu, cpu, force = 0;
 
 	BUG_ON(!q->softirq_done_fn);
 
 	local_irq_save(flags);
 	cpu = smp_processor_id();
-	group_cpu = blk_cpu_to_group(cpu);
+	stats = per_cpu_ptr(q->comp_stats, cpu);
 
 	/*
 	 * Select completion CPU
 	 */
-	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) && req->cpu != -1)
+	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) && req->cpu != -1) {
 		ccpu = req->cpu;
-	else
+		force = blk_comp_force(q, stats);
+	} else
 		ccpu = cpu;
 
-	if (ccpu == cpu || ccpu == group_cpu) {
+	if (ccpu == cpu ||
+	    (!force && blk_cpu_to_group(ccpu) == blk_cpu_to_group(cpu))) {
 		struct list_head *list;
 do_local:
+		stats->local++;
 		list = &__get_cpu_var(blk_cpu_done);
 		list_add_tail(&req->csd.list, list);
 
@@ -137,6 +185,8 @@ do_local:
 			raise_softirq_irqoff(BLOCK_SOFTIRQ);
 	} else if (raise_blk_irq(ccpu, req))
 		goto do_local;
+	else
+		stats->remote++;
 
 	local_irq_restore(flags);
 }
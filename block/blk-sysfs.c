@@ -210,9 +210,16 @@ static ssize_t queue_nomerges_store(struct request_queue *q, const char *page,
 
 static ssize_t queue_rq_affinity_show(struct request_queue *q, char *page)
 {
-	bool set = test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags);
+	unsigned long val = 0;
 
-	return queue_var_show(set, page);
+	if (test_bit(QUEUE_FLAG_SAME_ADAPT, &q->queue_flags))
+		val = 3;
+	else if (test_bit(QUEUE_FLAG_SAME_FORCE, &q->queue_flags))
+		val = 2;
+	else if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags))
+		val = 1;
+
+	return queue_var_show(val, page);
 }
 
 static ssize_t
@@ -223,16 +230,63 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 	unsigned long val;
 
 	ret = queue_var_store(&val, page, count);
+	if (val > 3)
+		return -EINVAL;
+
 	spin_lock_irq(q->queue_lock);
 	if (val)
 		queue_flag_set(QUEUE_FLAG_SAME_COMP, q);
 	else
 		queue_flag_clear(QUEUE_FLAG_SAME_COMP,  q);
+	if (val == 2)
+		queue_flag_set(QUEUE_FLAG_SAME_FORCE, q);
+	else
+		queue_flag_clear(QUEUE_FLAG_SAME_FORCE, q);
+	if (val == 3)
+		queue_flag_set(QUEUE_FLAG_SAME_ADAPT, q);
+	else
+		queue_flag_clear(QUEUE_FLAG_SAME_ADAPT, q);
 	spin_unlock_irq(q->queue_lock);
 #endif
 	return ret;
 }
 
+static ssize_t queue_rq_affinity_ipi_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->comp_ipi_max_ns, page);
+}
+
+static ssize_t
+queue_rq_affinity_ipi_store(struct request_queue *q, const char *page,
+			    size_t count)
+{
+	unsigned long ns;
+	ssize_t ret = queue_var_store(&ns, page, count);
+
+	if (ns > NSEC_PER_SEC)
+		return -EINVAL;
+
+	q->comp_ipi_max_ns = ns;
+	return ret;
+}
+
+static ssize_t queue_rq_affinity_stats_show(struct request_queue *q,
+					    char *page)
+{
+	unsigned long local = 0, remote = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct blk_comp_stats *stats = per_cpu_ptr(q->comp_stats, cpu);
+
+		local += stats->local;
+		remote += stats->remote;
+	}
+
+	return sprintf(page, "local %lu\nremote %lu\nipi_ns %lu\n",
+		       local, remote, q->comp_ipi_ns);
+}
+
 static ssize_t queue_iostats_show(struct request_queue *q, char *page)
 {
 	return queue_var_show(blk_queue_io_stat(q), page);
@@ -254,6 +308,115 @@ static ssize_t queue_iostats_store(struct request_queue *q, const char *page,
 	return ret;
 }
 
+static ssize_t queue_lat_stats_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(blk_queue_lat_stat(q), page);
+}
+
+static ssize_t queue_lat_stats_store(struct request_queue *q, const char *page,
+				     size_t count)
+{
+	unsigned long stats;
+	ssize_t ret = queue_var_store(&stats, page, count);
+
+	spin_lock_irq(q->queue_lock);
+	if (stats)
+		queue_flag_set(QUEUE_FLAG_LAT_STAT, q);
+	else
+		queue_flag_clear(QUEUE_FLAG_LAT_STAT, q);
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
+static ssize_t queue_lat_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_lat_stats *stats = &q->lat_stats;
+	ssize_t len;
+	int i, t;
+
+	len = sprintf(page, "%9s %9s %9s %9s %9s %9s %9s\n", "usecs",
+		      "read_q", "read_svc", "write_q", "write_svc",
+		      "sync_q", "sync_svc");
+	for (i = 0; i < BLK_LAT_BUCKETS; i++) {
+		char bound[16];
+
+		if (i < BLK_LAT_BUCKETS - 1)
+			sprintf(bound, "<%lu", 1UL << i);
+		else
+			sprintf(bound, ">=%lu", 1UL << (i - 1));
+		len += sprintf(page + len, "%9s", bound);
+		for (t = 0; t < BLK_LAT_TYPES; t++)
+			len += sprintf(page + len, " %9lu %9lu",
+				       stats->queue[t][i], stats->service[t][i]);
+		len += sprintf(page + len, "\n");
+	}
+
+	return len;
+}
+
+static ssize_t queue_lat_hist_store(struct request_queue *q, const char *page,
+				    size_t count)
+{
+	unsigned long val;
+	ssize_t ret = queue_var_store(&val, page, count);
+
+	if (val)
+		return -EINVAL;
+
+	spin_lock_irq(q->queue_lock);
+	memset(&q->lat_stats, 0, sizeof(q->lat_stats));
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
+static ssize_t queue_poll_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(blk_queue_poll(q), page);
+}
+
+static ssize_t queue_poll_store(struct request_queue *q, const char *page,
+				size_t count)
+{
+	unsigned long poll;
+	ssize_t ret = queue_var_store(&poll, page, count);
+
+	spin_lock_irq(q->queue_lock);
+	if (poll)
+		queue_flag_set(QUEUE_FLAG_POLL, q);
+	else
+		queue_flag_clear(QUEUE_FLAG_POLL, q);
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
+static ssize_t queue_poll_usecs_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->poll_usecs, page);
+}
+
+static ssize_t
+queue_poll_usecs_store(struct request_queue *q, const char *page, size_t count)
+{
+	unsigned long usecs;
+	ssize_t ret = queue_var_store(&usecs, page, count);
+
+	if (usecs > USEC_PER_SEC)
+		return -EINVAL;
+
+	q->poll_usecs = usecs;
+	return ret;
+}
+
+static ssize_t queue_poll_stats_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "polled %lu\nslept %lu\n",
+		       atomic_long_read(&q->poll_hits),
+		       atomic_long_read(&q->poll_misses));
+}
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -341,12 +504,52 @@ static struct queue_sysfs_entry queue_rq_affinity_entry = {
 	.store = queue_rq_affinity_store,
 };
 
+static struct queue_sysfs_entry queue_rq_affinity_ipi_entry = {
+	.attr = {.name = "rq_affinity_ipi_max_ns", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_rq_affinity_ipi_show,
+	.store = queue_rq_affinity_ipi_store,
+};
+
+static struct queue_sysfs_entry queue_rq_affinity_stats_entry = {
+	.attr = {.name = "rq_affinity_stats", .mode = S_IRUGO },
+	.show = queue_rq_affinity_stats_show,
+};
+
 static struct queue_sysfs_entry queue_iostats_entry = {
 	.attr = {.name = "iostats", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_iostats_show,
 	.store = queue_iostats_store,
 };
 
+static struct queue_sysfs_entry queue_lat_stats_entry = {
+	.attr = {.name = "latency_stats", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_lat_stats_show,
+	.store = queue_lat_stats_store,
+};
+
+static struct queue_sysfs_entry queue_lat_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_lat_hist_show,
+	.store = queue_lat_hist_store,
+};
+
+static struct queue_sysfs_entry queue_poll_entry = {
+	.attr = {.name = "io_poll", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_poll_show,
+	.store = queue_poll_store,
+};
+
+static struct queue_sysfs_entry queue_poll_usecs_entry = {
+	.attr = {.name = "io_poll_usecs", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_poll_usecs_show,
+	.store = queue_poll_usecs_store,
+};
+
+static struct queue_sysfs_entry queue_poll_stats_entry = {
+	.attr = {.name = "io_poll_stats", .mode = S_IRUGO },
+	.show = queue_poll_stats_show,
+};
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -364,7 +567,14 @@ static struct attribute *default_attrs[] = {
 	&queue_nonrot_entry.attr,
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
+	&queue_rq_affinity_ipi_entry.attr,
+	&queue_rq_affinity_stats_entry.attr,
 	&queue_iostats_entry.attr,
+	&queue_lat_stats_entry.attr,
+	&queue_lat_hist_entry.attr,
+	&queue_poll_entry.attr,
+	&queue_poll_usecs_entry.attr,
+	&queue_poll_stats_entry.attr,
 	NULL,
 };
 
@@ -443,6 +653,7 @@ static void blk_release_queue(struct kobject *kobj)
 
 	blk_trace_shutdown(q);
 
+	free_percpu(q->comp_stats);
 	bdi_destroy(&q->backing_dev_info);
 	kmem_cache_free(blk_requestq_cachep, q);
 }
@@ -7,6 +7,15 @@
 /* Number of requests a "batching" process may submit */
 #define BLK_BATCH_REQ	32
 
+/* Default time blk_poll() spins before the caller goes to sleep */
+#define BLK_POLL_USECS	20
+
+/*
+ * Adaptive rq_affinity completes on the exact submitting CPU while
+ * completion IPIs take less than this on average, by default
+ */
+#define BLK_COMP_IPI_MAX_NS	10000
+
 extern struct kmem_cache *blk_requestq_cachep;
 extern struct kobj_type blk_queue_ktype;
 
@@ -18,6 +27,11 @@ int blk_rq_append_bio(struct request_queue *q, struct request *rq,
 void blk_dequeue_request(struct request *rq);
 void __blk_queue_free_tags(struct request_queue *q);
 
+static inline u64 blk_lat_clock(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
 void blk_unplug_work(struct work_struct *work);
 void blk_unplug_timeout(unsigned long data);
 void blk_rq_timed_out_timer(unsigned long data);
@@ -0,0 +1,433 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  A deadline variant for devices without seek costs, such as eMMC and
+ *  SD cards.  Requests are served in arrival order from separate read
+ *  and write FIFOs, reads are preferred, and writes are dispatched in
+ *  batches that stay within one erase block.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int read_expire = HZ / 2;  /* max time before a read is submitted. */
+static const int write_expire = 5 * HZ; /* ditto for writes, these limits are SOFT! */
+static const int writes_starved = 2;    /* max times reads can starve a write */
+static const int write_batch = 16;      /* max writes dispatched per erase block */
+
+/* erase block size used when neither the tunable nor the queue has one */
+#define FLASH_ERASE_BLOCK_KB	512
+
+/*
+ * Latency histogram buckets, in microseconds.  Bucket 0 counts requests
+ * completed in under 64us, each following one covers twice the range of
+ * the one before, the last one everything from about a second up.
+ */
+#define FLASH_LAT_SHIFT		6
+#define FLASH_LAT_BUCKETS	16
+
+/*
+ * Time the request entered the scheduler, in microseconds.  Only the
+ * difference to the completion time is used, so the value may wrap.
+ */
+#define RQ_QUEUED_US(rq)	((unsigned long) (rq)->elevator_private)
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on fifo_list only, in arrival order
+	 */
+	struct list_head fifo_list[2];
+
+	sector_t batch_block;		/* erase block of the write batch */
+	unsigned int batching;		/* writes dispatched in this batch */
+	unsigned int starved;		/* times reads have starved writes */
+
+	/* completion latencies, see FLASH_LAT_SHIFT */
+	unsigned long lat_hist[2][FLASH_LAT_BUCKETS];
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int write_batch;
+	int writes_starved;
+	int erase_block_kb;
+};
+
+static inline unsigned long flash_now_us(void)
+{
+	return (unsigned long) ktime_to_us(ktime_get());
+}
+
+/*
+ * erase block size in sectors.  A zero erase_block_kb picks up the
+ * discard granularity of the queue, which block drivers for flash set
+ * to the erase size.
+ */
+static unsigned int flash_erase_sectors(struct flash_data *fd,
+					struct request_queue *q)
+{
+	if (fd->erase_block_kb > 0)
+		return fd->erase_block_kb << 1;
+	if (q->limits.discard_granularity)
+		return q->limits.discard_granularity >> 9;
+	return FLASH_ERASE_BLOCK_KB << 1;
+}
+
+static sector_t flash_erase_block(struct flash_data *fd, struct request *rq)
+{
+	sector_t block = blk_rq_pos(rq);
+
+	sector_div(block, flash_erase_sectors(fd, rq->q));
+	return block;
+}
+
+/*
+ * add rq to the fifo of its data direction
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	rq->elevator_private = (void *) flash_now_us();
+
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[data_dir]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[data_dir]);
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+			req->elevator_private = next->elevator_private;
+		}
+	}
+
+	rq_fifo_clear(next);
+}
+
+/*
+ * the neighbours in the fifo are the only merge candidates besides the
+ * back merge hash, there is no sector sorted list to look them up in
+ */
+static struct request *
+flash_former_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (rq->queuelist.prev == &fd->fifo_list[rq_data_dir(rq)])
+		return NULL;
+	return rq_entry_fifo(rq->queuelist.prev);
+}
+
+static struct request *
+flash_latter_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (rq->queuelist.next == &fd->fifo_list[rq_data_dir(rq)])
+		return NULL;
+	return rq_entry_fifo(rq->queuelist.next);
+}
+
+/*
+ * move request from fifo to dispatch queue.
+ */
+static inline void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(rq->q, rq);
+}
+
+/*
+ * flash_check_fifo returns 0 if there are no expired requests on the fifo,
+ * 1 otherwise. Requires !list_empty(&fd->fifo_list[data_dir])
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int ddir)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[ddir].next);
+
+	/*
+	 * rq is expired!
+	 */
+	if (time_after(jiffies, rq_fifo_time(rq)))
+		return 1;
+
+	return 0;
+}
+
+/*
+ * oldest write that starts in the erase block of the current batch
+ */
+static struct request *flash_next_batch_write(struct flash_data *fd)
+{
+	struct request *rq;
+
+	list_for_each_entry(rq, &fd->fifo_list[WRITE], queuelist) {
+		if (flash_erase_block(fd, rq) == fd->batch_block)
+			return rq;
+	}
+
+	return NULL;
+}
+
+/*
+ * flash_dispatch_requests picks the oldest read unless writes have been
+ * starved or have expired, in which case a batch of writes to the erase
+ * block of the oldest write is started
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = !list_empty(&fd->fifo_list[READ]);
+	const int writes = !list_empty(&fd->fifo_list[WRITE]);
+	struct request *rq;
+
+	/*
+	 * keep filling the current erase block, unless a read has
+	 * been waiting too long for it
+	 */
+	if (fd->batching && fd->batching < fd->write_batch &&
+	    !(reads && flash_check_fifo(fd, READ))) {
+		rq = flash_next_batch_write(fd);
+		if (rq)
+			goto dispatch_request;
+	}
+
+	fd->batching = 0;
+
+	if (reads) {
+		if (writes && (fd->starved++ >= fd->writes_starved ||
+			       flash_check_fifo(fd, WRITE)))
+			goto dispatch_writes;
+
+		rq = rq_entry_fifo(fd->fifo_list[READ].next);
+		flash_move_to_dispatch(fd, rq);
+		return 1;
+	}
+
+	/*
+	 * there are either no reads or writes have been starved
+	 */
+
+	if (writes) {
+dispatch_writes:
+		fd->starved = 0;
+
+		rq = rq_entry_fifo(fd->fifo_list[WRITE].next);
+		fd->batch_block = flash_erase_block(fd, rq);
+		goto dispatch_request;
+	}
+
+	return 0;
+
+dispatch_request:
+	fd->batching++;
+	flash_move_to_dispatch(fd, rq);
+
+	return 1;
+}
+
+static void
+flash_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	unsigned long lat = flash_now_us() - RQ_QUEUED_US(rq);
+	int bucket = fls_long(lat >> FLASH_LAT_SHIFT);
+
+	if (bucket >= FLASH_LAT_BUCKETS)
+		bucket = FLASH_LAT_BUCKETS - 1;
+
+	fd->lat_hist[rq_data_dir(rq)][bucket]++;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[WRITE])
+		&& list_empty(&fd->fifo_list[READ]);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[READ]));
+	BUG_ON(!list_empty(&fd->fifo_list[WRITE]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[WRITE]);
+	fd->fifo_expire[READ] = read_expire;
+	fd->fifo_expire[WRITE] = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch = write_batch;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_read_expire_show, fd->fifo_expire[READ], 1);
+SHOW_FUNCTION(flash_write_expire_show, fd->fifo_expire[WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+SHOW_FUNCTION(flash_erase_block_kb_show, fd->erase_block_kb, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_read_expire_store, &fd->fifo_expire[READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_write_expire_store, &fd->fifo_expire[WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, INT_MIN, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_erase_block_kb_store, &fd->erase_block_kb, 0, INT_MAX >> 1, 0);
+#undef STORE_FUNCTION
+
+static ssize_t flash_latency_hist_show(struct elevator_queue *e, char *page)
+{
+	struct flash_data *fd = e->elevator_data;
+	ssize_t len;
+	int i;
+
+	len = sprintf(page, "%10s %12s %12s\n", "usecs", "reads", "writes");
+	for (i = 0; i < FLASH_LAT_BUCKETS; i++) {
+		char bound[16];
+
+		if (i < FLASH_LAT_BUCKETS - 1)
+			sprintf(bound, "<%lu", 1UL << (FLASH_LAT_SHIFT + i));
+		else
+			sprintf(bound, ">=%lu", 1UL << (FLASH_LAT_SHIFT + i - 1));
+		len += sprintf(page + len, "%10s %12lu %12lu\n", bound,
+			       fd->lat_hist[READ][i], fd->lat_hist[WRITE][i]);
+	}
+
+	return len;
+}
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(read_expire),
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch),
+	FD_ATTR(erase_block_kb),
+	__ATTR(latency_hist, S_IRUGO, flash_latency_hist_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_completed_req_fn =	flash_completed_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	flash_former_request,
+		.elevator_latter_req_fn =	flash_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -0,0 +1,432 @@
+/*
+ * Null block device driver.
+ *
+ * Completes every request without touching its data, so that the time
+ * spent in the block layer itself can be measured.  How requests get to
+ * the driver and how they are completed are module parameters, see
+ * Documentation/blockdev/null_blk.txt.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/hrtimer.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+
+enum {
+	NULL_Q_BIO		= 0,
+	NULL_Q_RQ		= 1,
+};
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+};
+
+struct nullb_cmd {
+	struct list_head list;
+	struct nullb *nullb;
+	struct request *rq;
+	struct bio *bio;
+	ktime_t due;
+};
+
+struct nullb {
+	struct list_head list;
+	unsigned int index;
+	struct request_queue *q;
+	struct gendisk *disk;
+	spinlock_t lock;		/* queue lock in request mode */
+
+	/* protects everything below but the timer itself */
+	spinlock_t cmd_lock;
+	struct nullb_cmd *cmds;
+	struct list_head free_cmds;
+	wait_queue_head_t cmd_wait;
+
+	/* commands waiting for the timer, in completion order */
+	struct list_head timer_cmds;
+	struct hrtimer timer;
+	int timer_armed;
+};
+
+static LIST_HEAD(nullb_list);
+static int null_major;
+
+static int queue_mode = NULL_Q_RQ;
+module_param(queue_mode, int, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "Block interface to use (0=bio,1=rq)");
+
+static int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "IRQ completion handler. 0-none, 1-softirq, 2-timer");
+
+static unsigned long completion_nsec = 10000;
+module_param(completion_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in timer mode");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Block size (in bytes)");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size in GB");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Requests in flight per device in softirq and timer mode");
+
+static struct nullb_cmd *null_get_cmd(struct nullb *nullb)
+{
+	struct nullb_cmd *cmd = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&nullb->cmd_lock, flags);
+	if (!list_empty(&nullb->free_cmds)) {
+		cmd = list_first_entry(&nullb->free_cmds, struct nullb_cmd,
+				       list);
+		list_del(&cmd->list);
+	}
+	spin_unlock_irqrestore(&nullb->cmd_lock, flags);
+
+	return cmd;
+}
+
+static void null_end_cmd(struct nullb_cmd *cmd)
+{
+	struct nullb *nullb = cmd->nullb;
+	struct request_queue *q = nullb->q;
+	struct request *rq = cmd->rq;
+	struct bio *bio = cmd->bio;
+	unsigned long flags;
+
+	spin_lock_irqsave(&nullb->cmd_lock, flags);
+	list_add(&cmd->list, &nullb->free_cmds);
+	spin_unlock_irqrestore(&nullb->cmd_lock, flags);
+
+	if (bio) {
+		bio_endio(bio, 0);
+		wake_up(&nullb->cmd_wait);
+		return;
+	}
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	__blk_end_request_all(rq, 0);
+	/* null_request_fn() stops the queue when it runs out of commands */
+	if (blk_queue_stopped(q))
+		blk_start_queue(q);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+/*
+ * Complete the timer commands that are due, or all of them if @all is set,
+ * returns how many that were.
+ */
+static int null_reap(struct nullb *nullb, int all)
+{
+	struct nullb_cmd *cmd, *tmp;
+	s64 now = ktime_to_ns(ktime_get());
+	unsigned long flags;
+	LIST_HEAD(done);
+	int nr = 0;
+
+	spin_lock_irqsave(&nullb->cmd_lock, flags);
+	list_for_each_entry_safe(cmd, tmp, &nullb->timer_cmds, list) {
+		if (!all && ktime_to_ns(cmd->due) > now)
+			break;
+		list_move_tail(&cmd->list, &done);
+	}
+	spin_unlock_irqrestore(&nullb->cmd_lock, flags);
+
+	list_for_each_entry_safe(cmd, tmp, &done, list) {
+		list_del(&cmd->list);
+		null_end_cmd(cmd);
+		nr++;
+	}
+
+	return nr;
+}
+
+static enum hrtimer_restart null_timer_fn(struct hrtimer *timer)
+{
+	struct nullb *nullb = container_of(timer, struct nullb, timer);
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+
+	null_reap(nullb, 0);
+
+	/*
+	 * Commands queued meanwhile saw timer_armed and left rearming
+	 * the timer to us.
+	 */
+	spin_lock_irqsave(&nullb->cmd_lock, flags);
+	if (!list_empty(&nullb->timer_cmds)) {
+		struct nullb_cmd *cmd = list_first_entry(&nullb->timer_cmds,
+							 struct nullb_cmd, list);
+
+		hrtimer_set_expires(timer, cmd->due);
+		ret = HRTIMER_RESTART;
+	} else
+		nullb->timer_armed = 0;
+	spin_unlock_irqrestore(&nullb->cmd_lock, flags);
+
+	return ret;
+}
+
+static void null_cmd_end_timer(struct nullb_cmd *cmd)
+{
+	struct nullb *nullb = cmd->nullb;
+	unsigned long flags;
+
+	cmd->due = ktime_add_ns(ktime_get(), completion_nsec);
+
+	spin_lock_irqsave(&nullb->cmd_lock, flags);
+	list_add_tail(&cmd->list, &nullb->timer_cmds);
+	if (!nullb->timer_armed) {
+		nullb->timer_armed = 1;
+		hrtimer_start(&nullb->timer, cmd->due, HRTIMER_MODE_ABS);
+	}
+	spin_unlock_irqrestore(&nullb->cmd_lock, flags);
+}
+
+/*
+ * Lets blk_poll() complete timer commands as soon as they are due,
+ * rather than when the timer interrupt gets around to it.
+ */
+static int null_poll(struct request_queue *q)
+{
+	return null_reap(q->queuedata, 0);
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+	null_end_cmd(rq->special);
+}
+
+static void null_handle_cmd(struct nullb_cmd *cmd)
+{
+	switch (irqmode) {
+	case NULL_IRQ_SOFTIRQ:
+		/* bios carry no submitting CPU to complete on */
+		if (cmd->rq)
+			blk_complete_request(cmd->rq);
+		else
+			null_end_cmd(cmd);
+		break;
+	case NULL_IRQ_TIMER:
+		null_cmd_end_timer(cmd);
+		break;
+	}
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct nullb *nullb = q->queuedata;
+	struct request *rq;
+
+	while ((rq = blk_peek_request(q)) != NULL) {
+		struct nullb_cmd *cmd;
+
+		if (irqmode == NULL_IRQ_NONE) {
+			blk_start_request(rq);
+			__blk_end_request_all(rq, 0);
+			continue;
+		}
+
+		cmd = null_get_cmd(nullb);
+		if (!cmd) {
+			/* restarted by null_end_cmd() */
+			blk_stop_queue(q);
+			break;
+		}
+
+		blk_start_request(rq);
+		cmd->rq = rq;
+		cmd->bio = NULL;
+		rq->special = cmd;
+		null_handle_cmd(cmd);
+	}
+}
+
+static int null_make_request(struct request_queue *q, struct bio *bio)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+
+	if (irqmode == NULL_IRQ_NONE) {
+		bio_endio(bio, 0);
+		return 0;
+	}
+
+	wait_event(nullb->cmd_wait, (cmd = null_get_cmd(nullb)) != NULL);
+	cmd->rq = NULL;
+	cmd->bio = bio;
+	null_handle_cmd(cmd);
+
+	return 0;
+}
+
+static const struct block_device_operations null_fops = {
+	.owner =		THIS_MODULE,
+};
+
+static void null_del_dev(struct nullb *nullb)
+{
+	unsigned long flags;
+
+	list_del(&nullb->list);
+	del_gendisk(nullb->disk);
+
+	/* nothing new comes in now, finish what waits for the timer */
+	hrtimer_cancel(&nullb->timer);
+	spin_lock_irqsave(&nullb->cmd_lock, flags);
+	nullb->timer_armed = 0;
+	spin_unlock_irqrestore(&nullb->cmd_lock, flags);
+	null_reap(nullb, 1);
+
+	blk_cleanup_queue(nullb->q);
+	put_disk(nullb->disk);
+	kfree(nullb->cmds);
+	kfree(nullb);
+}
+
+static int null_add_dev(int index)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	int i;
+
+	nullb = kzalloc(sizeof(*nullb), GFP_KERNEL);
+	if (!nullb)
+		goto out;
+
+	nullb->index = index;
+	spin_lock_init(&nullb->lock);
+	spin_lock_init(&nullb->cmd_lock);
+	INIT_LIST_HEAD(&nullb->free_cmds);
+	INIT_LIST_HEAD(&nullb->timer_cmds);
+	init_waitqueue_head(&nullb->cmd_wait);
+	hrtimer_init(&nullb->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	nullb->timer.function = null_timer_fn;
+
+	nullb->cmds = kcalloc(hw_queue_depth, sizeof(*nullb->cmds),
+			      GFP_KERNEL);
+	if (!nullb->cmds)
+		goto out_free_dev;
+	for (i = 0; i < hw_queue_depth; i++) {
+		nullb->cmds[i].nullb = nullb;
+		list_add_tail(&nullb->cmds[i].list, &nullb->free_cmds);
+	}
+
+	if (queue_mode == NULL_Q_BIO) {
+		nullb->q = blk_alloc_queue(GFP_KERNEL);
+		if (!nullb->q)
+			goto out_free_cmds;
+		blk_queue_make_request(nullb->q, null_make_request);
+	} else {
+		nullb->q = blk_init_queue(null_request_fn, &nullb->lock);
+		if (!nullb->q)
+			goto out_free_cmds;
+		blk_queue_softirq_done(nullb->q, null_softirq_done_fn);
+	}
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+	blk_queue_bounce_limit(nullb->q, BLK_BOUNCE_ANY);
+	blk_queue_max_sectors(nullb->q, 1024);
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+	if (irqmode == NULL_IRQ_TIMER)
+		blk_queue_poll_fn(nullb->q, null_poll);
+
+	disk = nullb->disk = alloc_disk(1);
+	if (!disk)
+		goto out_cleanup_queue;
+	disk->major		= null_major;
+	disk->first_minor	= index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	sprintf(disk->disk_name, "nullb%d", index);
+	set_capacity(disk, (sector_t) gb << (30 - 9));
+
+	list_add_tail(&nullb->list, &nullb_list);
+	add_disk(disk);
+
+	return 0;
+
+out_cleanup_queue:
+	blk_cleanup_queue(nullb->q);
+out_free_cmds:
+	kfree(nullb->cmds);
+out_free_dev:
+	kfree(nullb);
+out:
+	return -ENOMEM;
+}
+
+static int __init null_init(void)
+{
+	struct nullb *nullb, *next;
+	int i, ret;
+
+	if (queue_mode != NULL_Q_BIO && queue_mode != NULL_Q_RQ)
+		return -EINVAL;
+	if (irqmode < NULL_IRQ_NONE || irqmode > NULL_IRQ_TIMER)
+		return -EINVAL;
+	if (nr_devices < 1 || nr_devices > 1 << MINORBITS ||
+	    hw_queue_depth < 1 || gb < 1)
+		return -EINVAL;
+
+	if (bs < 512 || bs > PAGE_SIZE || !is_power_of_2(bs)) {
+		printk(KERN_WARNING "null_blk: invalid block size %d, "
+		       "using 512\n", bs);
+		bs = 512;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		ret = null_add_dev(i);
+		if (ret)
+			goto out_del;
+	}
+
+	printk(KERN_INFO "null_blk: module loaded\n");
+	return 0;
+
+out_del:
+	list_for_each_entry_safe(nullb, next, &nullb_list, list)
+		null_del_dev(nullb);
+	unregister_blkdev(null_major, "nullb");
+
+	return ret;
+}
+
+static void __exit null_exit(void)
+{
+	struct nullb *nullb, *next;
+
+	list_for_each_entry_safe(nullb, next, &nullb_list, list)
+		null_del_dev(nullb);
+
+	unregister_blkdev(null_major, "nullb");
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("null block device");
@@ -30,6 +30,8 @@
 #include <linux/mutex.h>
 #include <linux/scatterlist.h>
 #include <linux/string_helpers.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -51,6 +53,16 @@ MODULE_ALIAS("mmc:block");
 
 static DECLARE_BITMAP(dev_use, MMC_NUM_MINORS);
 
+/*
+ * Small writes are latency bound, so queued writes are batched into one
+ * command: a packed write on cards that have it, otherwise consecutive
+ * writes as one transfer.
+ */
+static unsigned int packed_depth = 8;
+module_param(packed_depth, uint, 0644);
+MODULE_PARM_DESC(packed_depth, "Most write requests batched into one command, "
+		 "0 or 1 turns batching off");
+
 /*
  * There is one mmc_blk_data per slot.
  */
@@ -61,6 +73,8 @@ struct mmc_blk_data {
 
 	unsigned int	usage;
 	unsigned int	read_only;
+
+	struct dentry	*packed_stats;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -137,13 +151,6 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
-};
-
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
 {
 	int err;
@@ -234,197 +241,289 @@ static u32 get_card_status(struct mmc_card *card, struct request *req)
 	return cmd.resp[0];
 }
 
-static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+/*
+ * A packed write is ended by its block count rather than a stop command,
+ * so one that failed part way can leave the card still in the data or
+ * receive-data state.  Send the stop command to get it back to transfer.
+ */
+static void mmc_blk_packed_stop(struct mmc_card *card, struct request *req)
 {
-	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	int ret = 1, disable_multi = 0;
+	struct mmc_command cmd;
+	u32 status;
+	int err;
 
-	mmc_claim_host(card->host);
+	status = get_card_status(card, req);
+	if (R1_CURRENT_STATE(status) != 5 && R1_CURRENT_STATE(status) != 6)
+		return;
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
-
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
-
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = MMC_STOP_TRANSMISSION;
+	cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 5);
+	if (err)
+		printk(KERN_ERR "%s: error %d sending stop command after "
+		       "packed write, card status %#x\n",
+		       req->rq_disk->disk_name, err, status);
+}
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+/*
+ * Outcome of a read/write request, as returned by mmc_blk_err_check().
+ * Only MMC_BLK_SUCCESS lets the next request start right away.
+ */
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_PARTIAL,	/* no error, but not all of the request done */
+	MMC_BLK_RETRY_SINGLE,	/* read failed, retry a sector at a time */
+	MMC_BLK_DATA_ERR,	/* single sector read failed */
+	MMC_BLK_CMD_ERR,	/* write failed, or card status unavailable */
+};
 
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
-		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mqrq = container_of(areq, struct mmc_queue_req,
+						  mmc_active);
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct mmc_command cmd;
+	u32 status = 0;
 
-		if (brq.data.blocks > 1) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
-			 */
-			if (!mmc_host_is_spi(card->host)
-					|| rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
+	/*
+	 * Check for errors here, but don't return MMC_BLK_CMD_ERR until
+	 * later as we need to wait for the card to leave programming mode
+	 * even when things go wrong.
+	 */
+	if (brq->sbc.error || brq->cmd.error || brq->data.error ||
+	    brq->stop.error) {
+		if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
+			/* Redo read one sector at a time */
+			return MMC_BLK_RETRY_SINGLE;
 		}
+		status = get_card_status(card, req);
+	}
 
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
-		}
+	if (brq->sbc.error) {
+		printk(KERN_ERR "%s: error %d sending set block count "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->sbc.error,
+		       brq->sbc.resp[0], status);
+	}
 
-		mmc_set_data_timeout(&brq.data, card);
+	if (brq->cmd.error) {
+		printk(KERN_ERR "%s: error %d sending read/write "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->cmd.error,
+		       brq->cmd.resp[0], status);
+	}
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	if (brq->data.error) {
+		if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
+			/* 'Stop' response contains card status */
+			status = brq->mrq.stop->resp[0];
+		printk(KERN_ERR "%s: error %d transferring data,"
+		       " sector %u, nr %u, card status %#x\n",
+		       req->rq_disk->disk_name, brq->data.error,
+		       (unsigned)blk_rq_pos(req),
+		       (unsigned)blk_rq_sectors(req), status);
+	}
+
+	if (brq->stop.error) {
+		printk(KERN_ERR "%s: error %d sending stop command, "
+		       "response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->stop.error,
+		       brq->stop.resp[0], status);
+	}
+
+	if (mqrq->packed_type == MMC_PACKED_WRITE &&
+	    !mmc_host_is_spi(card->host) &&
+	    (brq->sbc.error || brq->cmd.error || brq->data.error ||
+	     brq->data.bytes_xfered != brq->data.blocks * brq->data.blksz))
+		mmc_blk_packed_stop(card, req);
+
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
+		do {
+			int err;
+
+			memset(&cmd, 0, sizeof(struct mmc_command));
+			cmd.opcode = MMC_SEND_STATUS;
+			cmd.arg = card->rca << 16;
+			cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			err = mmc_wait_for_cmd(card->host, &cmd, 5);
+			if (err) {
+				printk(KERN_ERR "%s: error %d requesting status\n",
+				       req->rq_disk->disk_name, err);
+				return MMC_BLK_CMD_ERR;
+			}
+			/*
+			 * Some cards mishandle the status bits,
+			 * so make sure to check both the busy
+			 * indication and the card state.
+			 */
+		} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+			(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+	}
 
+	if (brq->sbc.error || brq->cmd.error || brq->stop.error ||
+	    brq->data.error) {
 		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
+		 * After an error, we redo I/O one sector at a time, so we
+		 * only get here for reads after trying a single sector.
 		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
-			}
-			brq.data.sg_len = i;
-		}
+		if (rq_data_dir(req) == READ)
+			return MMC_BLK_DATA_ERR;
+		return MMC_BLK_CMD_ERR;
+	}
 
-		mmc_queue_bounce_pre(mq);
+	/* A batch that did not go through whole is redone request by request */
+	if (mqrq->packed_type != MMC_PACKED_NONE) {
+		if (brq->data.bytes_xfered != brq->data.blocks * brq->data.blksz)
+			return MMC_BLK_CMD_ERR;
+		return MMC_BLK_SUCCESS;
+	}
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+	if (brq->data.bytes_xfered != blk_rq_bytes(req))
+		return MMC_BLK_PARTIAL;
 
-		mmc_queue_bounce_post(mq);
+	return MMC_BLK_SUCCESS;
+}
 
-		/*
-		 * Check for errors here, but don't jump to cmd_err
-		 * until later as we need to wait for the card to leave
-		 * programming mode even when things go wrong.
+/*
+ * Set up the MMC request for what is left of mqrq->req.
+ */
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card, int disable_multi,
+			       struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	u32 readcmd, writecmd;
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
+
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
+
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
+
+	if (brq->data.blocks > 1) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
 		 */
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
-				/* Redo read one sector at a time */
-				/* printk(KERN_WARNING "%s: retrying using single "
-				       "block read\n", req->rq_disk->disk_name); */
-				disable_multi = 1;
-				continue;
-			}
-			status = get_card_status(card, req);
-		}
+		if (!mmc_host_is_spi(card->host)
+				|| rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
 
-		if (brq.cmd.error) {
-			printk(KERN_ERR "%s: error %d sending read/write "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
-		}
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
 
-		if (brq.data.error) {
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
-				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
-			printk(KERN_ERR "%s: error %d transferring data,"
-			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
-			       (unsigned)blk_rq_pos(req),
-			       (unsigned)blk_rq_sectors(req), status);
-		}
+	mmc_set_data_timeout(&brq->data, card);
 
-		if (brq.stop.error) {
-			printk(KERN_ERR "%s: error %d sending stop command, "
-			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
-		}
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			do {
-				int err;
-
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-				err = mmc_wait_for_cmd(card->host, &cmd, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					goto cmd_err;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7));
-
-#if 0
-			if (cmd.resp[0] & ~0x00000900)
-				printk(KERN_ERR "%s: status = %08x\n",
-				       req->rq_disk->disk_name, cmd.resp[0]);
-			if (mmc_decode_status(cmd.resp))
-				goto cmd_err;
-#endif
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
+			}
 		}
+		brq->data.sg_len = i;
+	}
 
-		if (brq.cmd.error || brq.stop.error || brq.data.error) {
-			if (rq_data_dir(req) == READ) {
-				/*
-				 * After an error, we redo I/O one sector at a
-				 * time, so we only reach here after trying to
-				 * read a single sector.
-				 */
-				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -EIO, brq.data.blksz);
-				spin_unlock_irq(&md->lock);
-				continue;
-			}
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
+
+	mmc_queue_bounce_pre(mqrq);
+}
+
+/*
+ * Finish a request that did not complete in one go.  What is left of it
+ * is issued synchronously, nothing else is on the bus meanwhile.
+ */
+static int mmc_blk_finish_rq(struct mmc_queue *mq, struct mmc_queue_req *mqrq,
+			     int status)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	int ret = 1, disable_multi = 0;
+
+	do {
+		switch (status) {
+		case MMC_BLK_SUCCESS:
+		case MMC_BLK_PARTIAL:
+			/*
+			 * A block was successfully transferred.
+			 */
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
+			spin_unlock_irq(&md->lock);
+			break;
+		case MMC_BLK_RETRY_SINGLE:
+			disable_multi = 1;
+			break;
+		case MMC_BLK_DATA_ERR:
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, -EIO, brq->data.blksz);
+			spin_unlock_irq(&md->lock);
+			break;
+		default:
 			goto cmd_err;
 		}
+		if (!ret)
+			break;
 
-		/*
-		 * A block was successfully transferred.
-		 */
-		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
-		spin_unlock_irq(&md->lock);
-	} while (ret);
-
-	mmc_release_host(card->host);
+		mmc_blk_rw_rq_prep(mqrq, card, disable_multi, mq);
+		mmc_start_req(card->host, &mqrq->mmc_active, NULL);
+		mmc_start_req(card->host, NULL, &status);
+		mmc_queue_bounce_post(mqrq);
+	} while (1);
 
 	return 1;
 
@@ -448,12 +547,10 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		}
 	} else {
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	}
 
-	mmc_release_host(card->host);
-
 	spin_lock_irq(&md->lock);
 	while (ret)
 		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
@@ -462,6 +559,469 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	return 0;
 }
 
+static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	unsigned int from, nr, arg;
+	int err = 0;
+
+	if (!mmc_can_erase(card)) {
+		err = -EOPNOTSUPP;
+		goto out;
+	}
+
+	from = blk_rq_pos(req);
+	nr = blk_rq_sectors(req);
+
+	if (mmc_can_trim(card))
+		arg = MMC_TRIM_ARG;
+	else
+		arg = MMC_ERASE_ARG;
+
+	err = mmc_erase(card, from, nr, arg);
+out:
+	spin_lock_irq(&md->lock);
+	__blk_end_request(req, err, blk_rq_bytes(req));
+	spin_unlock_irq(&md->lock);
+
+	return err ? 0 : 1;
+}
+
+static int mmc_blk_issue_secdiscard_rq(struct mmc_queue *mq,
+				       struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	unsigned int from, nr, arg;
+	int err = 0;
+
+	if (!mmc_can_secure_erase_trim(card)) {
+		err = -EOPNOTSUPP;
+		goto out;
+	}
+
+	from = blk_rq_pos(req);
+	nr = blk_rq_sectors(req);
+
+	/* Secure erase needs whole erase groups, secure trim does not */
+	if (mmc_can_trim(card) && !mmc_erase_group_aligned(card, from, nr))
+		arg = MMC_SECURE_TRIM1_ARG;
+	else
+		arg = MMC_SECURE_ERASE_ARG;
+
+	err = mmc_erase(card, from, nr, arg);
+	if (!err && arg == MMC_SECURE_TRIM1_ARG)
+		err = mmc_erase(card, from, nr, MMC_SECURE_TRIM2_ARG);
+out:
+	spin_lock_irq(&md->lock);
+	__blk_end_request(req, err, blk_rq_bytes(req));
+	spin_unlock_irq(&md->lock);
+
+	return err ? 0 : 1;
+}
+
+/*
+ * Take the writes queued behind req, up to packed_depth of them, into one
+ * batch with it.  A packed write takes writes to any address, a merged
+ * transfer only those that carry on where the previous one ended; writes
+ * that happen to be consecutive go as a merged transfer either way.
+ */
+static void mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct mmc_host *host = card->host;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	struct mmc_packed_stats *stats = &mq->packed_stats;
+	unsigned int max_num, max_blocks, max_segs, num = 1;
+	unsigned int blocks, segs;
+	int packed, consecutive = 1;
+	sector_t next_pos;
+	struct request *next;
+
+	mqrq->packed_type = MMC_PACKED_NONE;
+	mqrq->packed_num = 1;
+
+	if (rq_data_dir(req) != WRITE)
+		return;
+
+	if (packed_depth < 2 || mqrq->bounce_buf || blk_barrier_rq(req) ||
+	    mmc_host_is_spi(host))
+		goto out;
+
+	packed = mqrq->packed_cmd_hdr != NULL;
+	max_num = packed_depth;
+	if (packed)
+		max_num = min_t(unsigned int, max_num,
+				card->ext_csd.max_packed_writes);
+	max_blocks = min(host->max_blk_count, host->max_req_size >> 9);
+	max_segs = min(host->max_hw_segs, host->max_phys_segs);
+
+	/* Leave room for the packed command header */
+	blocks = blk_rq_sectors(req) + packed;
+	segs = req->nr_phys_segments + packed;
+	next_pos = blk_rq_pos(req) + blk_rq_sectors(req);
+
+	spin_lock_irq(q->queue_lock);
+	while (num < max_num) {
+		next = blk_peek_request(q);
+		if (!next || rq_data_dir(next) != WRITE ||
+		    blk_discard_rq(next) || blk_barrier_rq(next))
+			break;
+
+		if (blocks + blk_rq_sectors(next) > max_blocks ||
+		    segs + next->nr_phys_segments > max_segs)
+			break;
+
+		if (blk_rq_pos(next) != next_pos) {
+			if (!packed)
+				break;
+			consecutive = 0;
+		}
+
+		blk_start_request(next);
+		list_add_tail(&next->queuelist, &mqrq->packed_list);
+
+		blocks += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+		next_pos = blk_rq_pos(next) + blk_rq_sectors(next);
+		num++;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	if (num > 1) {
+		list_add(&req->queuelist, &mqrq->packed_list);
+		mqrq->packed_type = consecutive ? MMC_PACKED_MERGED :
+						  MMC_PACKED_WRITE;
+		mqrq->packed_num = num;
+	}
+
+out:
+	switch (mqrq->packed_type) {
+	case MMC_PACKED_NONE:
+		stats->single++;
+		break;
+	case MMC_PACKED_WRITE:
+		stats->packed++;
+		stats->packed_reqs += num;
+		break;
+	case MMC_PACKED_MERGED:
+		stats->merged++;
+		stats->merged_reqs += num;
+		break;
+	}
+}
+
+/*
+ * Set up one write command for all the requests of a batch.  A packed
+ * write is announced by SET_BLOCK_COUNT and has no stop command.
+ */
+static void mmc_blk_packed_rq_prep(struct mmc_queue_req *mqrq,
+				   struct mmc_card *card,
+				   struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	u32 *hdr = mqrq->packed_cmd_hdr;
+	struct request *req;
+	unsigned int blocks = 0, i = 1;
+	u32 arg;
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	list_for_each_entry(req, &mqrq->packed_list, queuelist)
+		blocks += blk_rq_sectors(req);
+
+	if (mqrq->packed_type == MMC_PACKED_WRITE) {
+		memset(hdr, 0, 512);
+		hdr[0] = cpu_to_le32((mqrq->packed_num << 16) |
+				     (MMC_PACKED_CMD_WR << 8) |
+				     MMC_PACKED_CMD_VER);
+		list_for_each_entry(req, &mqrq->packed_list, queuelist) {
+			arg = blk_rq_pos(req);
+			if (!mmc_card_blockaddr(card))
+				arg <<= 9;
+			hdr[i * 2] = cpu_to_le32(blk_rq_sectors(req));
+			hdr[i * 2 + 1] = cpu_to_le32(arg);
+			i++;
+		}
+		blocks++;
+
+		brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+		brq->sbc.arg = MMC_CMD23_ARG_PACKED | blocks;
+		brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		brq->mrq.sbc = &brq->sbc;
+	} else {
+		brq->stop.opcode = MMC_STOP_TRANSMISSION;
+		brq->stop.arg = 0;
+		brq->stop.flags = MMC_RSP_R1B | MMC_CMD_AC;
+		brq->mrq.stop = &brq->stop;
+	}
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(mqrq->req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->data.blocks = blocks;
+	brq->data.flags = MMC_DATA_WRITE;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_packed_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
+}
+
+static void mmc_blk_rq_prep(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
+{
+	if (mqrq->packed_type != MMC_PACKED_NONE)
+		mmc_blk_packed_rq_prep(mqrq, mq->card, mq);
+	else
+		mmc_blk_rw_rq_prep(mqrq, mq->card, 0, mq);
+}
+
+static void mmc_blk_end_packed(struct mmc_queue *mq,
+			       struct mmc_queue_req *mqrq)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct request *req, *tmp;
+
+	spin_lock_irq(&md->lock);
+	list_for_each_entry_safe(req, tmp, &mqrq->packed_list, queuelist) {
+		list_del_init(&req->queuelist);
+		__blk_end_request_all(req, 0);
+	}
+	spin_unlock_irq(&md->lock);
+
+	mqrq->packed_type = MMC_PACKED_NONE;
+}
+
+/*
+ * Number of entries of a failed packed write that made it to the card,
+ * going by the packed command status in the EXT_CSD.  0 if unknown.
+ */
+static unsigned int mmc_blk_packed_written(struct mmc_card *card)
+{
+	struct mmc_request mrq;
+	struct mmc_command cmd;
+	struct mmc_data data;
+	struct scatterlist sg;
+	unsigned int written = 0;
+	u8 *ext_csd;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return 0;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+
+	cmd.opcode = MMC_SEND_EXT_CSD;
+	cmd.arg = 0;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	memset(&data, 0, sizeof(struct mmc_data));
+
+	data.blksz = 512;
+	data.blocks = 1;
+	data.flags = MMC_DATA_READ;
+	data.sg = &sg;
+	data.sg_len = 1;
+
+	mmc_set_data_timeout(&data, card);
+
+	memset(&mrq, 0, sizeof(struct mmc_request));
+
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+
+	sg_init_one(&sg, ext_csd, 512);
+
+	mmc_wait_for_req(card->host, &mrq);
+
+	if (!cmd.error && !data.error &&
+	    (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+	     EXT_CSD_PACKED_INDEXED_ERROR) &&
+	    ext_csd[EXT_CSD_PACKED_FAILURE_INDEX])
+		written = ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+
+	kfree(ext_csd);
+
+	return written;
+}
+
+/*
+ * Finish a batch that failed.  What is known to be written is completed,
+ * the rest is issued synchronously one request at a time, nothing else
+ * is on the bus meanwhile.
+ */
+static int mmc_blk_finish_packed(struct mmc_queue *mq,
+				 struct mmc_queue_req *mqrq)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct request *req, *tmp;
+	unsigned int good, n, i = 0;
+	int status, more, ret = 1;
+
+	mq->packed_stats.failed++;
+
+	/* Bytes that made it, the controller's count is a lower bound */
+	if (mqrq->packed_type == MMC_PACKED_WRITE) {
+		n = mmc_blk_packed_written(card);
+		good = 0;
+		list_for_each_entry(req, &mqrq->packed_list, queuelist) {
+			if (i++ == n)
+				break;
+			good += blk_rq_bytes(req);
+		}
+	} else {
+		good = mqrq->brq.data.bytes_xfered;
+	}
+	mqrq->packed_type = MMC_PACKED_NONE;
+
+	list_for_each_entry_safe(req, tmp, &mqrq->packed_list, queuelist) {
+		list_del_init(&req->queuelist);
+
+		n = min(good, blk_rq_bytes(req));
+		good -= n;
+		if (n) {
+			spin_lock_irq(&md->lock);
+			more = __blk_end_request(req, 0, n);
+			spin_unlock_irq(&md->lock);
+			if (!more)
+				continue;
+		}
+
+		mqrq->req = req;
+		mmc_blk_rw_rq_prep(mqrq, card, 0, mq);
+		mmc_start_req(card->host, &mqrq->mmc_active, NULL);
+		mmc_start_req(card->host, NULL, &status);
+		if (!mmc_blk_finish_rq(mq, mqrq, status))
+			ret = 0;
+	}
+
+	return ret;
+}
+
+/*
+ * Start req, if any, and finish the request started by the previous call.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_async_req *areq = NULL;
+	struct mmc_queue_req *mqrq;
+	int status;
+
+	if (req) {
+		mmc_blk_prep_packed_list(mq, req);
+		mmc_blk_rq_prep(mq, mq->mqrq_cur);
+		areq = &mq->mqrq_cur->mmc_active;
+	}
+
+	/*
+	 * If the previous request completed cleanly req is on the bus by
+	 * now, while we complete the previous one to the block layer.
+	 */
+	areq = mmc_start_req(card->host, areq, &status);
+	if (!areq)
+		return 1;
+
+	mqrq = container_of(areq, struct mmc_queue_req, mmc_active);
+	mmc_queue_bounce_post(mqrq);
+
+	if (status == MMC_BLK_SUCCESS) {
+		if (mqrq->packed_type != MMC_PACKED_NONE) {
+			mmc_blk_end_packed(mq, mqrq);
+			return 1;
+		}
+		spin_lock_irq(&md->lock);
+		__blk_end_request(mqrq->req, 0, mqrq->brq.data.bytes_xfered);
+		spin_unlock_irq(&md->lock);
+		return 1;
+	}
+
+	/* req was not started, the bus is ours until it is */
+	if (mqrq->packed_type != MMC_PACKED_NONE)
+		status = mmc_blk_finish_packed(mq, mqrq);
+	else
+		status = mmc_blk_finish_rq(mq, mqrq, status);
+	if (req) {
+		mmc_blk_rq_prep(mq, mq->mqrq_cur);
+		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
+	}
+
+	return status;
+}
+
+/*
+ * The host stays claimed for as long as a request is on the bus, so it is
+ * claimed for the first request of a run and released once the queue
+ * thread has run dry and calls us with a NULL req.
+ *
+ * Discards are carried out synchronously, after whatever is on the bus
+ * has finished, and leave nothing on the bus behind them.
+ */
+static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int ret;
+
+	if (req && !mq->mqrq_prev->req)
+		mmc_claim_host(card->host);
+
+	if (req && blk_discard_rq(req)) {
+		if (mq->mqrq_prev->req)
+			mmc_blk_issue_rw_rq(mq, NULL);
+		if (req->cmd_flags & REQ_SECURE)
+			ret = mmc_blk_issue_secdiscard_rq(mq, req);
+		else
+			ret = mmc_blk_issue_discard_rq(mq, req);
+		mq->mqrq_cur->req = NULL;
+	} else {
+		ret = mmc_blk_issue_rw_rq(mq, req);
+	}
+
+	if (!mq->mqrq_cur->req)
+		mmc_release_host(card->host);
+
+	return ret;
+}
+
+static int mmc_blk_packed_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_blk_data *md = s->private;
+	struct mmc_packed_stats *stats = &md->queue.packed_stats;
+
+	seq_printf(s, "single:\t\t%lu\n", stats->single);
+	seq_printf(s, "packed:\t\t%lu (%lu requests)\n",
+		   stats->packed, stats->packed_reqs);
+	seq_printf(s, "merged:\t\t%lu (%lu requests)\n",
+		   stats->merged, stats->merged_reqs);
+	seq_printf(s, "failed:\t\t%lu\n", stats->failed);
+
+	return 0;
+}
+
+static int mmc_blk_packed_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_blk_packed_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmc_blk_packed_stats_fops = {
+	.open		= mmc_blk_packed_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 
 static inline int mmc_blk_readonly(struct mmc_card *card)
 {
@@ -561,8 +1121,11 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card)
 	struct mmc_command cmd;
 	int err;
 
-	/* Block-addressed cards ignore MMC_SET_BLOCKLEN. */
-	if (mmc_card_blockaddr(card))
+	/*
+	 * Block-addressed cards ignore MMC_SET_BLOCKLEN, and it is an illegal
+	 * command in dual data rate mode, where the block size is fixed at 512.
+	 */
+	if (mmc_card_blockaddr(card) || mmc_card_ddr_mode(card))
 		return 0;
 
 	mmc_claim_host(card->host);
@@ -608,6 +1171,12 @@ static int mmc_blk_probe(struct mmc_card *card)
 		md->disk->disk_name, mmc_card_id(card), mmc_card_name(card),
 		cap_str, md->read_only ? "(ro)" : "");
 
+	/* How writes were batched, see packed_depth */
+	if (card->debugfs_root)
+		md->packed_stats = debugfs_create_file("packed_stats", S_IRUSR,
+						       card->debugfs_root, md,
+						       &mmc_blk_packed_stats_fops);
+
 	mmc_set_drvdata(card, md);
 	add_disk(md->disk);
 	return 0;
@@ -623,6 +1192,8 @@ static void mmc_blk_remove(struct mmc_card *card)
 	struct mmc_blk_data *md = mmc_get_drvdata(card);
 
 	if (md) {
+		debugfs_remove(md->packed_stats);
+
 		/* Stop new requests from getting into the queue */
 		del_gendisk(md->disk);
 
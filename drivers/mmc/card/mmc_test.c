@@ -15,6 +15,11 @@
 #include <linux/mmc/mmc.h>
 
 #include <linux/scatterlist.h>
+#include <linux/list.h>
+#include <linux/random.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -24,6 +29,65 @@
 #define BUFFER_ORDER		2
 #define BUFFER_SIZE		(PAGE_SIZE << BUFFER_ORDER)
 
+/*
+ * The performance tests work on an area of this size in the middle of
+ * the card.  Random I/O runs for MMC_TEST_RND_SECS per transfer size.
+ */
+#define MMC_TEST_AREA_MAX_SZ	(4 * 1024 * 1024)
+#define MMC_TEST_RND_SECS	10
+
+/*
+ * One page allocation of a performance test buffer
+ */
+struct mmc_test_pages {
+	struct page	*page;
+	unsigned int	order;
+};
+
+/*
+ * A performance test buffer, made of as few allocations as we could get
+ */
+struct mmc_test_mem {
+	struct mmc_test_pages	*arr;
+	unsigned int		cnt;
+};
+
+/*
+ * The area of the card the performance tests use, and the buffer for it
+ */
+struct mmc_test_area {
+	unsigned long		max_sz;		/* area size in bytes */
+	unsigned int		dev_addr;	/* first sector of the area */
+	unsigned long		max_tfr;	/* largest transfer in bytes */
+	unsigned int		max_segs;	/* host segment count limit */
+	unsigned int		max_seg_sz;	/* host segment size limit */
+	struct mmc_test_mem	*mem;
+	struct scatterlist	*sg[2];		/* one per request in flight */
+};
+
+/*
+ * One measurement: @count transfers of @sectors sectors each took @ts
+ */
+struct mmc_test_transfer_result {
+	struct list_head	link;
+	unsigned int		count;
+	unsigned int		sectors;
+	struct timespec		ts;
+	unsigned int		rate;		/* bytes per second */
+	unsigned int		iops;		/* transfers per 100 seconds */
+};
+
+/*
+ * Result of one test case and the measurements it made
+ */
+struct mmc_test_general_result {
+	struct list_head	link;
+	struct mmc_card		*card;
+	int			testcase;
+	int			result;
+	struct list_head	tr_lst;
+};
+
 struct mmc_test_card {
 	struct mmc_card	*card;
 
@@ -32,6 +96,22 @@ struct mmc_test_card {
 #ifdef CONFIG_HIGHMEM
 	struct page	*highmem;
 #endif
+	struct mmc_test_area		area;
+	struct mmc_test_general_result	*gr;	/* current result, if any */
+};
+
+/*
+ * A request for the performance tests, which may be started through
+ * mmc_start_req() while the one before is still on the bus.
+ */
+struct mmc_test_areq {
+	struct mmc_async_req	areq;
+	struct mmc_request	mrq;
+	struct mmc_command	cmd;
+	struct mmc_command	stop;
+	struct mmc_data		data;
+	unsigned int		sg_len;
+	struct mmc_test_card	*test;
 };
 
 /*******************************************************************/
@@ -46,6 +126,10 @@ static int mmc_test_set_blksize(struct mmc_test_card *test, unsigned size)
 	struct mmc_command cmd;
 	int ret;
 
+	/* Ignored by block-addressed cards, illegal in dual data rate mode */
+	if (mmc_card_blockaddr(test->card) || mmc_card_ddr_mode(test->card))
+		return 0;
+
 	cmd.opcode = MMC_SET_BLOCKLEN;
 	cmd.arg = size;
 	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
@@ -453,6 +537,461 @@ static int mmc_test_transfer(struct mmc_test_card *test,
 	return 0;
 }
 
+/*******************************************************************/
+/*  Performance test helpers                                       */
+/*******************************************************************/
+
+/*
+ * Card capacity in sectors
+ */
+static unsigned int mmc_test_capacity(struct mmc_card *card)
+{
+	if (!mmc_card_sd(card) && mmc_card_blockaddr(card))
+		return card->ext_csd.sectors;
+	else
+		return card->csd.capacity << (card->csd.read_blkbits - 9);
+}
+
+static void mmc_test_free_mem(struct mmc_test_mem *mem)
+{
+	if (!mem)
+		return;
+	while (mem->cnt--)
+		__free_pages(mem->arr[mem->cnt].page,
+			     mem->arr[mem->cnt].order);
+	kfree(mem->arr);
+	kfree(mem);
+}
+
+/*
+ * Allocate at least @size bytes in chunks of no more than @max_seg_sz,
+ * taking the largest chunks the page allocator will give us.
+ */
+static struct mmc_test_mem *mmc_test_alloc_mem(unsigned long size,
+	unsigned int max_seg_sz)
+{
+	unsigned long page_cnt = DIV_ROUND_UP(size, PAGE_SIZE);
+	unsigned int max_order = 0;
+	struct mmc_test_mem *mem;
+
+	while (max_order < MAX_ORDER - 1 &&
+	       (PAGE_SIZE << (max_order + 1)) <= max_seg_sz)
+		max_order++;
+
+	mem = kzalloc(sizeof(struct mmc_test_mem), GFP_KERNEL);
+	if (!mem)
+		return NULL;
+
+	mem->arr = kzalloc(sizeof(struct mmc_test_pages) * page_cnt,
+			   GFP_KERNEL);
+	if (!mem->arr)
+		goto out_free;
+
+	while (page_cnt) {
+		struct page *page;
+		unsigned int order;
+
+		order = min_t(unsigned int, max_order,
+			      get_order(page_cnt << PAGE_SHIFT));
+		while (1) {
+			page = alloc_pages(GFP_KERNEL | __GFP_NOWARN |
+					   __GFP_NORETRY, order);
+			if (page || !order)
+				break;
+			order -= 1;
+		}
+		if (!page)
+			goto out_free;
+
+		mem->arr[mem->cnt].page = page;
+		mem->arr[mem->cnt].order = order;
+		mem->cnt += 1;
+		if (page_cnt <= (1UL << order))
+			break;
+		page_cnt -= 1UL << order;
+	}
+
+	return mem;
+
+out_free:
+	mmc_test_free_mem(mem);
+	return NULL;
+}
+
+/*
+ * Map @sz bytes of the buffer, in segments as large as the host allows
+ */
+static int mmc_test_map_sg(struct mmc_test_area *t, unsigned long sz,
+	struct scatterlist *sglist, unsigned int *sg_len)
+{
+	struct scatterlist *sg = NULL;
+	unsigned int i;
+
+	sg_init_table(sglist, t->max_segs);
+
+	*sg_len = 0;
+	for (i = 0; i < t->mem->cnt && sz; i++) {
+		struct page *page = t->mem->arr[i].page;
+		unsigned long len = PAGE_SIZE << t->mem->arr[i].order;
+		unsigned long off = 0;
+
+		while (off < len && sz) {
+			unsigned long n = min(len - off, sz);
+
+			if (n > t->max_seg_sz)
+				n = t->max_seg_sz;
+			if (*sg_len >= t->max_segs)
+				return -EINVAL;
+
+			sg = sg ? sg_next(sg) : sglist;
+			sg_set_page(sg, page + (off >> PAGE_SHIFT), n,
+				    off & ~PAGE_MASK);
+			*sg_len += 1;
+			off += n;
+			sz -= n;
+		}
+	}
+
+	if (sg)
+		sg_mark_end(sg);
+
+	return sz ? -EINVAL : 0;
+}
+
+/*
+ * Map @sz bytes one page per segment, walking the pages backwards so
+ * that no two segments are adjacent in memory.
+ */
+static int mmc_test_map_sg_max_scatter(struct mmc_test_area *t,
+	unsigned long sz, struct scatterlist *sglist, unsigned int *sg_len)
+{
+	struct scatterlist *sg = NULL;
+	unsigned int i = t->mem->cnt;
+	void *last_addr = NULL;
+
+	sg_init_table(sglist, t->max_segs);
+
+	*sg_len = 0;
+	while (sz) {
+		void *base = page_address(t->mem->arr[--i].page);
+		unsigned long cnt = 1UL << t->mem->arr[i].order;
+
+		while (sz && cnt) {
+			void *addr = base + PAGE_SIZE * --cnt;
+			unsigned long len = PAGE_SIZE;
+
+			if (last_addr && last_addr + PAGE_SIZE == addr)
+				continue;
+			last_addr = addr;
+
+			if (len > t->max_seg_sz)
+				len = t->max_seg_sz;
+			if (len > sz)
+				len = sz;
+			if (*sg_len >= t->max_segs)
+				return -EINVAL;
+
+			sg = sg ? sg_next(sg) : sglist;
+			sg_set_page(sg, virt_to_page(addr), len, 0);
+			*sg_len += 1;
+			sz -= len;
+		}
+		if (!i)
+			i = t->mem->cnt;
+	}
+
+	if (sg)
+		sg_mark_end(sg);
+
+	return 0;
+}
+
+static int mmc_test_check_areq(struct mmc_card *card,
+	struct mmc_async_req *areq)
+{
+	struct mmc_test_areq *tareq =
+		container_of(areq, struct mmc_test_areq, areq);
+	int ret;
+
+	if (tareq->data.flags & MMC_DATA_WRITE) {
+		ret = mmc_test_wait_busy(tareq->test);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_check_result(tareq->test, &tareq->mrq);
+}
+
+/*
+ * Transfer @count requests of @sz bytes, starting at sector @dev_addr and
+ * carrying on where the last one ended.  With @nonblock each request is
+ * started through mmc_start_req(), so the host can prepare it while the
+ * one before is still on the bus.
+ */
+static int mmc_test_area_io_seq(struct mmc_test_card *test, unsigned long sz,
+	unsigned int dev_addr, int write, int max_scatter, int nonblock,
+	unsigned int count)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_areq areq[2];
+	unsigned int i;
+	int ret = 0, err;
+
+	for (i = 0; i < ARRAY_SIZE(areq); i++) {
+		if (max_scatter)
+			ret = mmc_test_map_sg_max_scatter(t, sz, t->sg[i],
+							  &areq[i].sg_len);
+		else
+			ret = mmc_test_map_sg(t, sz, t->sg[i],
+					      &areq[i].sg_len);
+		if (ret)
+			return RESULT_UNSUP_HOST;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct mmc_test_areq *a = &areq[i & 1];
+		unsigned int arg = dev_addr;
+
+		if (!mmc_card_blockaddr(test->card))
+			arg <<= 9;
+
+		memset(&a->areq, 0, sizeof(struct mmc_async_req));
+		memset(&a->mrq, 0, sizeof(struct mmc_request));
+		memset(&a->cmd, 0, sizeof(struct mmc_command));
+		memset(&a->stop, 0, sizeof(struct mmc_command));
+		memset(&a->data, 0, sizeof(struct mmc_data));
+		a->mrq.cmd = &a->cmd;
+		a->mrq.data = &a->data;
+		a->mrq.stop = &a->stop;
+		a->areq.mrq = &a->mrq;
+		a->areq.err_check = mmc_test_check_areq;
+		a->test = test;
+
+		mmc_test_prepare_mrq(test, &a->mrq, t->sg[i & 1], a->sg_len,
+			arg, sz >> 9, 512, write);
+
+		if (nonblock) {
+			mmc_start_req(host, &a->areq, &ret);
+		} else {
+			mmc_wait_for_req(host, &a->mrq);
+			ret = mmc_test_check_areq(test->card, &a->areq);
+		}
+		if (ret)
+			break;
+
+		dev_addr += sz >> 9;
+	}
+
+	/* Collect the last request */
+	if (nonblock) {
+		mmc_start_req(host, NULL, &err);
+		if (!ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+/*
+ * Save a measurement in the debugfs results of the running test case
+ */
+static void mmc_test_save_transfer_result(struct mmc_test_card *test,
+	unsigned int count, unsigned int sectors, struct timespec ts,
+	unsigned int rate, unsigned int iops)
+{
+	struct mmc_test_transfer_result *tr;
+
+	if (!test->gr)
+		return;
+
+	tr = kmalloc(sizeof(struct mmc_test_transfer_result), GFP_KERNEL);
+	if (!tr)
+		return;
+
+	tr->count = count;
+	tr->sectors = sectors;
+	tr->ts = ts;
+	tr->rate = rate;
+	tr->iops = iops;
+
+	list_add_tail(&tr->link, &test->gr->tr_lst);
+}
+
+/*
+ * Print the throughput and IOPS of @count transfers of @sz bytes
+ */
+static void mmc_test_print_rate(struct mmc_test_card *test,
+	unsigned int count, unsigned long sz, struct timespec *ts1,
+	struct timespec *ts2)
+{
+	struct timespec ts = timespec_sub(*ts2, *ts1);
+	unsigned int rate = 0, iops = 0;
+	u64 ns = timespec_to_ns(&ts), tmp;
+
+	if (ns) {
+		tmp = (u64)count * sz * NSEC_PER_SEC;
+		do_div(tmp, ns);
+		rate = tmp;
+
+		tmp = (u64)count * 100 * NSEC_PER_SEC;
+		do_div(tmp, ns);
+		iops = tmp;
+	}
+
+	printk(KERN_INFO "%s: Transfer of %u x %lu sectors took %lu.%09lu "
+		"seconds (%u.%02u MB/s, %u.%02u IOPS)\n",
+		mmc_hostname(test->card->host), count, sz >> 9,
+		(unsigned long)ts.tv_sec, (unsigned long)ts.tv_nsec,
+		rate / 1000000, (rate / 10000) % 100, iops / 100, iops % 100);
+
+	mmc_test_save_transfer_result(test, count, sz >> 9, ts, rate, iops);
+}
+
+/*
+ * Transfer @count requests of @sz bytes from @dev_addr on, timed if
+ * @timed is set.
+ */
+static int mmc_test_area_io(struct mmc_test_card *test, unsigned long sz,
+	unsigned int dev_addr, int write, int max_scatter, int timed,
+	unsigned int count, int nonblock)
+{
+	struct timespec ts1, ts2;
+	int ret;
+
+	getnstimeofday(&ts1);
+	ret = mmc_test_area_io_seq(test, sz, dev_addr, write, max_scatter,
+				   nonblock, count);
+	getnstimeofday(&ts2);
+	if (ret)
+		return ret;
+
+	if (timed)
+		mmc_test_print_rate(test, count, sz, &ts1, &ts2);
+
+	return 0;
+}
+
+/*
+ * Write the whole area so reads have something to read
+ */
+static int mmc_test_area_fill(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+
+	return mmc_test_area_io(test, t->max_tfr, t->dev_addr, 1, 0, 0,
+				t->max_sz / t->max_tfr, 0);
+}
+
+static int mmc_test_area_cleanup(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+
+	kfree(t->sg[1]);
+	kfree(t->sg[0]);
+	mmc_test_free_mem(t->mem);
+	memset(t, 0, sizeof(struct mmc_test_area));
+
+	return 0;
+}
+
+/*
+ * Size the area and the largest transfer to the card and the host, and
+ * allocate the buffer.
+ */
+static int mmc_test_area_init(struct mmc_test_card *test, int fill)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_host *host = test->card->host;
+	unsigned int sectors = mmc_test_capacity(test->card);
+	int ret;
+
+	ret = mmc_test_set_blksize(test, 512);
+	if (ret)
+		return ret;
+
+	t->max_sz = MMC_TEST_AREA_MAX_SZ;
+	if (sectors < (t->max_sz >> 9) * 2)
+		return RESULT_UNSUP_CARD;
+
+	t->max_segs = min(host->max_hw_segs, host->max_phys_segs);
+	t->max_seg_sz = host->max_seg_size & ~511;
+	if (!t->max_segs || !t->max_seg_sz)
+		return RESULT_UNSUP_HOST;
+
+	t->max_tfr = t->max_sz;
+	if (t->max_tfr > host->max_req_size)
+		t->max_tfr = host->max_req_size;
+	if (t->max_tfr > host->max_blk_count * 512)
+		t->max_tfr = host->max_blk_count * 512;
+	if (t->max_tfr > (unsigned long)t->max_segs * t->max_seg_sz)
+		t->max_tfr = (unsigned long)t->max_segs * t->max_seg_sz;
+	t->max_tfr &= ~511UL;
+	if (!t->max_tfr)
+		return RESULT_UNSUP_HOST;
+
+	t->mem = mmc_test_alloc_mem(t->max_tfr, t->max_seg_sz);
+	t->sg[0] = kmalloc(sizeof(struct scatterlist) * t->max_segs,
+			   GFP_KERNEL);
+	t->sg[1] = kmalloc(sizeof(struct scatterlist) * t->max_segs,
+			   GFP_KERNEL);
+	if (!t->mem || !t->sg[0] || !t->sg[1]) {
+		mmc_test_area_cleanup(test);
+		return -ENOMEM;
+	}
+
+	/* Middle of the card, aligned to the area size */
+	t->dev_addr = sectors / 2;
+	t->dev_addr -= t->dev_addr % (t->max_sz >> 9);
+
+	if (fill) {
+		ret = mmc_test_area_fill(test);
+		if (ret)
+			mmc_test_area_cleanup(test);
+	}
+
+	return ret;
+}
+
+static int mmc_test_area_prepare(struct mmc_test_card *test)
+{
+	return mmc_test_area_init(test, 0);
+}
+
+static int mmc_test_area_prepare_fill(struct mmc_test_card *test)
+{
+	return mmc_test_area_init(test, 1);
+}
+
+/*
+ * Erase the whole area, so writes to it need no erase of their own
+ */
+static int mmc_test_area_erase(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+
+	if (!mmc_can_erase(test->card))
+		return RESULT_UNSUP_CARD;
+
+	return mmc_erase(test->card, t->dev_addr, t->max_sz >> 9,
+			 MMC_ERASE_ARG);
+}
+
+static int mmc_test_area_prepare_erase(struct mmc_test_card *test)
+{
+	int ret;
+
+	ret = mmc_test_area_init(test, 0);
+	if (ret)
+		return ret;
+
+	ret = mmc_test_area_erase(test);
+	if (ret)
+		mmc_test_area_cleanup(test);
+
+	return ret;
+}
+
 /*******************************************************************/
 /*  Tests                                                          */
 /*******************************************************************/
@@ -586,7 +1125,7 @@ static int mmc_test_pow2_write(struct mmc_test_card *test)
 	int ret, i;
 	struct scatterlist sg;
 
-	if (!test->card->csd.write_partial)
+	if (!test->card->csd.write_partial || mmc_card_ddr_mode(test->card))
 		return RESULT_UNSUP_CARD;
 
 	for (i = 1; i < 512;i <<= 1) {
@@ -604,7 +1143,7 @@ static int mmc_test_pow2_read(struct mmc_test_card *test)
 	int ret, i;
 	struct scatterlist sg;
 
-	if (!test->card->csd.read_partial)
+	if (!test->card->csd.read_partial || mmc_card_ddr_mode(test->card))
 		return RESULT_UNSUP_CARD;
 
 	for (i = 1; i < 512;i <<= 1) {
@@ -622,7 +1161,7 @@ static int mmc_test_weird_write(struct mmc_test_card *test)
 	int ret, i;
 	struct scatterlist sg;
 
-	if (!test->card->csd.write_partial)
+	if (!test->card->csd.write_partial || mmc_card_ddr_mode(test->card))
 		return RESULT_UNSUP_CARD;
 
 	for (i = 3; i < 512;i += 7) {
@@ -640,7 +1179,7 @@ static int mmc_test_weird_read(struct mmc_test_card *test)
 	int ret, i;
 	struct scatterlist sg;
 
-	if (!test->card->csd.read_partial)
+	if (!test->card->csd.read_partial || mmc_card_ddr_mode(test->card))
 		return RESULT_UNSUP_CARD;
 
 	for (i = 3; i < 512;i += 7) {
@@ -891,6 +1430,246 @@ static int mmc_test_multi_read_high(struct mmc_test_card *test)
 
 #endif /* CONFIG_HIGHMEM */
 
+/*
+ * Best-case performance: one transfer of the largest size
+ */
+static int mmc_test_best_performance(struct mmc_test_card *test, int write,
+	int max_scatter)
+{
+	struct mmc_test_area *t = &test->area;
+
+	return mmc_test_area_io(test, t->max_tfr, t->dev_addr, write,
+				max_scatter, 1, 1, 0);
+}
+
+static int mmc_test_best_read_performance(struct mmc_test_card *test)
+{
+	return mmc_test_best_performance(test, 0, 0);
+}
+
+static int mmc_test_best_write_performance(struct mmc_test_card *test)
+{
+	return mmc_test_best_performance(test, 1, 0);
+}
+
+static int mmc_test_best_read_perf_max_scatter(struct mmc_test_card *test)
+{
+	return mmc_test_best_performance(test, 0, 1);
+}
+
+static int mmc_test_best_write_perf_max_scatter(struct mmc_test_card *test)
+{
+	return mmc_test_best_performance(test, 1, 1);
+}
+
+/*
+ * One transfer of each size, from a single sector up to the largest.
+ * Single sector transfers use single-block commands.
+ */
+static int mmc_test_profile_single_perf(struct mmc_test_card *test,
+	int write)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned long sz;
+	int ret;
+
+	for (sz = 512; sz < t->max_tfr; sz <<= 1) {
+		ret = mmc_test_area_io(test, sz, t->dev_addr + (sz >> 9),
+				       write, 0, 1, 1, 0);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_area_io(test, t->max_tfr, t->dev_addr, write, 0, 1,
+				1, 0);
+}
+
+static int mmc_test_profile_single_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_single_perf(test, 0);
+}
+
+static int mmc_test_profile_single_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_single_perf(test, 1);
+}
+
+/*
+ * The whole area in transfers of each size
+ */
+static int mmc_test_profile_seq_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned long sz;
+	int ret;
+
+	for (sz = 512; sz < t->max_tfr; sz <<= 1) {
+		ret = mmc_test_area_io(test, sz, t->dev_addr, write, 0, 1,
+				       t->max_sz / sz, 0);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_area_io(test, t->max_tfr, t->dev_addr, write, 0, 1,
+				t->max_sz / t->max_tfr, 0);
+}
+
+static int mmc_test_profile_seq_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_seq_perf(test, 0);
+}
+
+static int mmc_test_profile_seq_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_seq_perf(test, 1);
+}
+
+/*
+ * Transfers of @sz bytes at random places in the area for
+ * MMC_TEST_RND_SECS
+ */
+static int mmc_test_rnd_perf(struct mmc_test_card *test, int write,
+	unsigned long sz)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int cnt = 0, slots = t->max_sz / sz;
+	struct timespec ts1, ts2;
+	int ret;
+
+	getnstimeofday(&ts1);
+	do {
+		unsigned int dev_addr;
+
+		getnstimeofday(&ts2);
+		if (ts2.tv_sec - ts1.tv_sec >= MMC_TEST_RND_SECS)
+			break;
+
+		dev_addr = t->dev_addr + (random32() % slots) * (sz >> 9);
+		ret = mmc_test_area_io_seq(test, sz, dev_addr, write, 0, 0, 1);
+		if (ret)
+			return ret;
+		cnt += 1;
+	} while (1);
+
+	mmc_test_print_rate(test, cnt, sz, &ts1, &ts2);
+
+	return 0;
+}
+
+static int mmc_test_profile_rnd_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned long sz;
+	int ret;
+
+	for (sz = 512; sz < t->max_tfr; sz <<= 1) {
+		ret = mmc_test_rnd_perf(test, write, sz);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_rnd_perf(test, write, t->max_tfr);
+}
+
+static int mmc_test_profile_rnd_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_rnd_perf(test, 0);
+}
+
+static int mmc_test_profile_rnd_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_rnd_perf(test, 1);
+}
+
+/*
+ * The whole area in the largest transfers, blocking and then non-blocking,
+ * to show what overlapping request preparation with the transfer gains.
+ */
+static int mmc_test_profile_nonblock_perf(struct mmc_test_card *test,
+	int write)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int cnt = t->max_sz / t->max_tfr;
+	int ret;
+
+	ret = mmc_test_area_io(test, t->max_tfr, t->dev_addr, write, 0, 1,
+			       cnt, 0);
+	if (ret)
+		return ret;
+
+	return mmc_test_area_io(test, t->max_tfr, t->dev_addr, write, 0, 1,
+				cnt, 1);
+}
+
+static int mmc_test_profile_nonblock_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 0);
+}
+
+static int mmc_test_profile_nonblock_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 1);
+}
+
+/* Erase the area, then write all of it in transfers of @sz bytes */
+static int mmc_test_seq_write_pre_erase(struct mmc_test_card *test,
+					unsigned long sz)
+{
+	struct mmc_test_area *t = &test->area;
+	int ret;
+
+	ret = mmc_test_area_erase(test);
+	if (ret)
+		return ret;
+
+	return mmc_test_area_io(test, sz, t->dev_addr, 1, 0, 1,
+				t->max_sz / sz, 0);
+}
+
+/*
+ * As mmc_test_profile_seq_perf() for writes, with the area erased before
+ * each size
+ */
+static int mmc_test_profile_seq_write_pre_erase_perf(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned long sz;
+	int ret;
+
+	for (sz = 512; sz < t->max_tfr; sz <<= 1) {
+		ret = mmc_test_seq_write_pre_erase(test, sz);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_seq_write_pre_erase(test, t->max_tfr);
+}
+
+/*
+ * One trim of each size, from a single sector up to the whole area
+ */
+static int mmc_test_profile_trim_perf(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	struct timespec ts1, ts2;
+	unsigned long sz;
+	int ret;
+
+	if (!mmc_can_trim(test->card))
+		return RESULT_UNSUP_CARD;
+
+	for (sz = 512; sz <= t->max_sz; sz <<= 1) {
+		getnstimeofday(&ts1);
+		ret = mmc_erase(test->card, t->dev_addr, sz >> 9, MMC_TRIM_ARG);
+		getnstimeofday(&ts2);
+		if (ret)
+			return ret;
+		mmc_test_print_rate(test, 1, sz, &ts1, &ts2);
+	}
+
+	return 0;
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -1038,10 +1817,118 @@ static const struct mmc_test_case mmc_test_cases[] = {
 
 #endif /* CONFIG_HIGHMEM */
 
+	{
+		.name = "Best-case read performance",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_best_read_performance,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Best-case write performance",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_best_write_performance,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Best-case read performance into scattered pages",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_best_read_perf_max_scatter,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Best-case write performance from scattered pages",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_best_write_perf_max_scatter,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Single read performance by transfer size",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_single_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Single write performance by transfer size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_single_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Consecutive read performance by transfer size",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_seq_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Consecutive write performance by transfer size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_seq_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random read performance by transfer size",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_rnd_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance by transfer size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_rnd_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Consecutive read performance, blocking vs non-blocking",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_nonblock_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Consecutive write performance, blocking vs non-blocking",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_nonblock_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Best-case write performance, pre-erased",
+		.prepare = mmc_test_area_prepare_erase,
+		.run = mmc_test_best_write_performance,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Consecutive write performance by transfer size, pre-erased",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_seq_write_pre_erase_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Trim performance by transfer size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_trim_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
 
+/* Results of the last run on each card, under mmc_test_lock */
+static LIST_HEAD(mmc_test_result);
+
 static void mmc_test_run(struct mmc_test_card *test, int testcase)
 {
 	int i, ret;
@@ -1052,6 +1939,8 @@ static void mmc_test_run(struct mmc_test_card *test, int testcase)
 	mmc_claim_host(test->card->host);
 
 	for (i = 0;i < ARRAY_SIZE(mmc_test_cases);i++) {
+		struct mmc_test_general_result *gr;
+
 		if (testcase && ((i + 1) != testcase))
 			continue;
 
@@ -1070,6 +1959,16 @@ static void mmc_test_run(struct mmc_test_card *test, int testcase)
 			}
 		}
 
+		gr = kzalloc(sizeof(struct mmc_test_general_result),
+			GFP_KERNEL);
+		if (gr) {
+			INIT_LIST_HEAD(&gr->tr_lst);
+			gr->card = test->card;
+			gr->testcase = i;
+			list_add_tail(&gr->link, &mmc_test_result);
+		}
+		test->gr = gr;
+
 		ret = mmc_test_cases[i].run(test);
 		switch (ret) {
 		case RESULT_OK:
@@ -1095,6 +1994,10 @@ static void mmc_test_run(struct mmc_test_card *test, int testcase)
 				mmc_hostname(test->card->host), ret);
 		}
 
+		if (gr)
+			gr->result = ret;
+		test->gr = NULL;
+
 		if (mmc_test_cases[i].cleanup) {
 			ret = mmc_test_cases[i].cleanup(test);
 			if (ret) {
@@ -1112,30 +2015,47 @@ static void mmc_test_run(struct mmc_test_card *test, int testcase)
 		mmc_hostname(test->card->host));
 }
 
-static ssize_t mmc_test_show(struct device *dev,
-	struct device_attribute *attr, char *buf)
+/*
+ * Drop the results of @card, or of every card if @card is NULL
+ */
+static void mmc_test_free_result(struct mmc_card *card)
 {
+	struct mmc_test_general_result *gr, *grs;
+
 	mutex_lock(&mmc_test_lock);
-	mutex_unlock(&mmc_test_lock);
 
-	return 0;
+	list_for_each_entry_safe(gr, grs, &mmc_test_result, link) {
+		struct mmc_test_transfer_result *tr, *trs;
+
+		if (card && gr->card != card)
+			continue;
+
+		list_for_each_entry_safe(tr, trs, &gr->tr_lst, link) {
+			list_del(&tr->link);
+			kfree(tr);
+		}
+
+		list_del(&gr->link);
+		kfree(gr);
+	}
+
+	mutex_unlock(&mmc_test_lock);
 }
 
-static ssize_t mmc_test_store(struct device *dev,
-	struct device_attribute *attr, const char *buf, size_t count)
+/*
+ * Run @testcase, or all of them if it is 0, on @card
+ */
+static int mmc_test_run_card(struct mmc_card *card, int testcase)
 {
-	struct mmc_card *card;
 	struct mmc_test_card *test;
-	int testcase;
-
-	card = container_of(dev, struct mmc_card, dev);
-
-	testcase = simple_strtol(buf, NULL, 10);
+	int ret = -ENOMEM;
 
 	test = kzalloc(sizeof(struct mmc_test_card), GFP_KERNEL);
 	if (!test)
 		return -ENOMEM;
 
+	mmc_test_free_result(card);
+
 	test->card = card;
 
 	test->buffer = kzalloc(BUFFER_SIZE, GFP_KERNEL);
@@ -1151,6 +2071,7 @@ static ssize_t mmc_test_store(struct device *dev,
 		mutex_lock(&mmc_test_lock);
 		mmc_test_run(test, testcase);
 		mutex_unlock(&mmc_test_lock);
+		ret = 0;
 	}
 
 #ifdef CONFIG_HIGHMEM
@@ -1159,11 +2080,214 @@ static ssize_t mmc_test_store(struct device *dev,
 	kfree(test->buffer);
 	kfree(test);
 
+	return ret;
+}
+
+static ssize_t mmc_test_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	mutex_lock(&mmc_test_lock);
+	mutex_unlock(&mmc_test_lock);
+
+	return 0;
+}
+
+static ssize_t mmc_test_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct mmc_card *card;
+	int testcase, ret;
+
+	card = container_of(dev, struct mmc_card, dev);
+
+	testcase = simple_strtol(buf, NULL, 10);
+
+	ret = mmc_test_run_card(card, testcase);
+	if (ret)
+		return ret;
+
 	return count;
 }
 
 static DEVICE_ATTR(test, S_IWUSR | S_IRUGO, mmc_test_show, mmc_test_store);
 
+/*
+ * debugfs "test": writing a test case number runs it like the sysfs
+ * attribute does, reading gives the results of the last run as
+ *
+ *	Test <n>: <result>
+ *	<count> <sectors> <seconds> <bytes per second> <IOPS>
+ *
+ * with one line of the second form for each measurement made.
+ */
+static int mtf_test_show(struct seq_file *sf, void *data)
+{
+	struct mmc_card *card = sf->private;
+	struct mmc_test_general_result *gr;
+
+	mutex_lock(&mmc_test_lock);
+
+	list_for_each_entry(gr, &mmc_test_result, link) {
+		struct mmc_test_transfer_result *tr;
+
+		if (gr->card != card)
+			continue;
+
+		seq_printf(sf, "Test %d: %d\n", gr->testcase + 1, gr->result);
+
+		list_for_each_entry(tr, &gr->tr_lst, link) {
+			seq_printf(sf, "%u %u %lu.%09lu %u %u.%02u\n",
+				tr->count, tr->sectors,
+				(unsigned long)tr->ts.tv_sec,
+				(unsigned long)tr->ts.tv_nsec,
+				tr->rate, tr->iops / 100, tr->iops % 100);
+		}
+	}
+
+	mutex_unlock(&mmc_test_lock);
+
+	return 0;
+}
+
+static int mtf_test_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtf_test_show, inode->i_private);
+}
+
+static ssize_t mtf_test_write(struct file *file, const char __user *buf,
+	size_t count, loff_t *pos)
+{
+	struct seq_file *sf = file->private_data;
+	struct mmc_card *card = sf->private;
+	char lbuf[12];
+	long testcase;
+	int ret;
+
+	if (count >= sizeof(lbuf))
+		return -EINVAL;
+
+	if (copy_from_user(lbuf, buf, count))
+		return -EFAULT;
+	lbuf[count] = '\0';
+
+	if (strict_strtol(strstrip(lbuf), 10, &testcase))
+		return -EINVAL;
+
+	ret = mmc_test_run_card(card, testcase);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
+static const struct file_operations mmc_test_fops_test = {
+	.open		= mtf_test_open,
+	.read		= seq_read,
+	.write		= mtf_test_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * debugfs "testlist": the test case numbers and names
+ */
+static int mtf_testlist_show(struct seq_file *sf, void *data)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mmc_test_cases); i++)
+		seq_printf(sf, "%d:\t%s\n", i + 1, mmc_test_cases[i].name);
+
+	return 0;
+}
+
+static int mtf_testlist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtf_testlist_show, inode->i_private);
+}
+
+static const struct file_operations mmc_test_fops_testlist = {
+	.open		= mtf_testlist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * debugfs files of one card, so they can go away with the driver while
+ * the card's directory stays.
+ */
+struct mmc_test_dbgfs_file {
+	struct list_head	link;
+	struct mmc_card		*card;
+	struct dentry		*file;
+};
+
+static LIST_HEAD(mmc_test_file_test);
+
+static void mmc_test_free_dbgfs_file(struct mmc_card *card)
+{
+	struct mmc_test_dbgfs_file *df, *dfs;
+
+	mutex_lock(&mmc_test_lock);
+
+	list_for_each_entry_safe(df, dfs, &mmc_test_file_test, link) {
+		if (card && df->card != card)
+			continue;
+		debugfs_remove(df->file);
+		list_del(&df->link);
+		kfree(df);
+	}
+
+	mutex_unlock(&mmc_test_lock);
+}
+
+static int __mmc_test_register_dbgfs_file(struct mmc_card *card,
+	const char *name, mode_t mode, const struct file_operations *fops)
+{
+	struct mmc_test_dbgfs_file *df;
+	struct dentry *file;
+
+	file = debugfs_create_file(name, mode, card->debugfs_root, card, fops);
+	if (IS_ERR_OR_NULL(file)) {
+		dev_err(&card->dev, "Can't create %s. Perhaps debugfs is "
+			"disabled.\n", name);
+		return -ENODEV;
+	}
+
+	df = kmalloc(sizeof(struct mmc_test_dbgfs_file), GFP_KERNEL);
+	if (!df) {
+		debugfs_remove(file);
+		return -ENOMEM;
+	}
+
+	df->card = card;
+	df->file = file;
+
+	mutex_lock(&mmc_test_lock);
+	list_add(&df->link, &mmc_test_file_test);
+	mutex_unlock(&mmc_test_lock);
+
+	return 0;
+}
+
+/*
+ * The results are only reachable through debugfs, but the tests still
+ * run through sysfs without it, so failing here is not fatal.
+ */
+static void mmc_test_register_dbgfs_file(struct mmc_card *card)
+{
+	if (!card->debugfs_root)
+		return;
+
+	if (__mmc_test_register_dbgfs_file(card, "test", S_IWUSR | S_IRUGO,
+					   &mmc_test_fops_test))
+		return;
+
+	__mmc_test_register_dbgfs_file(card, "testlist", S_IRUGO,
+				       &mmc_test_fops_testlist);
+}
+
 static int mmc_test_probe(struct mmc_card *card)
 {
 	int ret;
@@ -1175,6 +2299,8 @@ static int mmc_test_probe(struct mmc_card *card)
 	if (ret)
 		return ret;
 
+	mmc_test_register_dbgfs_file(card);
+
 	dev_info(&card->dev, "Card claimed for testing.\n");
 
 	return 0;
@@ -1182,6 +2308,8 @@ static int mmc_test_probe(struct mmc_card *card)
 
 static void mmc_test_remove(struct mmc_card *card)
 {
+	mmc_test_free_dbgfs_file(card);
+	mmc_test_free_result(card);
 	device_remove_file(&card->dev, &dev_attr_test);
 }
 
@@ -150,6 +150,15 @@ static int mmc_decode_csd(struct mmc_card *card)
 	csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 	csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
 
+	if (csd->write_blkbits >= 9) {
+		unsigned int a, b;
+
+		a = UNSTUFF_BITS(resp, 42, 5);	/* ERASE_GRP_SIZE */
+		b = UNSTUFF_BITS(resp, 37, 5);	/* ERASE_GRP_MULT */
+		csd->erase_size = (a + 1) * (b + 1);
+		csd->erase_size <<= csd->write_blkbits - 9;
+	}
+
 	return 0;
 }
 
@@ -206,8 +215,9 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 		goto out;
 	}
 
+	/* Revisions up to 6 (MMC v4.5) only add fields */
 	card->ext_csd.rev = ext_csd[EXT_CSD_REV];
-	if (card->ext_csd.rev > 3) {
+	if (card->ext_csd.rev > 6) {
 		printk(KERN_ERR "%s: unrecognised EXT_CSD structure "
 			"version %d\n", mmc_hostname(card->host),
 			card->ext_csd.rev);
@@ -225,14 +235,47 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 			mmc_card_set_blockaddr(card);
 	}
 
-	switch (ext_csd[EXT_CSD_CARD_TYPE]) {
-	case EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_26:
+	if (card->ext_csd.rev >= 3) {
+		card->ext_csd.erase_group_def =
+			ext_csd[EXT_CSD_ERASE_GROUP_DEF];
+		card->ext_csd.hc_erase_timeout = 300 *
+			ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT];
+		card->ext_csd.hc_erase_size =
+			ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
+	}
+
+	if (card->ext_csd.rev >= 4) {
+		card->ext_csd.sec_trim_mult =
+			ext_csd[EXT_CSD_SEC_TRIM_MULT];
+		card->ext_csd.sec_erase_mult =
+			ext_csd[EXT_CSD_SEC_ERASE_MULT];
+		card->ext_csd.sec_feature_support =
+			ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT];
+		card->ext_csd.trim_timeout = 300 *
+			ext_csd[EXT_CSD_TRIM_MULT];
+	}
+
+	if (card->ext_csd.rev >= 6)
+		card->ext_csd.max_packed_writes =
+			min_t(u8, ext_csd[EXT_CSD_MAX_PACKED_WRITES],
+			      MMC_PACKED_MAX_ENTRIES);
+
+	if (ext_csd[EXT_CSD_ERASED_MEM_CONT])
+		card->erased_byte = 0xFF;
+	else
+		card->erased_byte = 0x0;
+
+	/* The DDR bits are reserved before revision 4 (MMC v4.4) */
+	card->ext_csd.card_type = ext_csd[EXT_CSD_CARD_TYPE] &
+				  EXT_CSD_CARD_TYPE_MASK;
+	if (card->ext_csd.rev < 4)
+		card->ext_csd.card_type &= ~EXT_CSD_CARD_TYPE_DDR_52;
+
+	if (card->ext_csd.card_type & EXT_CSD_CARD_TYPE_52) {
 		card->ext_csd.hs_max_dtr = 52000000;
-		break;
-	case EXT_CSD_CARD_TYPE_26:
+	} else if (card->ext_csd.card_type & EXT_CSD_CARD_TYPE_26) {
 		card->ext_csd.hs_max_dtr = 26000000;
-		break;
-	default:
+	} else {
 		/* MMC v4 spec says this cannot happen */
 		printk(KERN_WARNING "%s: card is mmc v4 but doesn't "
 			"support any high-speed modes.\n",
@@ -255,6 +298,16 @@ out:
 	return err;
 }
 
+static void mmc_set_erase_size(struct mmc_card *card)
+{
+	if (card->ext_csd.erase_group_def & 1)
+		card->erase_size = card->ext_csd.hc_erase_size;
+	else
+		card->erase_size = card->csd.erase_size;
+
+	mmc_init_erase(card);
+}
+
 MMC_DEV_ATTR(cid, "%08x%08x%08x%08x\n", card->raw_cid[0], card->raw_cid[1],
 	card->raw_cid[2], card->raw_cid[3]);
 MMC_DEV_ATTR(csd, "%08x%08x%08x%08x\n", card->raw_csd[0], card->raw_csd[1],
@@ -293,6 +346,55 @@ static struct device_type mmc_type = {
 	.groups = mmc_attr_groups,
 };
 
+/*
+ * Switch card and host to dual data rate at the given bus width, then
+ * read the EXT_CSD back to check that data gets through.  If it does not
+ * the host is put back to single data rate high-speed timing on a 1 bit
+ * bus and -EBADMSG is returned, so the caller can set up the bus without
+ * DDR.
+ */
+static int mmc_select_ddr(struct mmc_card *card, unsigned ext_csd_bit,
+	unsigned bus_width)
+{
+	struct mmc_host *host = card->host;
+	u8 *ext_csd;
+	int err;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			 EXT_CSD_BUS_WIDTH, ext_csd_bit);
+	if (err)
+		goto out;
+
+	mmc_set_timing(host, MMC_TIMING_MMC_DDR52);
+	mmc_set_bus_width(host, bus_width);
+
+	/* Read only fields must come back as they were read in SDR */
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (!err &&
+	    (ext_csd[EXT_CSD_REV] != card->ext_csd.rev ||
+	     (ext_csd[EXT_CSD_CARD_TYPE] & EXT_CSD_CARD_TYPE_MASK) !=
+	     card->ext_csd.card_type))
+		err = -EILSEQ;
+
+	if (err) {
+		mmc_set_timing(host, MMC_TIMING_MMC_HS);
+		mmc_set_bus_width(host, MMC_BUS_WIDTH_1);
+		card->state &= ~MMC_STATE_HIGHSPEED_DDR;
+		err = -EBADMSG;
+	} else {
+		mmc_card_set_ddr_mode(card);
+	}
+
+out:
+	kfree(ext_csd);
+
+	return err;
+}
+
 /*
  * Handle the detection and initialisation of a card.
  *
@@ -306,6 +408,7 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 	int err;
 	u32 cid[4];
 	unsigned int max_dtr;
+	int ddr = 0;
 
 	BUG_ON(!host);
 	WARN_ON(!host->claimed);
@@ -407,6 +510,9 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		err = mmc_read_ext_csd(card);
 		if (err)
 			goto free_card;
+
+		/* Erase size depends on CSD and Extended CSD */
+		mmc_set_erase_size(card);
 	}
 
 	/*
@@ -444,22 +550,50 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 	mmc_set_clock(host, max_dtr);
 
 	/*
-	 * Activate wide bus (if supported).
+	 * Indicate DDR mode (if supported).
+	 */
+	if (mmc_card_highspeed(card)) {
+		if ((card->ext_csd.card_type & EXT_CSD_CARD_TYPE_DDR_1_8V) &&
+		    (host->caps & MMC_CAP_1_8V_DDR))
+			ddr = 1;
+		else if ((card->ext_csd.card_type & EXT_CSD_CARD_TYPE_DDR_1_2V) &&
+			 (host->caps & MMC_CAP_1_2V_DDR))
+			ddr = 1;
+	}
+
+	/*
+	 * Activate wide bus and DDR (if supported).
 	 */
 	if ((card->csd.mmca_vsn >= CSD_SPEC_VER_4) &&
 	    (host->caps & (MMC_CAP_4_BIT_DATA | MMC_CAP_8_BIT_DATA))) {
-		unsigned ext_csd_bit, bus_width;
+		unsigned ext_csd_bit, ddr_ext_csd_bit, bus_width;
 
 		if (host->caps & MMC_CAP_8_BIT_DATA) {
 			ext_csd_bit = EXT_CSD_BUS_WIDTH_8;
+			ddr_ext_csd_bit = EXT_CSD_DDR_BUS_WIDTH_8;
 			bus_width = MMC_BUS_WIDTH_8;
 		} else {
 			ext_csd_bit = EXT_CSD_BUS_WIDTH_4;
+			ddr_ext_csd_bit = EXT_CSD_DDR_BUS_WIDTH_4;
 			bus_width = MMC_BUS_WIDTH_4;
 		}
 
-		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
-				 EXT_CSD_BUS_WIDTH, ext_csd_bit);
+		if (ddr) {
+			err = mmc_select_ddr(card, ddr_ext_csd_bit, bus_width);
+			if (err && err != -EBADMSG)
+				goto free_card;
+
+			if (err) {
+				printk(KERN_WARNING "%s: switch to DDR mode "
+				       "failed, using SDR\n",
+				       mmc_hostname(card->host));
+				ddr = 0;
+			}
+		}
+
+		if (!ddr)
+			err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_BUS_WIDTH, ext_csd_bit);
 
 		if (err && err != -EBADMSG)
 			goto free_card;
@@ -0,0 +1,657 @@
+/*
+ *  linux/drivers/mmc/host/mmcsim.c - Simulated MMC host and card
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A host controller with an MMC v4 card behind it, both kept in memory.
+ * It lets the MMC core, the block driver and mmc_test be exercised and
+ * timed on machines without a card slot.  The card uses byte addressing,
+ * supports the commands the core needs to bring it up, single and
+ * multiple block reads and writes, packed writes, and erase, trim and
+ * their secure variants.  Erased memory reads back as zeroes.
+ *
+ * Requests are carried out on a workqueue, the way a DMA engine would
+ * complete them, so the caller is free to prepare the next request while
+ * one is in progress.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/platform_device.h>
+#include <linux/workqueue.h>
+#include <linux/vmalloc.h>
+#include <linux/highmem.h>
+#include <linux/scatterlist.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
+#include <linux/mmc/card.h>
+
+#define DRIVER_NAME	"mmcsim"
+
+/*
+ * With 512 byte blocks and the largest C_SIZE_MULT, a CSD can describe
+ * up to 1GB in steps of 256kB.  Larger cards need sector addressing.
+ */
+#define MMCSIM_SIZE_STEP	(256 * 1024)
+#define MMCSIM_MAX_SIZE_MB	1024
+
+static unsigned int size_mb = 16;
+module_param(size_mb, uint, 0444);
+MODULE_PARM_DESC(size_mb, "Size of the simulated card in MB (max 1024)");
+
+/* Card states, as reported in R1_CURRENT_STATE() */
+enum mmcsim_state {
+	MMCSIM_IDLE	= 0,
+	MMCSIM_READY	= 1,
+	MMCSIM_IDENT	= 2,
+	MMCSIM_STBY	= 3,
+	MMCSIM_TRAN	= 4,
+};
+
+#define MMCSIM_OCR	(MMC_CARD_BUSY | 0x00ff8000)
+
+struct mmcsim_host {
+	struct mmc_host		*mmc;
+	struct mmc_request	*mrq;		/* request in progress */
+	struct work_struct	work;
+	struct workqueue_struct	*wq;
+
+	u8			*storage;
+	unsigned long		size;		/* card size in bytes */
+
+	/* card registers */
+	u32			cid[4];
+	u32			csd[4];
+	u8			ext_csd[512];
+	u16			rca;
+	enum mmcsim_state	state;
+	u32			status;		/* clear on read error bits */
+	u32			erase_start;	/* byte addresses */
+	u32			erase_end;
+	int			erase_seq;	/* start and end given */
+	u32			sbc;		/* SET_BLOCK_COUNT arg, or 0 */
+	__le32			packed_hdr[128];
+};
+
+/*
+ * Store @val in @size bits from bit @start of a 128 bit register, laid
+ * out the way the core's UNSTUFF_BITS() reads them back.
+ */
+static void mmcsim_stuff_bits(u32 *reg, unsigned int start,
+	unsigned int size, u32 val)
+{
+	unsigned int off = 3 - start / 32;
+	unsigned int shft = start & 31;
+
+	if (size < 32)
+		val &= (1 << size) - 1;
+
+	reg[off] |= val << shft;
+	if (size + shft > 32)
+		reg[off - 1] |= val >> (32 - shft);
+}
+
+static void mmcsim_init_card(struct mmcsim_host *host)
+{
+	static const char name[6] = "MMCSIM";
+	unsigned int i;
+
+	memset(host->cid, 0, sizeof(host->cid));
+	mmcsim_stuff_bits(host->cid, 120, 8, 0x00);	/* MID */
+	mmcsim_stuff_bits(host->cid, 104, 16, 0x0000);	/* OID */
+	for (i = 0; i < sizeof(name); i++)
+		mmcsim_stuff_bits(host->cid, 96 - i * 8, 8, name[i]);
+	mmcsim_stuff_bits(host->cid, 48, 8, 0x10);	/* PRV 1.0 */
+	mmcsim_stuff_bits(host->cid, 16, 32, 0x00000001); /* PSN */
+	mmcsim_stuff_bits(host->cid, 8, 8, 0x1d);	/* MDT */
+
+	memset(host->csd, 0, sizeof(host->csd));
+	mmcsim_stuff_bits(host->csd, 126, 2, 2);	/* CSD_STRUCTURE 1.2 */
+	mmcsim_stuff_bits(host->csd, 122, 4, CSD_SPEC_VER_4);
+	mmcsim_stuff_bits(host->csd, 112, 7, 0x12);	/* TAAC 120ns */
+	mmcsim_stuff_bits(host->csd, 96, 7, 0x2a);	/* TRAN_SPEED 20MHz */
+	mmcsim_stuff_bits(host->csd, 84, 12, 0x0f5);	/* CCC */
+	mmcsim_stuff_bits(host->csd, 80, 4, 9);		/* READ_BL_LEN */
+	mmcsim_stuff_bits(host->csd, 62, 12,
+			  host->size / MMCSIM_SIZE_STEP - 1);	/* C_SIZE */
+	mmcsim_stuff_bits(host->csd, 47, 3, 7);		/* C_SIZE_MULT */
+	mmcsim_stuff_bits(host->csd, 42, 5, 31);	/* ERASE_GRP_SIZE */
+	mmcsim_stuff_bits(host->csd, 37, 5, 3);		/* ERASE_GRP_MULT */
+	mmcsim_stuff_bits(host->csd, 26, 3, 2);		/* R2W_FACTOR */
+	mmcsim_stuff_bits(host->csd, 22, 4, 9);		/* WRITE_BL_LEN */
+
+	/* Revision 6 (v4.5) with SEC_COUNT 0: byte addressed */
+	memset(host->ext_csd, 0, sizeof(host->ext_csd));
+	host->ext_csd[EXT_CSD_REV] = 6;
+	host->ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_DDR_1_8V |
+					   EXT_CSD_CARD_TYPE_52 |
+					   EXT_CSD_CARD_TYPE_26;
+	host->ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT] = 1;
+	host->ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] = 1;	/* 512kB */
+	host->ext_csd[EXT_CSD_SEC_TRIM_MULT] = 1;
+	host->ext_csd[EXT_CSD_SEC_ERASE_MULT] = 1;
+	host->ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] = EXT_CSD_SEC_ER_EN |
+						     EXT_CSD_SEC_GB_CL_EN;
+	host->ext_csd[EXT_CSD_TRIM_MULT] = 1;
+	host->ext_csd[EXT_CSD_MAX_PACKED_WRITES] = 32;
+
+	host->rca = 0;
+	host->state = MMCSIM_IDLE;
+	host->status = 0;
+	host->erase_seq = 0;
+	host->sbc = 0;
+}
+
+/*
+ * R1 response: the error bits gathered since the last one and the state
+ * the card was in when the command arrived.
+ */
+static u32 mmcsim_r1(struct mmcsim_host *host, enum mmcsim_state state)
+{
+	u32 status = host->status | (state << 9) | R1_READY_FOR_DATA;
+
+	host->status = 0;
+	return status;
+}
+
+static void mmcsim_switch(struct mmcsim_host *host, u32 arg)
+{
+	unsigned int index = (arg >> 16) & 0xff;
+	u8 value = (arg >> 8) & 0xff;
+
+	if ((arg >> 24) != MMC_SWITCH_MODE_WRITE_BYTE ||
+	    (index != EXT_CSD_BUS_WIDTH && index != EXT_CSD_HS_TIMING &&
+	     index != EXT_CSD_ERASE_GROUP_DEF)) {
+		host->status |= R1_SWITCH_ERROR;
+		return;
+	}
+
+	/* Dual data rate needs high-speed timing */
+	if (index == EXT_CSD_BUS_WIDTH &&
+	    (value == EXT_CSD_DDR_BUS_WIDTH_4 ||
+	     value == EXT_CSD_DDR_BUS_WIDTH_8) &&
+	    !host->ext_csd[EXT_CSD_HS_TIMING]) {
+		host->status |= R1_SWITCH_ERROR;
+		return;
+	}
+
+	host->ext_csd[index] = value;
+}
+
+/*
+ * CMD38 on the range given by CMD35 and CMD36.  Erases work on whole
+ * erase groups, trims on write blocks.
+ */
+static void mmcsim_erase(struct mmcsim_host *host, u32 arg)
+{
+	unsigned long start = host->erase_start;
+	unsigned long end = (unsigned long)host->erase_end + 512;
+	unsigned long group;
+
+	if (host->erase_seq != 2) {
+		host->status |= R1_ERASE_SEQ_ERROR;
+		return;
+	}
+	host->erase_seq = 0;
+
+	if (start >= end || end > host->size) {
+		host->status |= R1_ERASE_PARAM;
+		return;
+	}
+
+	/* The data of a secure trim goes at step 2, we drop it at step 1 */
+	if (arg == MMC_SECURE_TRIM2_ARG)
+		return;
+
+	if (!(arg & MMC_TRIM_ARGS)) {
+		if (host->ext_csd[EXT_CSD_ERASE_GROUP_DEF] & 1)
+			group = host->ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 19;
+		else
+			group = 32 * 4 * 512;
+		start -= start % group;
+		end = min(roundup(end, group), host->size);
+	}
+
+	memset(host->storage + start, 0, end - start);
+}
+
+/*
+ * Move @len bytes between @buf and the request's scatterlist from @skip
+ * bytes into it, in the direction of the transfer.
+ */
+static void mmcsim_copy(struct mmcsim_host *host, struct mmc_data *data,
+	size_t skip, u8 *buf, size_t len)
+{
+	struct sg_mapping_iter miter;
+	int write = data->flags & MMC_DATA_WRITE;
+
+	sg_miter_start(&miter, data->sg, data->sg_len,
+		       write ? SG_MITER_FROM_SG : SG_MITER_TO_SG);
+
+	while (len && sg_miter_next(&miter)) {
+		size_t n;
+
+		if (skip >= miter.length) {
+			skip -= miter.length;
+			continue;
+		}
+
+		n = min(miter.length - skip, len);
+		if (write)
+			memcpy(buf, miter.addr + skip, n);
+		else
+			memcpy(miter.addr + skip, buf, n);
+		buf += n;
+		len -= n;
+		skip = 0;
+	}
+
+	sg_miter_stop(&miter);
+}
+
+/*
+ * Packed write of @blocks blocks: a header block, then the data of each
+ * entry in turn.  A failed entry is reported in the EXT_CSD packed
+ * command status and, as the card would flag it in its status, as a
+ * data error.
+ */
+static void mmcsim_packed_write(struct mmcsim_host *host,
+	struct mmc_data *data, u32 blocks)
+{
+	__le32 *hdr = host->packed_hdr;
+	unsigned int i, num, total = 1;
+	size_t off = 512;
+
+	host->ext_csd[EXT_CSD_PACKED_CMD_STATUS] = 0;
+	host->ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] = 0;
+
+	mmcsim_copy(host, data, 0, (u8 *)hdr, 512);
+
+	num = le32_to_cpu(hdr[0]) >> 16;
+	for (i = 1; i <= num && i <= MMC_PACKED_MAX_ENTRIES; i++)
+		total += le32_to_cpu(hdr[i * 2]) & 0xffff;
+
+	if ((le32_to_cpu(hdr[0]) & 0xffff) !=
+	    ((MMC_PACKED_CMD_WR << 8) | MMC_PACKED_CMD_VER) || !num ||
+	    num > host->ext_csd[EXT_CSD_MAX_PACKED_WRITES] ||
+	    total != blocks) {
+		host->ext_csd[EXT_CSD_PACKED_CMD_STATUS] =
+			EXT_CSD_PACKED_GENERIC_ERROR;
+		data->error = -EIO;
+		return;
+	}
+
+	for (i = 1; i <= num; i++) {
+		size_t len = (le32_to_cpu(hdr[i * 2]) & 0xffff) * 512;
+		u32 addr = le32_to_cpu(hdr[i * 2 + 1]);
+
+		if (addr >= host->size || len > host->size - addr) {
+			host->ext_csd[EXT_CSD_PACKED_CMD_STATUS] =
+				EXT_CSD_PACKED_GENERIC_ERROR |
+				EXT_CSD_PACKED_INDEXED_ERROR;
+			host->ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] = i;
+			host->status |= R1_OUT_OF_RANGE;
+			data->error = -EIO;
+			return;
+		}
+
+		mmcsim_copy(host, data, off, host->storage + addr, len);
+		off += len;
+	}
+
+	data->bytes_xfered = blocks * 512;
+}
+
+static void mmcsim_transfer(struct mmcsim_host *host, struct mmc_command *cmd,
+	struct mmc_data *data)
+{
+	size_t len = data->blocks * data->blksz;
+	u32 sbc = host->sbc;
+
+	if (host->state != MMCSIM_TRAN) {
+		cmd->error = -ETIMEDOUT;
+		return;
+	}
+
+	/* A block count set by CMD23 is used up by the next transfer */
+	host->sbc = 0;
+	if (sbc && (sbc & 0xffff) != data->blocks) {
+		data->error = -ETIMEDOUT;
+		return;
+	}
+
+	if (sbc & MMC_CMD23_ARG_PACKED) {
+		if (cmd->opcode == MMC_WRITE_MULTIPLE_BLOCK)
+			mmcsim_packed_write(host, data, sbc & 0xffff);
+		else
+			data->error = -ETIMEDOUT;
+		return;
+	}
+
+	/* Single block commands stop the data after the first block */
+	if ((cmd->opcode == MMC_READ_SINGLE_BLOCK ||
+	     cmd->opcode == MMC_WRITE_BLOCK) && data->blocks > 1) {
+		len = data->blksz;
+		data->error = -ETIMEDOUT;
+	}
+
+	if (cmd->arg >= host->size || len > host->size - cmd->arg) {
+		host->status |= R1_OUT_OF_RANGE;
+		data->error = -ETIMEDOUT;
+		return;
+	}
+
+	mmcsim_copy(host, data, 0, host->storage + cmd->arg, len);
+	data->bytes_xfered = len;
+}
+
+/*
+ * Carry out @cmd and, for the commands that have one, its data phase
+ */
+static void mmcsim_command(struct mmcsim_host *host, struct mmc_command *cmd,
+	struct mmc_data *data)
+{
+	enum mmcsim_state state = host->state;
+	u32 arg = cmd->arg;
+
+	switch (cmd->opcode) {
+	case MMC_GO_IDLE_STATE:
+		host->state = MMCSIM_IDLE;
+		break;
+	case MMC_SEND_OP_COND:
+		if (state != MMCSIM_IDLE && state != MMCSIM_READY)
+			goto timeout;
+		if (arg)
+			host->state = MMCSIM_READY;
+		cmd->resp[0] = MMCSIM_OCR;
+		break;
+	case MMC_ALL_SEND_CID:
+		if (state != MMCSIM_READY)
+			goto timeout;
+		memcpy(cmd->resp, host->cid, sizeof(host->cid));
+		host->state = MMCSIM_IDENT;
+		break;
+	case MMC_SET_RELATIVE_ADDR:
+		if (state != MMCSIM_IDENT)
+			goto timeout;
+		host->rca = arg >> 16;
+		host->state = MMCSIM_STBY;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		break;
+	case MMC_SEND_CSD:
+	case MMC_SEND_CID:
+		if (state != MMCSIM_STBY || (arg >> 16) != host->rca)
+			goto timeout;
+		if (cmd->opcode == MMC_SEND_CSD)
+			memcpy(cmd->resp, host->csd, sizeof(host->csd));
+		else
+			memcpy(cmd->resp, host->cid, sizeof(host->cid));
+		break;
+	case MMC_SELECT_CARD:
+		if ((arg >> 16) != host->rca) {
+			/* Deselected, the card doesn't answer */
+			if (state == MMCSIM_TRAN)
+				host->state = MMCSIM_STBY;
+			if (arg >> 16)
+				goto timeout;
+			break;
+		}
+		host->state = MMCSIM_TRAN;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		break;
+	case MMC_SET_BLOCKLEN:
+		/* Illegal in dual data rate mode, blocks are 512 bytes there */
+		if (host->ext_csd[EXT_CSD_BUS_WIDTH] == EXT_CSD_DDR_BUS_WIDTH_4 ||
+		    host->ext_csd[EXT_CSD_BUS_WIDTH] == EXT_CSD_DDR_BUS_WIDTH_8) {
+			host->status |= R1_ILLEGAL_COMMAND;
+			goto timeout;
+		}
+		/* fall through */
+	case MMC_SEND_STATUS:
+	case MMC_STOP_TRANSMISSION:
+		if (state < MMCSIM_STBY)
+			goto timeout;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		break;
+	case MMC_SWITCH:
+		if (state != MMCSIM_TRAN)
+			goto timeout;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		mmcsim_switch(host, arg);
+		break;
+	case MMC_SET_BLOCK_COUNT:
+		if (state != MMCSIM_TRAN)
+			goto timeout;
+		host->sbc = arg;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		break;
+	case MMC_ERASE_GROUP_START:
+	case MMC_ERASE_GROUP_END:
+		if (state != MMCSIM_TRAN)
+			goto timeout;
+		if (cmd->opcode == MMC_ERASE_GROUP_START) {
+			host->erase_start = arg;
+			host->erase_seq = 1;
+		} else if (host->erase_seq == 1) {
+			host->erase_end = arg;
+			host->erase_seq = 2;
+		} else {
+			host->status |= R1_ERASE_SEQ_ERROR;
+		}
+		cmd->resp[0] = mmcsim_r1(host, state);
+		break;
+	case MMC_ERASE:
+		if (state != MMCSIM_TRAN)
+			goto timeout;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		mmcsim_erase(host, arg);
+		break;
+	case MMC_SEND_EXT_CSD:
+		/* Without data this is SD_SEND_IF_COND, not for us */
+		if (!data || state != MMCSIM_TRAN)
+			goto timeout;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		mmcsim_copy(host, data, 0, host->ext_csd,
+			    min_t(size_t, data->blocks * data->blksz,
+				  sizeof(host->ext_csd)));
+		data->bytes_xfered = data->blocks * data->blksz;
+		return;
+	case MMC_READ_SINGLE_BLOCK:
+	case MMC_READ_MULTIPLE_BLOCK:
+	case MMC_WRITE_BLOCK:
+	case MMC_WRITE_MULTIPLE_BLOCK:
+		if (!data)
+			goto timeout;
+		cmd->resp[0] = mmcsim_r1(host, state);
+		mmcsim_transfer(host, cmd, data);
+		return;
+	default:
+		goto timeout;
+	}
+
+	/* A data phase on a command without one never starts */
+	if (data)
+		data->error = -ETIMEDOUT;
+	return;
+
+timeout:
+	cmd->error = -ETIMEDOUT;
+}
+
+static void mmcsim_work(struct work_struct *work)
+{
+	struct mmcsim_host *host = container_of(work, struct mmcsim_host, work);
+	struct mmc_request *mrq = host->mrq;
+
+	mmcsim_command(host, mrq->cmd, mrq->data);
+	if (mrq->data && mrq->stop && !mrq->cmd->error)
+		mmcsim_command(host, mrq->stop, NULL);
+
+	host->mrq = NULL;
+	mmc_request_done(host->mmc, mrq);
+}
+
+static void mmcsim_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct mmcsim_host *host = mmc_priv(mmc);
+
+	WARN_ON(host->mrq != NULL);
+
+	host->mrq = mrq;
+	queue_work(host->wq, &host->work);
+}
+
+static void mmcsim_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
+{
+	struct mmcsim_host *host = mmc_priv(mmc);
+
+	/* Powering the card off loses its state, not its contents */
+	if (ios->power_mode == MMC_POWER_OFF)
+		mmcsim_init_card(host);
+}
+
+static int mmcsim_get_ro(struct mmc_host *mmc)
+{
+	return 0;
+}
+
+static int mmcsim_get_cd(struct mmc_host *mmc)
+{
+	return 1;
+}
+
+static const struct mmc_host_ops mmcsim_ops = {
+	.request	= mmcsim_request,
+	.set_ios	= mmcsim_set_ios,
+	.get_ro		= mmcsim_get_ro,
+	.get_cd		= mmcsim_get_cd,
+};
+
+static int __devinit mmcsim_probe(struct platform_device *pdev)
+{
+	struct mmcsim_host *host;
+	struct mmc_host *mmc;
+	int ret = -ENOMEM;
+
+	if (!size_mb || size_mb > MMCSIM_MAX_SIZE_MB) {
+		dev_err(&pdev->dev, "card size %uMB out of range\n", size_mb);
+		return -EINVAL;
+	}
+
+	mmc = mmc_alloc_host(sizeof(struct mmcsim_host), &pdev->dev);
+	if (!mmc)
+		return -ENOMEM;
+
+	host = mmc_priv(mmc);
+	host->mmc = mmc;
+	host->size = (unsigned long)size_mb << 20;
+
+	host->storage = vmalloc(host->size);
+	if (!host->storage)
+		goto out_free_host;
+	memset(host->storage, 0xff, host->size);
+
+	host->wq = create_singlethread_workqueue(DRIVER_NAME);
+	if (!host->wq)
+		goto out_free_storage;
+	INIT_WORK(&host->work, mmcsim_work);
+
+	mmcsim_init_card(host);
+
+	mmc->ops = &mmcsim_ops;
+	mmc->f_min = 400000;
+	mmc->f_max = 52000000;
+	mmc->ocr_avail = MMC_VDD_32_33 | MMC_VDD_33_34;
+	mmc->caps = MMC_CAP_4_BIT_DATA | MMC_CAP_8_BIT_DATA |
+		    MMC_CAP_MMC_HIGHSPEED | MMC_CAP_ERASE | MMC_CAP_1_8V_DDR;
+
+	mmc->max_hw_segs = 128;
+	mmc->max_phys_segs = 128;
+	mmc->max_seg_size = 64 * 1024;
+	mmc->max_blk_size = 512;
+	mmc->max_blk_count = 65535;
+	mmc->max_req_size = mmc->max_blk_size * mmc->max_blk_count;
+
+	platform_set_drvdata(pdev, host);
+
+	ret = mmc_add_host(mmc);
+	if (ret)
+		goto out_destroy_wq;
+
+	dev_info(&pdev->dev, "%uMB simulated MMC card\n", size_mb);
+
+	return 0;
+
+out_destroy_wq:
+	platform_set_drvdata(pdev, NULL);
+	destroy_workqueue(host->wq);
+out_free_storage:
+	vfree(host->storage);
+out_free_host:
+	mmc_free_host(mmc);
+	return ret;
+}
+
+static int __devexit mmcsim_remove(struct platform_device *pdev)
+{
+	struct mmcsim_host *host = platform_get_drvdata(pdev);
+
+	platform_set_drvdata(pdev, NULL);
+
+	mmc_remove_host(host->mmc);
+	destroy_workqueue(host->wq);
+	vfree(host->storage);
+	mmc_free_host(host->mmc);
+
+	return 0;
+}
+
+static struct platform_driver mmcsim_driver = {
+	.probe		= mmcsim_probe,
+	.remove		= __devexit_p(mmcsim_remove),
+	.driver		= {
+		.name	= DRIVER_NAME,
+		.owner	= THIS_MODULE,
+	},
+};
+
+static struct platform_device *mmcsim_pdev;
+
+static int __init mmcsim_init(void)
+{
+	int ret;
+
+	mmcsim_pdev = platform_device_alloc(DRIVER_NAME, -1);
+	if (!mmcsim_pdev)
+		return -ENOMEM;
+
+	ret = platform_driver_register(&mmcsim_driver);
+	if (ret)
+		goto err_put;
+
+	ret = platform_device_add(mmcsim_pdev);
+	if (ret)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	platform_driver_unregister(&mmcsim_driver);
+err_put:
+	platform_device_put(mmcsim_pdev);
+	return ret;
+}
+
+static void __exit mmcsim_exit(void)
+{
+	platform_device_unregister(mmcsim_pdev);
+	platform_driver_unregister(&mmcsim_driver);
+}
+
+module_init(mmcsim_init);
+module_exit(mmcsim_exit);
+
+MODULE_DESCRIPTION("Simulated MMC host and card");
+MODULE_LICENSE("GPL");
@@ -63,6 +63,7 @@
 #include <linux/io.h>
 #include <linux/uaccess.h>
 #include <linux/davinci_emac.h>
+#include <linux/net_coalesce.h>
 
 #include <asm/irq.h>
 #include <asm/page.h>
@@ -125,6 +126,7 @@ static const char emac_version_string[] = "TI DaVinci EMAC Linux v6.1";
 /* Buffer descriptor parameters */
 #define EMAC_DEF_TX_MAX_SERVICE		(32) /* TX max service BD's */
 #define EMAC_DEF_RX_MAX_SERVICE		(64) /* should = netdev->weight */
+#define EMAC_DEF_RX_RECYCLE_MAX		(64) /* Recycled RX skbs per CPU */
 
 /* EMAC register related defines */
 #define EMAC_ALL_MULTI_REG_VALUE	(0xFFFFFFFF)
@@ -302,6 +304,9 @@ static const char emac_version_string[] = "TI DaVinci EMAC Linux v6.1";
 #define EMAC_CTRL_EWCTL		(0x4)
 #define EMAC_CTRL_EWINTTCNT	(0x8)
 
+/* EMAC DM644x interrupt pacing: bus clocks between interrupts */
+#define EMAC_DM644X_EWINTCNT_MASK	(0x1FFFF)
+
 /* EMAC MDIO related */
 /* Mask & Control defines */
 #define MDIO_CONTROL_CLKDIV	(0xFF)
@@ -322,8 +327,20 @@ static const char emac_version_string[] = "TI DaVinci EMAC Linux v6.1";
 #define MDIO_CONTROL		(0x04)
 
 /* EMAC DM646X control module registers */
+#define EMAC_DM646X_CMINTCTRL	(0x0C)
 #define EMAC_DM646X_CMRXINTEN	(0x14)
 #define EMAC_DM646X_CMTXINTEN	(0x18)
+#define EMAC_DM646X_CMRXINTMAX	(0x70)
+#define EMAC_DM646X_CMTXINTMAX	(0x74)
+
+/* EMAC DM646X interrupt pacing: at most CMxXINTMAX interrupts per ms,
+ * counted in pulses of CMINTCTRL prescale bus clocks (4us by default) */
+#define EMAC_DM646X_INTPACEEN		(0x3 << 16)
+#define EMAC_DM646X_INTPRESCALE_MASK	(0x7FF << 0)
+#define EMAC_DM646X_CMINTMAX_CNT	(63)
+#define EMAC_DM646X_CMINTMIN_CNT	(2)
+#define EMAC_DM646X_CMINTMAX_INTVL	(1000 / EMAC_DM646X_CMINTMIN_CNT)
+#define EMAC_DM646X_CMINTMIN_INTVL	((1000 / EMAC_DM646X_CMINTMAX_CNT) + 1)
 
 /* EMAC EOI codes for C0 */
 #define EMAC_DM646X_MAC_EOI_C0_RXEN	(0x01)
@@ -471,6 +488,8 @@ struct emac_priv {
 	u32 speed; /* 0=Auto Neg, 1=No PHY, 10,100, 1000 - mbps */
 	u32 duplex; /* Link duplex: 0=Half, 1=Full */
 	u32 rx_buf_size;
+	struct skb_pool rx_pool;
+	struct net_coalesce coal;
 	u32 isr_count;
 	u8 rmii_en;
 	u8 version;
@@ -708,11 +727,179 @@ static int emac_set_settings(struct net_device *ndev, struct ethtool_cmd *ecmd)
  * Ethtool support for EMAC adapter
  *
  */
+static const char emac_gstrings_stats[][ETH_GSTRING_LEN] = {
+	"rx_recycle_hits",
+	"rx_recycle_misses",
+	"tx_recycled",
+	"coalesce_samples",
+	"coalesce_raised",
+	"coalesce_lowered",
+};
+
+/**
+ * emac_get_sset_count: Get EMAC ethtool string set size
+ * @ndev: The DaVinci EMAC network adapter
+ * @sset: string set
+ *
+ * Returns the number of driver statistics
+ *
+ */
+static int emac_get_sset_count(struct net_device *ndev, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(emac_gstrings_stats);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+/**
+ * emac_get_strings: Get EMAC ethtool strings
+ * @ndev: The DaVinci EMAC network adapter
+ * @stringset: string set
+ * @data: where to copy the strings
+ *
+ */
+static void emac_get_strings(struct net_device *ndev, u32 stringset, u8 *data)
+{
+	if (stringset == ETH_SS_STATS)
+		memcpy(data, emac_gstrings_stats, sizeof(emac_gstrings_stats));
+}
+
+/**
+ * emac_get_ethtool_stats: Get EMAC driver statistics
+ * @ndev: The DaVinci EMAC network adapter
+ * @stats: ethtool statistics command
+ * @data: where to store the statistics
+ *
+ * Reports the RX skb recycling and interrupt coalescing counters
+ *
+ */
+static void emac_get_ethtool_stats(struct net_device *ndev,
+				   struct ethtool_stats *stats, u64 *data)
+{
+	struct emac_priv *priv = netdev_priv(ndev);
+	struct skb_pool_stats pool;
+
+	skb_pool_get_stats(&priv->rx_pool, &pool);
+	data[0] = pool.hits;
+	data[1] = pool.misses;
+	data[2] = pool.recycled;
+	data[3] = priv->coal.stats.samples;
+	data[4] = priv->coal.stats.raised;
+	data[5] = priv->coal.stats.lowered;
+}
+
+/**
+ * emac_coalesce_hw: Program EMAC interrupt pacing
+ * @priv: The DaVinci EMAC private adapter structure
+ *
+ * Sets the minimum interval between interrupts to priv->coal.usecs, within
+ * what the control module can do.  The EMAC has no frame count threshold,
+ * so priv->coal.frames is not used.
+ *
+ */
+static void emac_coalesce_hw(struct emac_priv *priv)
+{
+	u32 coal_intvl = priv->coal.usecs;
+	u32 bus_freq_mhz = emac_bus_frequency / 1000000;
+	u32 int_ctrl, prescale, num_interrupts, addnl_dvdr = 1;
+
+	switch (priv->version) {
+	case EMAC_VERSION_2:
+		int_ctrl = emac_ctrl_read(EMAC_DM646X_CMINTCTRL);
+		if (!coal_intvl) {
+			int_ctrl &= ~EMAC_DM646X_INTPACEEN;
+			emac_ctrl_write(EMAC_DM646X_CMINTCTRL, int_ctrl);
+			break;
+		}
+
+		prescale = bus_freq_mhz * 4;
+		if (coal_intvl < EMAC_DM646X_CMINTMIN_INTVL)
+			coal_intvl = EMAC_DM646X_CMINTMIN_INTVL;
+
+		if (coal_intvl > EMAC_DM646X_CMINTMAX_INTVL) {
+			/* throttle further by dilating the 4us pulse */
+			addnl_dvdr = EMAC_DM646X_INTPRESCALE_MASK / prescale;
+			if (addnl_dvdr > 1) {
+				prescale *= addnl_dvdr;
+				coal_intvl = min(coal_intvl, (u32)
+					(EMAC_DM646X_CMINTMAX_INTVL * addnl_dvdr));
+			} else {
+				addnl_dvdr = 1;
+				coal_intvl = EMAC_DM646X_CMINTMAX_INTVL;
+			}
+		}
+
+		num_interrupts = (1000 * addnl_dvdr) / coal_intvl;
+
+		int_ctrl |= EMAC_DM646X_INTPACEEN;
+		int_ctrl &= ~EMAC_DM646X_INTPRESCALE_MASK;
+		int_ctrl |= (prescale & EMAC_DM646X_INTPRESCALE_MASK);
+		emac_ctrl_write(EMAC_DM646X_CMINTCTRL, int_ctrl);
+
+		emac_ctrl_write(EMAC_DM646X_CMRXINTMAX, num_interrupts);
+		emac_ctrl_write(EMAC_DM646X_CMTXINTMAX, num_interrupts);
+		break;
+	default:
+		emac_ctrl_write(EMAC_CTRL_EWINTTCNT,
+				min(coal_intvl * bus_freq_mhz,
+				    (u32)EMAC_DM644X_EWINTCNT_MASK));
+		break;
+	}
+}
+
+/**
+ * emac_get_coalesce: Get interrupt coalescing settings
+ * @ndev: The DaVinci EMAC network adapter
+ * @coal: ethtool coalesce settings structure
+ *
+ * Returns 0
+ *
+ */
+static int emac_get_coalesce(struct net_device *ndev,
+			     struct ethtool_coalesce *coal)
+{
+	struct emac_priv *priv = netdev_priv(ndev);
+
+	net_coalesce_get(&priv->coal, coal);
+	return 0;
+}
+
+/**
+ * emac_set_coalesce: Set interrupt coalescing settings
+ * @ndev: The DaVinci EMAC network adapter
+ * @coal: ethtool coalesce settings structure
+ *
+ * Also called by the adaptive coalescing code to switch levels
+ *
+ */
+static int emac_set_coalesce(struct net_device *ndev,
+			     struct ethtool_coalesce *coal)
+{
+	struct emac_priv *priv = netdev_priv(ndev);
+	int ret;
+
+	ret = net_coalesce_set(&priv->coal, coal);
+	if (ret)
+		return ret;
+
+	if (netif_running(ndev))
+		emac_coalesce_hw(priv);
+	return 0;
+}
+
 static const struct ethtool_ops ethtool_ops = {
 	.get_drvinfo = emac_get_drvinfo,
 	.get_settings = emac_get_settings,
 	.set_settings = emac_set_settings,
 	.get_link = ethtool_op_get_link,
+	.get_sset_count = emac_get_sset_count,
+	.get_strings = emac_get_strings,
+	.get_ethtool_stats = emac_get_ethtool_stats,
+	.get_coalesce = emac_get_coalesce,
+	.set_coalesce = emac_set_coalesce,
 };
 
 /**
@@ -1184,7 +1371,8 @@ static void emac_cleanup_txch(struct emac_priv *priv, u32 ch)
  * @num_tokens: number of skb's to free
  * @ch: TX channel number
  *
- * Frees the skb once packet is transmitted
+ * Frees the skb once packet is transmitted, recycling it for RX when
+ * possible.  Must be called with interrupts enabled for that.
  *
  */
 static int emac_net_tx_complete(struct emac_priv *priv,
@@ -1201,7 +1389,7 @@ static int emac_net_tx_complete(struct emac_priv *priv,
 			continue;
 		priv->net_dev_stats.tx_packets++;
 		priv->net_dev_stats.tx_bytes += skb->len;
-		dev_kfree_skb_any(skb);
+		skb_pool_free(&priv->rx_pool, skb);
 	}
 	return 0;
 }
@@ -1343,11 +1531,12 @@ static int emac_tx_bdproc(struct emac_priv *priv, u32 ch, u32 budget)
 			frame_status = curr_bd->mode;
 		}
 	} /* end of pkt processing loop */
+	spin_unlock_irqrestore(&priv->tx_lock, flags);
 
+	/* tx_complete[] is only used here, in NAPI context */
 	emac_net_tx_complete(priv,
 			     (void *)&txch->tx_complete[0],
 			     tx_complete_cnt, ch);
-	spin_unlock_irqrestore(&priv->tx_lock, flags);
 	return pkts_processed;
 }
 
@@ -1534,15 +1723,14 @@ static void *emac_net_alloc_rx_buf(struct emac_priv *priv, int buf_size,
 	struct device *emac_dev = &ndev->dev;
 	struct sk_buff *p_skb;
 
-	p_skb = dev_alloc_skb(buf_size);
+	p_skb = skb_pool_alloc(&priv->rx_pool, ndev, buf_size);
 	if (unlikely(NULL == p_skb)) {
 		if (netif_msg_rx_err(priv) && net_ratelimit())
 			dev_err(emac_dev, "DaVinci EMAC: failed to alloc skb");
 		return NULL;
 	}
 
-	/* set device pointer in skb and reserve space for extra bytes */
-	p_skb->dev = ndev;
+	/* reserve space for extra bytes */
 	skb_reserve(p_skb, NET_IP_ALIGN);
 	*data_token = (void *) p_skb;
 	EMAC_CACHE_WRITEBACK_INVALIDATE((unsigned long)p_skb->data, buf_size);
@@ -2117,6 +2305,8 @@ static int emac_hw_enable(struct emac_priv *priv)
 	emac_write(EMAC_MACCONTROL, val);
 
 	/* Enable NAPI and interrupts */
+	net_coalesce_start(&priv->coal);
+	emac_coalesce_hw(priv);
 	napi_enable(&priv->napi);
 	emac_int_enable(priv);
 	return 0;
@@ -2168,6 +2358,7 @@ static int emac_poll(struct napi_struct *napi, int budget)
 
 	if (status & mask) {
 		num_pkts = emac_rx_bdproc(priv, EMAC_DEF_RX_CH, budget);
+		net_coalesce_sample(&priv->coal, num_pkts);
 	} /* RX processing */
 
 	if (num_pkts < budget) {
@@ -2517,6 +2708,7 @@ static int emac_dev_stop(struct net_device *ndev)
 	/* inform the upper layers. */
 	netif_stop_queue(ndev);
 	napi_disable(&priv->napi);
+	net_coalesce_stop(&priv->coal);
 
 	netif_carrier_off(ndev);
 	emac_int_disable(priv);
@@ -2524,6 +2716,7 @@ static int emac_dev_stop(struct net_device *ndev)
 	emac_stop_rxch(priv, EMAC_DEF_RX_CH);
 	emac_cleanup_txch(priv, EMAC_DEF_TX_CH);
 	emac_cleanup_rxch(priv, EMAC_DEF_RX_CH);
+	skb_pool_purge(&priv->rx_pool);
 	emac_write(EMAC_SOFTRESET, 1);
 
 	if (priv->phydev)
@@ -2733,8 +2926,16 @@ static int __devinit davinci_emac_probe(struct platform_device *pdev)
 				__func__, priv->mac_addr);
 	}
 
+	rc = skb_pool_init(&priv->rx_pool, EMAC_DEF_MAX_FRAME_SIZE +
+			   NET_IP_ALIGN, EMAC_DEF_RX_RECYCLE_MAX);
+	if (rc) {
+		dev_err(emac_dev, "DaVinci EMAC: Error allocating skb pool\n");
+		goto no_irq_res;
+	}
+
 	ndev->netdev_ops = &emac_netdev_ops;
 	SET_ETHTOOL_OPS(ndev, &ethtool_ops);
+	net_coalesce_init(&priv->coal, ndev);
 	netif_napi_add(ndev, &priv->napi, emac_poll, EMAC_POLL_WEIGHT);
 
 	clk_enable(emac_phy_clk);
@@ -2790,6 +2991,7 @@ netdev_reg_err:
 mdio_alloc_err:
 	clk_disable(emac_clk);
 	clk_disable(emac_phy_clk);
+	skb_pool_destroy(&priv->rx_pool);
 no_irq_res:
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	release_mem_region(res->start, res->end - res->start + 1);
@@ -2825,6 +3027,7 @@ static int __devexit davinci_emac_remove(struct platform_device *pdev)
 	release_mem_region(res->start, res->end - res->start + 1);
 
 	unregister_netdev(ndev);
+	skb_pool_destroy(&priv->rx_pool);
 	free_netdev(ndev);
 	iounmap(priv->remap_addr);
 
@@ -51,6 +51,9 @@
 #include <linux/phy.h>
 #include <linux/smsc911x.h>
 #include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
+#include <linux/net_coalesce.h>
 #include "smsc911x.h"
 
 #define SMSC_CHIPNAME		"smsc911x"
@@ -69,6 +72,40 @@ static int debug = 3;
 module_param(debug, int, 0);
 MODULE_PARM_DESC(debug, "Debug level (0=none,...,16=all)");
 
+static int dma_thresh = 256;
+module_param(dma_thresh, int, 0644);
+MODULE_PARM_DESC(dma_thresh, "Copy frames shorter than this by CPU, not DMA");
+
+/* Driver statistics, reported through ethtool -S */
+struct smsc911x_xstats {
+	unsigned long rx_pio_bytes;
+	unsigned long rx_dma_bytes;
+	unsigned long tx_pio_bytes;
+	unsigned long tx_dma_bytes;
+};
+
+static const char smsc911x_gstrings_stats[][ETH_GSTRING_LEN] = {
+	"rx_pio_bytes",
+	"rx_dma_bytes",
+	"tx_pio_bytes",
+	"tx_dma_bytes",
+	"rx_recycle_hits",
+	"rx_recycle_misses",
+	"tx_recycled",
+	"coalesce_samples",
+	"coalesce_raised",
+	"coalesce_lowered",
+};
+
+/* State of a frame while a DMA transfer moves it through a FIFO */
+struct smsc911x_skb_cb {
+	dma_addr_t addr;
+	unsigned int len;
+	dma_cookie_t cookie;
+};
+
+#define SMSC_SKB_CB(skb)	((struct smsc911x_skb_cb *)(skb)->cb)
+
 struct smsc911x_data {
 	void __iomem *ioaddr;
 
@@ -117,6 +154,24 @@ struct smsc911x_data {
 	unsigned int clear_bits_mask;
 	unsigned int hashhi;
 	unsigned int hashlo;
+
+	/* DMA channels for the data FIFOs, NULL to copy by CPU (PIO).
+	 * Frames wait on the queues, in FIFO order, until their transfer
+	 * completes; tx_dma_pending is the tx FIFO space they will use. */
+	struct dma_chan *rx_chan;
+	struct dma_chan *tx_chan;
+	struct sk_buff_head rx_dma_queue;
+	struct sk_buff_head tx_dma_queue;
+	unsigned int tx_dma_pending;
+
+	/* preallocated receive buffers, topped up from transmitted skbs */
+	struct skb_pool rx_pool;
+
+	/* adaptive interrupt coalescing */
+	struct net_coalesce coal;
+	u32 gpt_cfg;			/* GPT_CFG to reload, 0 if off */
+
+	struct smsc911x_xstats xstats;
 };
 
 /* The 16-bit access functions are significantly slower, due to the locking
@@ -978,15 +1033,434 @@ smsc911x_rx_fastforward(struct smsc911x_data *pdata, unsigned int pktbytes)
 	}
 }
 
+/* Passes a received frame up the stack */
+static void smsc911x_rx_deliver(struct net_device *dev, struct sk_buff *skb)
+{
+	/* Update counters */
+	dev->stats.rx_packets++;
+	dev->stats.rx_bytes += skb->len;
+
+	skb->protocol = eth_type_trans(skb, dev);
+	skb->ip_summed = CHECKSUM_NONE;
+	netif_receive_skb(skb);
+}
+
+/* Disables Rx interrupts and schedules a NAPI poll */
+static void smsc911x_rx_schedule(struct smsc911x_data *pdata)
+{
+	u32 temp;
+
+	if (likely(napi_schedule_prep(&pdata->napi))) {
+		temp = smsc911x_reg_read(pdata, INT_EN);
+		temp &= (~INT_EN_RSFL_EN_);
+		smsc911x_reg_write(pdata, INT_EN, temp);
+		__napi_schedule(&pdata->napi);
+	}
+}
+
+/* Have TDFA fire once the FIFO drains to 3200 free bytes */
+static void smsc911x_tx_arm_tdfa(struct smsc911x_data *pdata)
+{
+	unsigned int temp = smsc911x_reg_read(pdata, FIFO_INT);
+
+	temp &= 0x00FFFFFF;
+	temp |= 0x32000000;
+	smsc911x_reg_write(pdata, FIFO_INT, temp);
+}
+
+#ifdef CONFIG_DMA_ENGINE
+
+/*
+ * DMA for the data FIFOs.  The FIFOs are strictly sequential, so every
+ * frame goes through one channel per direction, in order, and the CPU
+ * may only touch a data FIFO (PIO) once the transfers queued on it have
+ * completed.  Short frames still go by PIO: below dma_thresh, setting up
+ * a transfer costs more than the copy.
+ */
+
+static struct dma_chan *
+smsc911x_dma_request(struct smsc911x_data *pdata, void *param)
+{
+	dma_cap_mask_t mask;
+
+	dma_cap_zero(mask);
+	if (pdata->config.dma_filter) {
+		dma_cap_set(DMA_SLAVE, mask);
+		return dma_request_channel(mask, pdata->config.dma_filter,
+					   param);
+	}
+
+	dma_cap_set(DMA_MEMCPY, mask);
+	return dma_request_channel(mask, NULL, NULL);
+}
+
+static void smsc911x_dma_init(struct smsc911x_data *pdata)
+{
+	/* 16 bit accesses and byte swapping need the CPU */
+	if (!(pdata->config.flags & SMSC911X_USE_32BIT) ||
+	    (pdata->config.flags & SMSC911X_SWAP_FIFO))
+		return;
+
+	if (!pdata->config.dma_filter &&
+	    pdata->config.fifo_dma_size < SMSC_DMA_MAX_LEN)
+		return;
+
+	pdata->rx_chan = smsc911x_dma_request(pdata,
+					      pdata->config.dma_rx_param);
+	pdata->tx_chan = smsc911x_dma_request(pdata,
+					      pdata->config.dma_tx_param);
+
+	SMSC_TRACE(IFUP, "FIFO DMA: rx %s, tx %s",
+		pdata->rx_chan ? dma_chan_name(pdata->rx_chan) : "none",
+		pdata->tx_chan ? dma_chan_name(pdata->tx_chan) : "none");
+}
+
+/* Queues a transfer of len bytes at buf (mapped at addr) to or from the
+ * data FIFOs; the caller issues it */
+static dma_cookie_t
+smsc911x_dma_submit(struct smsc911x_data *pdata, struct dma_chan *chan,
+		    void *buf, dma_addr_t addr, unsigned int len,
+		    enum dma_data_direction dir,
+		    dma_async_tx_callback callback)
+{
+	struct dma_device *dma = chan->device;
+	struct dma_async_tx_descriptor *desc;
+	unsigned long flags = DMA_PREP_INTERRUPT | DMA_CTRL_ACK;
+	dma_addr_t fifo = pdata->config.fifo_dma_addr;
+
+	if (pdata->config.dma_filter) {
+		struct scatterlist sg;
+
+		sg_init_one(&sg, buf, len);
+		sg_dma_address(&sg) = addr;
+		desc = dma->device_prep_slave_sg(chan, &sg, 1, dir, flags);
+	} else {
+		flags |= DMA_COMPL_SKIP_SRC_UNMAP | DMA_COMPL_SKIP_DEST_UNMAP;
+		if (dir == DMA_TO_DEVICE)
+			desc = dma->device_prep_dma_memcpy(chan, fifo, addr,
+							   len, flags);
+		else
+			desc = dma->device_prep_dma_memcpy(chan, addr, fifo,
+							   len, flags);
+	}
+	if (!desc)
+		return -ENOMEM;
+
+	desc->callback = callback;
+	desc->callback_param = pdata;
+	return desc->tx_submit(desc);
+}
+
+static void smsc911x_rx_dma_done(void *param)
+{
+	struct smsc911x_data *pdata = param;
+	unsigned long flags;
+
+	/* as the Rx interrupt handler would */
+	local_irq_save(flags);
+	smsc911x_rx_schedule(pdata);
+	local_irq_restore(flags);
+}
+
+/* Starts reading a frame's pktwords FIFO words into skb */
+static int smsc911x_rx_dma(struct smsc911x_data *pdata, struct sk_buff *skb,
+			   unsigned int pktwords)
+{
+	struct dma_chan *chan = pdata->rx_chan;
+	struct device *dmadev = chan->device->dev;
+	struct smsc911x_skb_cb *cb = SMSC_SKB_CB(skb);
+
+	cb->len = pktwords << 2;
+	cb->addr = dma_map_single(dmadev, skb->head, cb->len,
+				  DMA_FROM_DEVICE);
+	if (dma_mapping_error(dmadev, cb->addr))
+		return -ENOMEM;
+
+	cb->cookie = smsc911x_dma_submit(pdata, chan, skb->head, cb->addr,
+					 cb->len, DMA_FROM_DEVICE,
+					 smsc911x_rx_dma_done);
+	if (cb->cookie < 0) {
+		dma_unmap_single(dmadev, cb->addr, cb->len, DMA_FROM_DEVICE);
+		return cb->cookie;
+	}
+
+	/* only the NAPI poll touches rx_dma_queue */
+	__skb_queue_tail(&pdata->rx_dma_queue, skb);
+	dma_async_issue_pending(chan);
+	return 0;
+}
+
+/* Passes up the frames whose transfer completed, in order; returns how
+ * many */
+static int smsc911x_rx_dma_complete(struct smsc911x_data *pdata)
+{
+	struct net_device *dev = pdata->dev;
+	struct sk_buff *skb;
+	struct smsc911x_skb_cb *cb;
+	int npackets = 0;
+
+	while ((skb = skb_peek(&pdata->rx_dma_queue)) != NULL) {
+		cb = SMSC_SKB_CB(skb);
+		if (dma_async_is_tx_complete(pdata->rx_chan, cb->cookie,
+					     NULL, NULL) != DMA_SUCCESS)
+			break;
+
+		__skb_unlink(skb, &pdata->rx_dma_queue);
+		dma_unmap_single(pdata->rx_chan->device->dev, cb->addr,
+				 cb->len, DMA_FROM_DEVICE);
+		pdata->xstats.rx_dma_bytes += cb->len;
+		smsc911x_rx_deliver(dev, skb);
+		npackets++;
+	}
+
+	return npackets;
+}
+
+/* Waits for all rx transfers, before the CPU reads the FIFO */
+static int smsc911x_rx_dma_flush(struct smsc911x_data *pdata)
+{
+	struct sk_buff *skb = skb_peek_tail(&pdata->rx_dma_queue);
+
+	if (!skb)
+		return 0;
+
+	if (dma_sync_wait(pdata->rx_chan, SMSC_SKB_CB(skb)->cookie) !=
+	    DMA_SUCCESS)
+		SMSC_WARNING(RX_ERR, "Rx DMA did not complete");
+
+	return smsc911x_rx_dma_complete(pdata);
+}
+
+/* The oldest rx transfer still queued, 0 if none */
+static dma_cookie_t smsc911x_rx_dma_cookie(struct smsc911x_data *pdata)
+{
+	struct sk_buff *skb = skb_peek(&pdata->rx_dma_queue);
+
+	return skb ? SMSC_SKB_CB(skb)->cookie : 0;
+}
+
+static bool smsc911x_rx_dma_done_since(struct smsc911x_data *pdata,
+				       dma_cookie_t cookie)
+{
+	return cookie > 0 && dma_async_is_tx_complete(pdata->rx_chan,
+					cookie, NULL, NULL) == DMA_SUCCESS;
+}
+
+/* Free tx FIFO space, less what queued tx transfers will use */
+static unsigned int smsc911x_tx_freespace(struct smsc911x_data *pdata)
+{
+	unsigned int freespace =
+		smsc911x_reg_read(pdata, TX_FIFO_INF) & TX_FIFO_INF_TDFREE_;
+	unsigned int pending = ACCESS_ONCE(pdata->tx_dma_pending);
+
+	return freespace > pending ? freespace - pending : 0;
+}
+
+static void smsc911x_tx_dma_done(void *param)
+{
+	struct smsc911x_data *pdata = param;
+	struct net_device *dev = pdata->dev;
+	struct sk_buff_head done;
+	struct sk_buff *skb;
+	struct smsc911x_skb_cb *cb;
+	unsigned long flags;
+
+	__skb_queue_head_init(&done);
+
+	spin_lock_irqsave(&pdata->tx_dma_queue.lock, flags);
+	while ((skb = skb_peek(&pdata->tx_dma_queue)) != NULL) {
+		cb = SMSC_SKB_CB(skb);
+		if (dma_async_is_tx_complete(pdata->tx_chan, cb->cookie,
+					     NULL, NULL) != DMA_SUCCESS)
+			break;
+		__skb_unlink(skb, &pdata->tx_dma_queue);
+		pdata->tx_dma_pending -= skb->len + 32;
+		__skb_queue_tail(&done, skb);
+	}
+	spin_unlock_irqrestore(&pdata->tx_dma_queue.lock, flags);
+
+	while ((skb = __skb_dequeue(&done)) != NULL) {
+		cb = SMSC_SKB_CB(skb);
+		dma_unmap_single(pdata->tx_chan->device->dev, cb->addr,
+				 cb->len, DMA_TO_DEVICE);
+		pdata->xstats.tx_dma_bytes += cb->len;
+		skb_pool_free(&pdata->rx_pool, skb);
+	}
+
+	/* the TDFA interrupt leaves waking to us while transfers are
+	 * pending, and needs rearming if the FIFO is still too full */
+	if (netif_running(dev) && netif_queue_stopped(dev)) {
+		if (smsc911x_tx_freespace(pdata) >= TX_FIFO_LOW_THRESHOLD)
+			netif_wake_queue(dev);
+		else
+			smsc911x_tx_arm_tdfa(pdata);
+	}
+}
+
+/* Starts writing a frame, preceded by its command words, to the FIFO.
+ * The caller made sure of SMSC_TX_DMA_HEADROOM writable headroom. */
+static int smsc911x_tx_dma(struct smsc911x_data *pdata, struct sk_buff *skb,
+			   u32 tx_cmd_a, u32 tx_cmd_b)
+{
+	struct dma_chan *chan = pdata->tx_chan;
+	struct device *dmadev = chan->device->dev;
+	struct smsc911x_skb_cb *cb = SMSC_SKB_CB(skb);
+	unsigned int offset = (ulong)skb->data & 0x3;
+	u32 *cmd = (u32 *)(skb->data - offset) - 2;
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	cmd[0] = tx_cmd_a;
+	cmd[1] = tx_cmd_b;
+	cb->len = 8 + ((skb->len + offset + 3) & ~0x3);
+	cb->addr = dma_map_single(dmadev, cmd, cb->len, DMA_TO_DEVICE);
+	if (dma_mapping_error(dmadev, cb->addr))
+		return -ENOMEM;
+
+	spin_lock_irqsave(&pdata->tx_dma_queue.lock, flags);
+	cookie = smsc911x_dma_submit(pdata, chan, cmd, cb->addr, cb->len,
+				     DMA_TO_DEVICE, smsc911x_tx_dma_done);
+	if (cookie >= 0) {
+		cb->cookie = cookie;
+		__skb_queue_tail(&pdata->tx_dma_queue, skb);
+		pdata->tx_dma_pending += skb->len + 32;
+	}
+	spin_unlock_irqrestore(&pdata->tx_dma_queue.lock, flags);
+
+	if (cookie < 0) {
+		dma_unmap_single(dmadev, cb->addr, cb->len, DMA_TO_DEVICE);
+		return cookie;
+	}
+
+	dma_async_issue_pending(chan);
+	return 0;
+}
+
+/* Waits for all tx transfers, before the CPU writes the FIFO */
+static void smsc911x_tx_dma_flush(struct smsc911x_data *pdata)
+{
+	struct sk_buff *skb;
+	dma_cookie_t cookie = 0;
+	unsigned long flags;
+
+	if (!pdata->tx_chan)
+		return;
+
+	spin_lock_irqsave(&pdata->tx_dma_queue.lock, flags);
+	skb = skb_peek_tail(&pdata->tx_dma_queue);
+	if (skb)
+		cookie = SMSC_SKB_CB(skb)->cookie;
+	spin_unlock_irqrestore(&pdata->tx_dma_queue.lock, flags);
+
+	if (!cookie)
+		return;
+
+	if (dma_sync_wait(pdata->tx_chan, cookie) != DMA_SUCCESS)
+		SMSC_WARNING(TX_ERR, "Tx DMA did not complete");
+	smsc911x_tx_dma_done(pdata);
+}
+
+static void smsc911x_dma_drain(struct dma_chan *chan,
+			       struct sk_buff_head *queue,
+			       enum dma_data_direction dir)
+{
+	struct sk_buff *skb;
+
+	chan->device->device_terminate_all(chan);
+	while ((skb = skb_dequeue(queue)) != NULL) {
+		dma_unmap_single(chan->device->dev, SMSC_SKB_CB(skb)->addr,
+				 SMSC_SKB_CB(skb)->len, dir);
+		dev_kfree_skb_any(skb);
+	}
+	dma_release_channel(chan);
+}
+
+/* Stops all transfers and releases the channels; NAPI and the tx queue
+ * must be stopped */
+static void smsc911x_dma_release(struct smsc911x_data *pdata)
+{
+	if (pdata->rx_chan) {
+		smsc911x_dma_drain(pdata->rx_chan, &pdata->rx_dma_queue,
+				   DMA_FROM_DEVICE);
+		pdata->rx_chan = NULL;
+	}
+
+	if (pdata->tx_chan) {
+		smsc911x_dma_drain(pdata->tx_chan, &pdata->tx_dma_queue,
+				   DMA_TO_DEVICE);
+		pdata->tx_chan = NULL;
+		pdata->tx_dma_pending = 0;
+	}
+}
+
+#else /* CONFIG_DMA_ENGINE */
+
+static inline void smsc911x_dma_init(struct smsc911x_data *pdata)
+{
+}
+
+static inline void smsc911x_dma_release(struct smsc911x_data *pdata)
+{
+}
+
+static inline int smsc911x_rx_dma(struct smsc911x_data *pdata,
+				  struct sk_buff *skb, unsigned int pktwords)
+{
+	return -ENODEV;
+}
+
+static inline int smsc911x_rx_dma_complete(struct smsc911x_data *pdata)
+{
+	return 0;
+}
+
+static inline int smsc911x_rx_dma_flush(struct smsc911x_data *pdata)
+{
+	return 0;
+}
+
+static inline dma_cookie_t smsc911x_rx_dma_cookie(struct smsc911x_data *pdata)
+{
+	return 0;
+}
+
+static inline bool smsc911x_rx_dma_done_since(struct smsc911x_data *pdata,
+					      dma_cookie_t cookie)
+{
+	return false;
+}
+
+static inline unsigned int smsc911x_tx_freespace(struct smsc911x_data *pdata)
+{
+	return smsc911x_reg_read(pdata, TX_FIFO_INF) & TX_FIFO_INF_TDFREE_;
+}
+
+static inline int smsc911x_tx_dma(struct smsc911x_data *pdata,
+				  struct sk_buff *skb, u32 tx_cmd_a,
+				  u32 tx_cmd_b)
+{
+	return -ENODEV;
+}
+
+static inline void smsc911x_tx_dma_flush(struct smsc911x_data *pdata)
+{
+}
+
+#endif /* CONFIG_DMA_ENGINE */
+
 /* NAPI poll function */
 static int smsc911x_poll(struct napi_struct *napi, int budget)
 {
 	struct smsc911x_data *pdata =
 		container_of(napi, struct smsc911x_data, napi);
 	struct net_device *dev = pdata->dev;
-	int npackets = 0;
+	int npackets;
+
+	/* Frames read by DMA go up first, they arrived first */
+	npackets = smsc911x_rx_dma_complete(pdata);
 
-	while (npackets < budget) {
+	/* Frames still being read by DMA count against this budget */
+	while (npackets + skb_queue_len(&pdata->rx_dma_queue) < budget) {
 		unsigned int pktlength;
 		unsigned int pktwords;
 		struct sk_buff *skb;
@@ -994,6 +1468,12 @@ static int smsc911x_poll(struct napi_struct *napi, int budget)
 
 		if (!rxstat) {
 			unsigned int temp;
+			dma_cookie_t cookie = smsc911x_rx_dma_cookie(pdata);
+
+			/* sample while the poll still owns the coalescing
+			 * state, the interrupt may run us again right after */
+			net_coalesce_sample(&pdata->coal, npackets);
+
 			/* We processed all packets available.  Tell NAPI it can
 			 * stop polling then re-enable rx interrupts */
 			smsc911x_reg_write(pdata, INT_STS, INT_STS_RSFL_);
@@ -1001,12 +1481,13 @@ static int smsc911x_poll(struct napi_struct *napi, int budget)
 			temp = smsc911x_reg_read(pdata, INT_EN);
 			temp |= INT_EN_RSFL_EN_;
 			smsc911x_reg_write(pdata, INT_EN, temp);
-			break;
-		}
 
-		/* Count packet for NAPI scheduling, even if it has an error.
-		 * Error packets still require cycles to discard */
-		npackets++;
+			/* a transfer finishing before napi_complete() could
+			 * not schedule us again */
+			if (smsc911x_rx_dma_done_since(pdata, cookie))
+				smsc911x_rx_schedule(pdata);
+			return npackets;
+		}
 
 		pktlength = ((rxstat & 0x3FFF0000) >> 16);
 		pktwords = (pktlength + NET_IP_ALIGN + 3) >> 2;
@@ -1016,17 +1497,22 @@ static int smsc911x_poll(struct napi_struct *napi, int budget)
 			SMSC_WARNING(RX_ERR,
 				"Discarding packet with error bit set");
 			/* Packet has an error, discard it and continue with
-			 * the next */
+			 * the next.  Error packets still require cycles to
+			 * discard, so count them for NAPI scheduling */
+			npackets += smsc911x_rx_dma_flush(pdata);
 			smsc911x_rx_fastforward(pdata, pktwords);
 			dev->stats.rx_dropped++;
+			npackets++;
 			continue;
 		}
 
-		skb = netdev_alloc_skb(dev, pktlength + NET_IP_ALIGN);
+		skb = skb_pool_alloc(&pdata->rx_pool, dev,
+				     pktlength + NET_IP_ALIGN);
 		if (unlikely(!skb)) {
 			SMSC_WARNING(RX_ERR,
 				"Unable to allocate skb for rx packet");
 			/* Drop the packet and stop this polling iteration */
+			npackets += smsc911x_rx_dma_flush(pdata);
 			smsc911x_rx_fastforward(pdata, pktwords);
 			dev->stats.rx_dropped++;
 			break;
@@ -1038,19 +1524,22 @@ static int smsc911x_poll(struct napi_struct *napi, int budget)
 		/* Align IP on 16B boundary */
 		skb_reserve(skb, NET_IP_ALIGN);
 		skb_put(skb, pktlength - 4);
+
+		if (pdata->rx_chan && pktlength >= dma_thresh &&
+		    !smsc911x_rx_dma(pdata, skb, pktwords))
+			continue;
+
+		npackets += smsc911x_rx_dma_flush(pdata);
 		smsc911x_rx_readfifo(pdata, (unsigned int *)skb->head,
 				     pktwords);
-		skb->protocol = eth_type_trans(skb, dev);
-		skb->ip_summed = CHECKSUM_NONE;
-		netif_receive_skb(skb);
-
-		/* Update counters */
-		dev->stats.rx_packets++;
-		dev->stats.rx_bytes += (pktlength - 4);
+		pdata->xstats.rx_pio_bytes += pktwords << 2;
+		smsc911x_rx_deliver(dev, skb);
+		npackets++;
 	}
 
-	/* Return total received packets */
-	return npackets;
+	/* Budget used up, stay on the poll list */
+	net_coalesce_sample(&pdata->coal, npackets);
+	return budget;
 }
 
 /* Returns hash bit number for given MAC address
@@ -1143,6 +1632,51 @@ smsc911x_set_hw_mac_address(struct smsc911x_data *pdata, u8 dev_addr[6])
 	smsc911x_mac_write(pdata, ADDRL, mac_low32);
 }
 
+/*
+ * Programs the coalescing settings in pdata->coal: the interrupt
+ * deassertion interval holds off interrupts for usecs after each one, and
+ * the RX status level holds off the receive interrupt until frames have
+ * arrived.  A frame threshold needs the general purpose timer as well, or
+ * a lone frame below it would never be seen.
+ */
+static void smsc911x_coalesce_hw(struct smsc911x_data *pdata)
+{
+	unsigned int usecs = pdata->coal.usecs;
+	unsigned int level = clamp_t(unsigned int, pdata->coal.frames, 1,
+				     SMSC_COAL_FRAMES_MAX) - 1;
+	unsigned long flags;
+	u32 temp;
+
+	/* the irq handler changes FIFO_INT and INT_EN too */
+	local_irq_save(flags);
+
+	temp = smsc911x_reg_read(pdata, INT_CFG);
+	temp &= ~INT_CFG_INT_DEAS_;
+	temp |= DIV_ROUND_UP(usecs, 10) << 24;
+	smsc911x_reg_write(pdata, INT_CFG, temp);
+
+	temp = smsc911x_reg_read(pdata, FIFO_INT);
+	temp &= ~FIFO_INT_RX_STS_LEVEL_;
+	temp |= level;
+	smsc911x_reg_write(pdata, FIFO_INT, temp);
+
+	if (level)
+		pdata->gpt_cfg = GPT_CFG_TIMER_EN_ |
+				 max(DIV_ROUND_UP(usecs, 100), 1U);
+	else
+		pdata->gpt_cfg = 0;
+	smsc911x_reg_write(pdata, GPT_CFG, pdata->gpt_cfg);
+
+	temp = smsc911x_reg_read(pdata, INT_EN);
+	if (level)
+		temp |= INT_EN_GPT_INT_EN_;
+	else
+		temp &= ~INT_EN_GPT_INT_EN_;
+	smsc911x_reg_write(pdata, INT_EN, temp);
+
+	local_irq_restore(flags);
+}
+
 static int smsc911x_open(struct net_device *dev)
 {
 	struct smsc911x_data *pdata = netdev_priv(dev);
@@ -1258,8 +1792,13 @@ static int smsc911x_open(struct net_device *dev)
 	/* set RX Data offset to 2 bytes for alignment */
 	smsc911x_reg_write(pdata, RX_CFG, (2 << 8));
 
+	skb_pool_fill(&pdata->rx_pool, dev, SMSC_RX_PREALLOC);
+	smsc911x_dma_init(pdata);
+
 	/* enable NAPI polling before enabling RX interrupts */
+	net_coalesce_start(&pdata->coal);
 	napi_enable(&pdata->napi);
+	smsc911x_coalesce_hw(pdata);
 
 	temp = smsc911x_reg_read(pdata, INT_EN);
 	temp |= (INT_EN_TDFA_EN_ | INT_EN_RSFL_EN_ | INT_EN_RXSTOP_INT_EN_);
@@ -1291,6 +1830,10 @@ static int smsc911x_stop(struct net_device *dev)
 	/* Stop Tx and Rx polling */
 	netif_stop_queue(dev);
 	napi_disable(&pdata->napi);
+	net_coalesce_stop(&pdata->coal);
+	pdata->gpt_cfg = 0;
+	smsc911x_reg_write(pdata, GPT_CFG, 0);
+	smsc911x_dma_release(pdata);
 
 	/* At this point all Rx and Tx activity is stopped */
 	dev->stats.rx_dropped += smsc911x_reg_read(pdata, RX_DROP);
@@ -1300,6 +1843,8 @@ static int smsc911x_stop(struct net_device *dev)
 	if (pdata->phy_dev)
 		phy_stop(pdata->phy_dev);
 
+	skb_pool_purge(&pdata->rx_pool);
+
 	SMSC_TRACE(IFDOWN, "Interface stopped");
 	return 0;
 }
@@ -1311,16 +1856,21 @@ static int smsc911x_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	unsigned int freespace;
 	unsigned int tx_cmd_a;
 	unsigned int tx_cmd_b;
-	unsigned int temp;
+	bool use_dma;
 	u32 wrsz;
 	ulong bufp;
 
-	freespace = smsc911x_reg_read(pdata, TX_FIFO_INF) & TX_FIFO_INF_TDFREE_;
+	freespace = smsc911x_tx_freespace(pdata);
 
 	if (unlikely(freespace < TX_FIFO_LOW_THRESHOLD))
 		SMSC_WARNING(TX_ERR,
 			"Tx data fifo low, space available: %d", freespace);
 
+	/* DMA writes the command words from the headroom, so they must be
+	 * computed after any copy made for it */
+	use_dma = pdata->tx_chan && skb->len >= dma_thresh &&
+		!skb_cow_head(skb, SMSC_TX_DMA_HEADROOM);
+
 	/* Word alignment adjustment */
 	tx_cmd_a = (u32)((ulong)skb->data & 0x03) << 16;
 	tx_cmd_a |= TX_CMD_A_FIRST_SEG_ | TX_CMD_A_LAST_SEG_;
@@ -1329,6 +1879,14 @@ static int smsc911x_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	tx_cmd_b = ((unsigned int)skb->len) << 16;
 	tx_cmd_b |= (unsigned int)skb->len;
 
+	freespace -= (skb->len + 32);
+
+	if (use_dma && !smsc911x_tx_dma(pdata, skb, tx_cmd_a, tx_cmd_b))
+		goto queued;
+
+	/* the FIFO must have taken every queued transfer first */
+	smsc911x_tx_dma_flush(pdata);
+
 	smsc911x_reg_write(pdata, TX_DATA_FIFO, tx_cmd_a);
 	smsc911x_reg_write(pdata, TX_DATA_FIFO, tx_cmd_b);
 
@@ -1338,8 +1896,9 @@ static int smsc911x_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	wrsz >>= 2;
 
 	smsc911x_tx_writefifo(pdata, (unsigned int *)bufp, wrsz);
-	freespace -= (skb->len + 32);
-	dev_kfree_skb(skb);
+	pdata->xstats.tx_pio_bytes += wrsz << 2;
+	skb_pool_free(&pdata->rx_pool, skb);
+queued:
 	dev->trans_start = jiffies;
 
 	if (unlikely(smsc911x_tx_get_txstatcount(pdata) >= 30))
@@ -1347,10 +1906,7 @@ static int smsc911x_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	if (freespace < TX_FIFO_LOW_THRESHOLD) {
 		netif_stop_queue(dev);
-		temp = smsc911x_reg_read(pdata, FIFO_INT);
-		temp &= 0x00FFFFFF;
-		temp |= 0x32000000;
-		smsc911x_reg_write(pdata, FIFO_INT, temp);
+		smsc911x_tx_arm_tdfa(pdata);
 	}
 
 	return NETDEV_TX_OK;
@@ -1483,7 +2039,14 @@ static irqreturn_t smsc911x_irqhandler(int irq, void *dev_id)
 		temp |= FIFO_INT_TX_AVAIL_LEVEL_;
 		smsc911x_reg_write(pdata, FIFO_INT, temp);
 		smsc911x_reg_write(pdata, INT_STS, INT_STS_TDFA_);
-		netif_wake_queue(dev);
+		/* queued tx transfers may still fill the FIFO back up.  While
+		 * any are pending the FIFO may already be above the level, so
+		 * rearming here would fire again at once; tx_dma_done checks
+		 * again instead. */
+		if (smsc911x_tx_freespace(pdata) >= TX_FIFO_LOW_THRESHOLD)
+			netif_wake_queue(dev);
+		else if (!ACCESS_ONCE(pdata->tx_dma_pending))
+			smsc911x_tx_arm_tdfa(pdata);
 		serviced = IRQ_HANDLED;
 	}
 
@@ -1494,17 +2057,18 @@ static irqreturn_t smsc911x_irqhandler(int irq, void *dev_id)
 	}
 
 	if (likely(intsts & inten & INT_STS_RSFL_)) {
-		if (likely(napi_schedule_prep(&pdata->napi))) {
-			/* Disable Rx interrupts */
-			temp = smsc911x_reg_read(pdata, INT_EN);
-			temp &= (~INT_EN_RSFL_EN_);
-			smsc911x_reg_write(pdata, INT_EN, temp);
-			/* Schedule a NAPI poll */
-			__napi_schedule(&pdata->napi);
-		} else {
-			SMSC_WARNING(RX_ERR,
-				"napi_schedule_prep failed");
-		}
+		smsc911x_rx_schedule(pdata);
+		serviced = IRQ_HANDLED;
+	}
+
+	if (intsts & inten & INT_STS_GPT_INT_) {
+		/* frames sitting below the RX status level.  An expired
+		 * timer runs on from 0xFFFF, about 6.5s, so load it again */
+		smsc911x_reg_write(pdata, INT_STS, INT_STS_GPT_INT_);
+		smsc911x_reg_write(pdata, GPT_CFG, pdata->gpt_cfg);
+		if (smsc911x_reg_read(pdata, RX_FIFO_INF) &
+		    RX_FIFO_INF_RXSUSED_)
+			smsc911x_rx_schedule(pdata);
 		serviced = IRQ_HANDLED;
 	}
 
@@ -1757,6 +2321,75 @@ static int smsc911x_ethtool_set_eeprom(struct net_device *dev,
 	return ret;
 }
 
+static int smsc911x_ethtool_get_sset_count(struct net_device *dev, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(smsc911x_gstrings_stats);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void smsc911x_ethtool_get_strings(struct net_device *dev,
+					 u32 stringset, u8 *data)
+{
+	if (stringset == ETH_SS_STATS)
+		memcpy(data, smsc911x_gstrings_stats,
+		       sizeof(smsc911x_gstrings_stats));
+}
+
+static void smsc911x_ethtool_get_stats(struct net_device *dev,
+				       struct ethtool_stats *stats, u64 *data)
+{
+	struct smsc911x_data *pdata = netdev_priv(dev);
+	struct skb_pool_stats pool;
+
+	skb_pool_get_stats(&pdata->rx_pool, &pool);
+	data[0] = pdata->xstats.rx_pio_bytes;
+	data[1] = pdata->xstats.rx_dma_bytes;
+	data[2] = pdata->xstats.tx_pio_bytes;
+	data[3] = pdata->xstats.tx_dma_bytes;
+	data[4] = pool.hits;
+	data[5] = pool.misses;
+	data[6] = pool.recycled;
+	data[7] = pdata->coal.stats.samples;
+	data[8] = pdata->coal.stats.raised;
+	data[9] = pdata->coal.stats.lowered;
+}
+
+static int smsc911x_ethtool_get_coalesce(struct net_device *dev,
+					 struct ethtool_coalesce *ec)
+{
+	struct smsc911x_data *pdata = netdev_priv(dev);
+
+	net_coalesce_get(&pdata->coal, ec);
+	return 0;
+}
+
+static int smsc911x_ethtool_set_coalesce(struct net_device *dev,
+					 struct ethtool_coalesce *ec)
+{
+	struct smsc911x_data *pdata = netdev_priv(dev);
+	int ret;
+
+	if (ec->rx_coalesce_usecs_low > SMSC_COAL_USECS_MAX ||
+	    ec->rx_coalesce_usecs > SMSC_COAL_USECS_MAX ||
+	    ec->rx_coalesce_usecs_high > SMSC_COAL_USECS_MAX ||
+	    ec->rx_max_coalesced_frames_low > SMSC_COAL_FRAMES_MAX ||
+	    ec->rx_max_coalesced_frames > SMSC_COAL_FRAMES_MAX ||
+	    ec->rx_max_coalesced_frames_high > SMSC_COAL_FRAMES_MAX)
+		return -EINVAL;
+
+	ret = net_coalesce_set(&pdata->coal, ec);
+	if (ret)
+		return ret;
+
+	if (netif_running(dev))
+		smsc911x_coalesce_hw(pdata);
+	return 0;
+}
+
 static const struct ethtool_ops smsc911x_ethtool_ops = {
 	.get_settings = smsc911x_ethtool_getsettings,
 	.set_settings = smsc911x_ethtool_setsettings,
@@ -1770,6 +2403,11 @@ static const struct ethtool_ops smsc911x_ethtool_ops = {
 	.get_eeprom_len = smsc911x_ethtool_get_eeprom_len,
 	.get_eeprom = smsc911x_ethtool_get_eeprom,
 	.set_eeprom = smsc911x_ethtool_set_eeprom,
+	.get_sset_count = smsc911x_ethtool_get_sset_count,
+	.get_strings = smsc911x_ethtool_get_strings,
+	.get_ethtool_stats = smsc911x_ethtool_get_stats,
+	.get_coalesce = smsc911x_ethtool_get_coalesce,
+	.set_coalesce = smsc911x_ethtool_set_coalesce,
 };
 
 static const struct net_device_ops smsc911x_netdev_ops = {
@@ -1815,6 +2453,8 @@ static int __devinit smsc911x_init(struct net_device *dev)
 	SMSC_TRACE(PROBE, "PHY will be autodetected.");
 
 	spin_lock_init(&pdata->dev_lock);
+	__skb_queue_head_init(&pdata->rx_dma_queue);
+	skb_queue_head_init(&pdata->tx_dma_queue);
 
 	if (pdata->ioaddr == 0) {
 		SMSC_WARNING(PROBE, "pdata->ioaddr: 0x00000000");
@@ -1934,6 +2574,7 @@ static int __devexit smsc911x_drv_remove(struct platform_device *pdev)
 	platform_set_drvdata(pdev, NULL);
 	unregister_netdev(dev);
 	free_irq(dev->irq, dev);
+	skb_pool_destroy(&pdata->rx_pool);
 	res = platform_get_resource_byname(pdev, IORESOURCE_MEM,
 					   "smsc911x-memory");
 	if (!res)
@@ -2020,6 +2661,15 @@ static int __devinit smsc911x_drv_probe(struct platform_device *pdev)
 		goto out_free_netdev_2;
 	}
 
+	retval = skb_pool_init(&pdata->rx_pool, SMSC_RX_SKB_SIZE,
+			       SMSC_RX_RECYCLE_MAX);
+	if (retval)
+		goto out_unmap_io_3;
+
+	net_coalesce_init(&pdata->coal, dev);
+	/* keep the 100us interrupt deassertion interval at the low level */
+	pdata->coal.level_usecs[NET_COALESCE_LOW] = 100;
+
 	retval = smsc911x_init(dev);
 	if (retval < 0) {
 		retval = -ENODEV;
@@ -2106,6 +2756,7 @@ out_unset_drvdata_4:
 	platform_set_drvdata(pdev, NULL);
 	free_irq(dev->irq, dev);
 out_unmap_io_3:
+	skb_pool_destroy(&pdata->rx_pool);
 	iounmap(pdata->ioaddr);
 out_free_netdev_2:
 	free_netdev(dev);
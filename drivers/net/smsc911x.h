@@ -29,6 +29,27 @@
  * NAPI poll */
 #define SMSC_NAPI_WEIGHT	16
 
+/* Receive buffer size: a maximum size frame and its FCS, rounded up to
+ * whole FIFO words after the NET_IP_ALIGN offset */
+#define SMSC_RX_SKB_SIZE	(1536 + NET_IP_ALIGN)
+
+/* Receive buffers kept for reuse, and how many are preallocated */
+#define SMSC_RX_RECYCLE_MAX	64
+#define SMSC_RX_PREALLOC	32
+
+/* Coalescing limits: the interrupt deassertion interval counts in 10us
+ * units and the general purpose timer, which flushes frames held back by
+ * a frame threshold, in 100us units */
+#define SMSC_COAL_USECS_MAX	2550
+#define SMSC_COAL_FRAMES_MAX	256
+
+/* Longest single DMA transfer: a receive buffer, or a frame to transmit
+ * with its two command words and alignment */
+#define SMSC_DMA_MAX_LEN	(SMSC_RX_SKB_SIZE + 8 + 3)
+
+/* Headroom for the tx command words written ahead of a DMA'd frame */
+#define SMSC_TX_DMA_HEADROOM	(8 + 3)
+
 /* implements a PHY loopback test at initialisation time, to ensure a packet
  * can be successfully looped back */
 #define USE_PHY_WORK_AROUND
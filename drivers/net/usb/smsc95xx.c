@@ -640,6 +640,9 @@ static const struct ethtool_ops smsc95xx_ethtool_ops = {
 	.set_tx_csum	= smsc95xx_ethtool_set_tx_csum,
 	.get_rx_csum	= smsc95xx_ethtool_get_rx_csum,
 	.set_rx_csum	= smsc95xx_ethtool_set_rx_csum,
+	.get_sset_count	= usbnet_get_sset_count,
+	.get_strings	= usbnet_get_strings,
+	.get_ethtool_stats = usbnet_get_ethtool_stats,
 };
 
 static int smsc95xx_ioctl(struct net_device *netdev, struct ifreq *rq, int cmd)
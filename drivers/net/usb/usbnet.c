@@ -46,6 +46,9 @@
 
 #define DRIVER_VERSION		"22-Aug-2005"
 
+/* rx frames handed to the stack per NAPI poll */
+#define USBNET_NAPI_WEIGHT	64
+
 
 /*-------------------------------------------------------------------------*/
 
@@ -226,10 +229,12 @@ static int init_status (struct usbnet *dev, struct usb_interface *intf)
 }
 
 /* Passes this packet up the stack, updating its accounting.
- * Some link protocols batch packets, so their rx_fixup paths
- * can return clones as well as just modify the original skb.
+ * Frames completed by the NAPI poll go through GRO, so that the
+ * stack sees one large segment per burst of TCP data; frames
+ * released later from process context use the backlog.
  */
-void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+static void __usbnet_skb_return(struct usbnet *dev, struct sk_buff *skb,
+		bool in_poll)
 {
 	int	status;
 
@@ -246,9 +251,35 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 		devdbg (dev, "< rx, len %zu, type 0x%x",
 			skb->len + sizeof (struct ethhdr), skb->protocol);
 	memset (skb->cb, 0, sizeof (struct skb_data));
-	status = netif_rx (skb);
-	if (status != NET_RX_SUCCESS && netif_msg_rx_err (dev))
-		devdbg (dev, "netif_rx status %d", status);
+
+	if (!in_poll) {
+		status = netif_rx_ni(skb);
+		if (status != NET_RX_SUCCESS && netif_msg_rx_err (dev))
+			devdbg (dev, "netif_rx status %d", status);
+		return;
+	}
+
+	switch (napi_gro_receive(&dev->napi, skb)) {
+	case GRO_MERGED:
+	case GRO_MERGED_FREE:
+		dev->rx_gro_merged++;
+		break;
+	case GRO_DROP:
+		if (netif_msg_rx_err (dev))
+			devdbg (dev, "gro dropped frame");
+		break;
+	default:
+		break;
+	}
+}
+
+/* Some link protocols batch packets, so their rx_fixup paths
+ * can return clones as well as just modify the original skb.
+ * Called from rx_fixup, i.e. from the NAPI poll.
+ */
+void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+{
+	__usbnet_skb_return(dev, skb, true);
 }
 EXPORT_SYMBOL_GPL(usbnet_skb_return);
 
@@ -290,6 +321,25 @@ EXPORT_SYMBOL_GPL(usbnet_change_mtu);
  * completion callbacks.  2.5 should have fixed those bugs...
  */
 
+/* completions and keventd work hand off to the NAPI poll; it must
+ * also run when called from process context, hence the bh guard.
+ */
+static void usbnet_schedule_poll(struct usbnet *dev)
+{
+	if (in_interrupt()) {
+		napi_schedule(&dev->napi);
+	} else {
+		local_bh_disable();
+		napi_schedule(&dev->napi);
+		local_bh_enable();
+	}
+}
+
+static void usbnet_delay_poll(unsigned long param)
+{
+	usbnet_schedule_poll((struct usbnet *) param);
+}
+
 static void defer_bh(struct usbnet *dev, struct sk_buff *skb, struct sk_buff_head *list)
 {
 	unsigned long		flags;
@@ -300,14 +350,14 @@ static void defer_bh(struct usbnet *dev, struct sk_buff *skb, struct sk_buff_hea
 	spin_lock(&dev->done.lock);
 	__skb_queue_tail(&dev->done, skb);
 	if (dev->done.qlen == 1)
-		tasklet_schedule(&dev->bh);
+		napi_schedule(&dev->napi);
 	spin_unlock_irqrestore(&dev->done.lock, flags);
 }
 
-/* some work can't be done in tasklets, so we use keventd
+/* some work can't be done in softirq context, so we use keventd
  *
  * NOTE:  annoying asymmetry:  if it's active, schedule_work() fails,
- * but tasklet_schedule() doesn't.  hope the failure is rare.
+ * but napi_schedule() doesn't.  hope the failure is rare.
  */
 void usbnet_defer_kevent (struct usbnet *dev, int work)
 {
@@ -370,7 +420,7 @@ static void rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 		default:
 			if (netif_msg_rx_err (dev))
 				devdbg (dev, "rx submit, %d", retval);
-			tasklet_schedule (&dev->bh);
+			usbnet_schedule_poll(dev);
 			break;
 		case 0:
 			__skb_queue_tail (&dev->rxq, skb);
@@ -549,11 +599,11 @@ void usbnet_resume_rx(struct usbnet *dev)
 	clear_bit(EVENT_RX_PAUSED, &dev->flags);
 
 	while ((skb = skb_dequeue(&dev->rxq_pause)) != NULL) {
-		usbnet_skb_return(dev, skb);
+		__usbnet_skb_return(dev, skb, false);
 		num++;
 	}
 
-	tasklet_schedule(&dev->bh);
+	usbnet_schedule_poll(dev);
 
 	if (netif_msg_rx_status(dev))
 		devdbg(dev, "paused rx queue disabled, %d skbs requeued", num);
@@ -604,7 +654,7 @@ void usbnet_unlink_rx_urbs(struct usbnet *dev)
 {
 	if (netif_running(dev->net)) {
 		(void) unlink_urbs (dev, &dev->rxq);
-		tasklet_schedule(&dev->bh);
+		usbnet_schedule_poll(dev);
 	}
 }
 EXPORT_SYMBOL_GPL(usbnet_unlink_rx_urbs);
@@ -640,6 +690,19 @@ static void usbnet_terminate_urbs(struct usbnet *dev)
 	remove_wait_queue(&unlink_wakeup, &wait);
 }
 
+/* release whatever completed after the NAPI poll was disabled */
+static void usbnet_purge_done(struct usbnet *dev)
+{
+	struct sk_buff		*skb;
+	struct skb_data		*entry;
+
+	while ((skb = skb_dequeue(&dev->done))) {
+		entry = (struct skb_data *) skb->cb;
+		usb_free_urb(entry->urb);
+		dev_kfree_skb(skb);
+	}
+}
+
 int usbnet_stop (struct net_device *net)
 {
 	struct usbnet		*dev = netdev_priv(net);
@@ -679,7 +742,8 @@ int usbnet_stop (struct net_device *net)
 	 */
 	dev->flags = 0;
 	del_timer_sync (&dev->delay);
-	tasklet_kill (&dev->bh);
+	napi_disable(&dev->napi);
+	usbnet_purge_done(dev);
 	if (info->manage_power)
 		info->manage_power(dev, 0);
 	else
@@ -739,6 +803,7 @@ int usbnet_open (struct net_device *net)
 		}
 	}
 
+	napi_enable(&dev->napi);
 	netif_start_queue (net);
 	if (netif_msg_ifup (dev)) {
 		char	*framing;
@@ -763,11 +828,13 @@ int usbnet_open (struct net_device *net)
 	}
 
 	// delay posting reads until we're fully open
-	tasklet_schedule (&dev->bh);
+	usbnet_schedule_poll(dev);
 	if (info->manage_power) {
 		retval = info->manage_power(dev, 1);
-		if (retval < 0)
+		if (retval < 0) {
+			napi_disable(&dev->napi);
 			goto done;
+		}
 		usb_autopm_put_interface(dev->intf);
 	}
 	return retval;
@@ -870,6 +937,45 @@ void usbnet_set_msglevel (struct net_device *net, u32 level)
 }
 EXPORT_SYMBOL_GPL(usbnet_set_msglevel);
 
+static const char usbnet_gstrings_stats[][ETH_GSTRING_LEN] = {
+	"rx_napi_polls",
+	"rx_napi_frames",
+	"rx_gro_merged",
+};
+
+int usbnet_get_sset_count(struct net_device *net, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(usbnet_gstrings_stats);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+EXPORT_SYMBOL_GPL(usbnet_get_sset_count);
+
+void usbnet_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, usbnet_gstrings_stats,
+			sizeof(usbnet_gstrings_stats));
+}
+EXPORT_SYMBOL_GPL(usbnet_get_strings);
+
+/* how well rx completions are batched: frames per poll, and how many
+ * of those frames GRO folded into an earlier one
+ */
+void usbnet_get_ethtool_stats(struct net_device *net,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+
+	data[0] = dev->rx_polls;
+	data[1] = dev->rx_poll_frames;
+	data[2] = dev->rx_gro_merged;
+}
+EXPORT_SYMBOL_GPL(usbnet_get_ethtool_stats);
+
 /* drivers may override default ethtool_ops in their bind() routine */
 static const struct ethtool_ops usbnet_ethtool_ops = {
 	.get_settings		= usbnet_get_settings,
@@ -879,6 +985,9 @@ static const struct ethtool_ops usbnet_ethtool_ops = {
 	.get_drvinfo		= usbnet_get_drvinfo,
 	.get_msglevel		= usbnet_get_msglevel,
 	.set_msglevel		= usbnet_set_msglevel,
+	.get_sset_count		= usbnet_get_sset_count,
+	.get_strings		= usbnet_get_strings,
+	.get_ethtool_stats	= usbnet_get_ethtool_stats,
 };
 
 /*-------------------------------------------------------------------------*/
@@ -932,11 +1041,11 @@ fail_halt:
 					status);
 		} else {
 			clear_bit (EVENT_RX_HALT, &dev->flags);
-			tasklet_schedule (&dev->bh);
+			usbnet_schedule_poll(dev);
 		}
 	}
 
-	/* tasklet could resubmit itself forever if memory is tight */
+	/* the poll could resubmit itself forever if memory is tight */
 	if (test_bit (EVENT_RX_MEMORY, &dev->flags)) {
 		struct urb	*urb = NULL;
 
@@ -952,7 +1061,7 @@ fail_halt:
 			rx_submit (dev, urb, GFP_KERNEL);
 			usb_autopm_put_interface(dev->intf);
 fail_lowmem:
-			tasklet_schedule (&dev->bh);
+			usbnet_schedule_poll(dev);
 		}
 	}
 
@@ -1040,7 +1149,7 @@ void usbnet_tx_timeout (struct net_device *net)
 	struct usbnet		*dev = netdev_priv(net);
 
 	unlink_urbs (dev, &dev->txq);
-	tasklet_schedule (&dev->bh);
+	usbnet_schedule_poll(dev);
 
 	// FIXME: device recovery -- reset?
 }
@@ -1158,20 +1267,27 @@ EXPORT_SYMBOL_GPL(usbnet_start_xmit);
 
 /*-------------------------------------------------------------------------*/
 
-// tasklet (work deferred from completions, in_irq) or timer
+// NAPI poll (work deferred from completions, in_irq) or timer
+//
+// each rx urb that completed counts against the budget; tx completions
+// and cleanup are free.  GRO gets to see the whole batch of frames
+// before it is flushed when the poll completes.
 
-static void usbnet_bh (unsigned long param)
+static int usbnet_poll (struct napi_struct *napi, int budget)
 {
-	struct usbnet		*dev = (struct usbnet *) param;
+	struct usbnet		*dev = container_of(napi, struct usbnet, napi);
 	struct sk_buff		*skb;
 	struct skb_data		*entry;
+	int			work = 0;
+	bool			starved = false;
 
-	while ((skb = skb_dequeue (&dev->done))) {
+	while (work < budget && (skb = skb_dequeue (&dev->done))) {
 		entry = (struct skb_data *) skb->cb;
 		switch (entry->state) {
 		case rx_done:
 			entry->state = rx_cleanup;
 			rx_process (dev, skb);
+			work++;
 			continue;
 		case tx_done:
 		case rx_cleanup:
@@ -1211,11 +1327,23 @@ static void usbnet_bh (unsigned long param)
 				devdbg (dev, "rxqlen %d --> %d",
 						temp, dev->rxq.qlen);
 			if (dev->rxq.qlen < qlen)
-				tasklet_schedule (&dev->bh);
+				starved = true;
 		}
 		if (dev->txq.qlen < TX_QLEN (dev))
 			netif_wake_queue (dev->net);
 	}
+
+	dev->rx_polls++;
+	dev->rx_poll_frames += work;
+
+	if (work < budget) {
+		napi_complete(napi);
+		// defer_bh() only schedules on an empty -> nonempty
+		// transition, which may have raced with the loop above
+		if (starved || !skb_queue_empty(&dev->done))
+			napi_schedule(napi);
+	}
+	return work;
 }
 
 
@@ -1252,6 +1380,9 @@ void usbnet_disconnect (struct usb_interface *intf)
 	/* we don't hold rtnl here ... */
 	flush_scheduled_work ();
 
+	/* FLAG_AVOID_UNLINK_URBS lets urbs outlive usbnet_stop() */
+	usbnet_purge_done(dev);
+
 	if (dev->driver_info->unbind)
 		dev->driver_info->unbind (dev, intf);
 
@@ -1324,11 +1455,9 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	skb_queue_head_init (&dev->txq);
 	skb_queue_head_init (&dev->done);
 	skb_queue_head_init(&dev->rxq_pause);
-	dev->bh.func = usbnet_bh;
-	dev->bh.data = (unsigned long) dev;
 	INIT_WORK (&dev->kevent, kevent);
 	init_usb_anchor(&dev->deferred);
-	dev->delay.function = usbnet_bh;
+	dev->delay.function = usbnet_delay_poll;
 	dev->delay.data = (unsigned long) dev;
 	init_timer (&dev->delay);
 	mutex_init (&dev->phy_mutex);
@@ -1351,6 +1480,8 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	net->netdev_ops = &usbnet_netdev_ops;
 	net->watchdog_timeo = TX_TIMEOUT_JIFFIES;
 	net->ethtool_ops = &usbnet_ethtool_ops;
+	net->features |= NETIF_F_GRO;
+	netif_napi_add(net, &dev->napi, usbnet_poll, USBNET_NAPI_WEIGHT);
 
 	// allow device-specific bind/init procedures
 	// NOTE net->name still not usable ...
@@ -1503,7 +1634,7 @@ int usbnet_resume (struct usb_interface *intf)
 		spin_unlock_irq(&dev->txq.lock);
 		if (!(dev->txq.qlen >= TX_QLEN(dev)))
 			netif_start_queue(dev->net);
-		tasklet_schedule (&dev->bh);
+		usbnet_schedule_poll(dev);
 	}
 	return 0;
 }
@@ -101,6 +101,14 @@ static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 	return container_of(f, struct f_rndis, port.func);
 }
 
+/* RNDIS lets both sides pack several packets into one bulk transfer,
+ * which saves a completion interrupt per packet.  This caps how many,
+ * in both directions; 1 sends and accepts one packet per transfer.
+ */
+static unsigned rndis_max_pkts = 8;
+module_param(rndis_max_pkts, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_max_pkts, "max packets per RNDIS transfer");
+
 /* peak (theoretical) bulk transfer rate in bits-per-second */
 static unsigned int bitrate(struct usb_gadget *g)
 {
@@ -318,6 +326,52 @@ static struct sk_buff *rndis_add_header(struct gether *port,
 	return skb2;
 }
 
+static struct sk_buff *rndis_add_header_list(struct gether *port,
+					struct sk_buff_head *list)
+{
+	struct sk_buff	*skb, *skb2;
+	unsigned	len = 0;
+
+	skb_queue_walk(list, skb)
+		len += sizeof(struct rndis_packet_msg_type) + skb->len;
+
+	/* one spare byte, for padding a transfer that would need a zlp */
+	skb2 = alloc_skb(len + 1, GFP_ATOMIC);
+	if (!skb2)
+		return NULL;
+
+	while ((skb = __skb_dequeue(list)) != NULL) {
+		struct rndis_packet_msg_type	*header;
+
+		header = (void *) skb_put(skb2, sizeof *header);
+		memset(header, 0, sizeof *header);
+		header->MessageType = cpu_to_le32(REMOTE_NDIS_PACKET_MSG);
+		header->MessageLength = cpu_to_le32(sizeof *header + skb->len);
+		header->DataOffset = cpu_to_le32(36);
+		header->DataLength = cpu_to_le32(skb->len);
+
+		skb_copy_bits(skb, 0, skb_put(skb2, skb->len), skb->len);
+		dev_kfree_skb_any(skb);
+	}
+	return skb2;
+}
+
+/* The host's REMOTE_NDIS_INITIALIZE_MSG says how large our IN transfers
+ * may be.  Batch packets into them only when at least two fit; keep one
+ * byte spare for the zlp padding.
+ */
+static void rndis_update_tx_limits(struct f_rndis *rndis)
+{
+	u32		max = rndis_get_host_max_xfer(rndis->config);
+
+	if (rndis_max_pkts > 1 && max > 2 * RNDIS_PKT_XFER_SIZE(ETH_DATA_LEN)) {
+		rndis->port.tx_max_size = max - 1;
+		rndis->port.tx_max_frames = rndis_max_pkts;
+	} else {
+		rndis->port.tx_max_frames = 0;
+	}
+}
+
 static void rndis_response_available(void *_rndis)
 {
 	struct f_rndis			*rndis = _rndis;
@@ -396,6 +450,8 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 		ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
 //	spin_unlock(&dev->lock);
+
+	rndis_update_tx_limits(rndis);
 }
 
 static int
@@ -553,6 +609,7 @@ static void rndis_disable(struct usb_function *f)
 
 	rndis_uninit(rndis->config);
 	gether_disconnect(&rndis->port);
+	rndis->port.tx_max_frames = 0;
 
 	usb_ep_disable(rndis->notify);
 	rndis->notify->driver_data = NULL;
@@ -705,6 +762,7 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
+	rndis_set_max_pkt_xfer(rndis->config, max(rndis_max_pkts, 1U));
 
 	if (rndis_set_param_vendor(rndis->config, vendorID,
 				manufacturer))
@@ -839,6 +897,9 @@ int __init rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.wrap_list = rndis_add_header_list;
+	rndis->port.rx_max_size = max(rndis_max_pkts, 1U)
+		* RNDIS_PKT_XFER_SIZE(ETH_DATA_LEN);
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
@@ -196,6 +196,10 @@ struct rndis_packet_msg_type
 	__le32	Reserved;
 } __attribute__ ((packed));
 
+/* room one packet takes in a transfer, for a given MTU */
+#define RNDIS_PKT_XFER_SIZE(mtu) \
+	((mtu) + sizeof(struct ethhdr) + sizeof(struct rndis_packet_msg_type) + 22)
+
 struct rndis_config_parameter
 {
 	__le32	ParameterNameOffset;
@@ -241,6 +245,12 @@ typedef struct rndis_params
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
+
+	/* multi-packet transfers: what we accept from the host, and the
+	 * limit the host set with REMOTE_NDIS_INITIALIZE_MSG
+	 */
+	u32			max_pkt_per_xfer;
+	u32			host_max_xfer_size;
 	u8			mcast_addr[RNDIS_MAX_MULTICAST_SIZE][6];
 } rndis_params;
 
@@ -253,6 +263,8 @@ int  rndis_set_param_dev (u8 configNr, struct net_device *dev,
 int  rndis_set_param_vendor (u8 configNr, u32 vendorID,
 			    const char *vendorDescr);
 int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
+int  rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer);
+u32  rndis_get_host_max_xfer(u8 configNr);
 void rndis_add_hdr (struct sk_buff *skb);
 int rndis_rm_hdr(struct gether *port, struct sk_buff *skb,
 			struct sk_buff_head *list);
@@ -27,6 +27,7 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/hrtimer.h>
 
 #include "u_ether.h"
 
@@ -64,11 +65,24 @@ struct eth_dev {
 	struct net_device	*net;
 	struct usb_gadget	*gadget;
 
-	spinlock_t		req_lock;	/* guard {rx,tx}_reqs */
+	spinlock_t		req_lock;	/* guard {rx,tx}_reqs, tx_frames */
 	struct list_head	tx_reqs, rx_reqs;
 	atomic_t		tx_qlen;
 
+	/* frames waiting for a multi-frame IN transfer */
+	struct sk_buff_head	tx_frames;
+	unsigned		tx_frames_len;
+	struct hrtimer		tx_timer;
+
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	napi;
+
+	/* rx batching statistics, reported through ethtool */
+	unsigned long		rx_polls;
+	unsigned long		rx_poll_frames;
+	unsigned long		rx_gro_merged;
+	unsigned long		rx_xfers;
+	unsigned long		tx_xfers;
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
@@ -91,6 +105,19 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+#define NAPI_WEIGHT	64	/* rx frames handed up per poll */
+#define RX_FRAMES_MAX	1000	/* like netdev_max_backlog */
+
+/* number of frames carried by an IN transfer's skb */
+#define TX_FRAMES(skb)	(*(unsigned *)(skb)->cb)
+
+/* how long a partly filled multi-frame IN transfer may wait for more
+ * frames while earlier transfers are still in flight
+ */
+static unsigned tx_flush_usecs = 100;
+module_param(tx_flush_usecs, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_flush_usecs, "multi-frame IN transfer flush delay");
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -179,6 +206,42 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
 	strlcpy(p->bus_info, dev_name(&dev->gadget->dev), sizeof p->bus_info);
 }
 
+static const char eth_gstrings_stats[][ETH_GSTRING_LEN] = {
+	"rx_napi_polls",
+	"rx_napi_frames",
+	"rx_gro_merged",
+	"rx_transfers",
+	"tx_transfers",
+};
+
+static int eth_get_sset_count(struct net_device *net, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(eth_gstrings_stats);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void eth_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, eth_gstrings_stats, sizeof eth_gstrings_stats);
+}
+
+static void eth_get_ethtool_stats(struct net_device *net,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct eth_dev	*dev = netdev_priv(net);
+
+	data[0] = dev->rx_polls;
+	data[1] = dev->rx_poll_frames;
+	data[2] = dev->rx_gro_merged;
+	data[3] = dev->rx_xfers;
+	data[4] = dev->tx_xfers;
+}
+
 /* REVISIT can also support:
  *   - WOL (by tracking suspends and issuing remote wakeup)
  *   - msglevel (implies updated messaging)
@@ -188,6 +251,9 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
 static const struct ethtool_ops ops = {
 	.get_drvinfo = eth_get_drvinfo,
 	.get_link = ethtool_op_get_link,
+	.get_sset_count = eth_get_sset_count,
+	.get_strings = eth_get_strings,
+	.get_ethtool_stats = eth_get_ethtool_stats,
 };
 
 static void defer_kevent(struct eth_dev *dev, int flag)
@@ -236,6 +302,10 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+
+	/* framings that batch frames size the transfer themselves */
+	if (dev->port_usb->rx_max_size > size)
+		size = dev->port_usb->rx_max_size;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -271,9 +341,57 @@ enomem:
 	return retval;
 }
 
+/* Frames unwrapped by rx_complete() are handed to the stack here, in
+ * batches, so that GRO can merge consecutive TCP segments before the
+ * poll completes and flushes them.
+ */
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&dev->rx_frames))) {
+		work++;
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		/* no buffer copies needed, unless hardware can't
+		 * use skb buffers.
+		 */
+		switch (napi_gro_receive(napi, skb)) {
+		case GRO_MERGED:
+		case GRO_MERGED_FREE:
+			dev->rx_gro_merged++;
+			break;
+		default:
+			break;
+		}
+	}
+
+	dev->rx_polls++;
+	dev->rx_poll_frames += work;
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* rx_complete() may have queued more after we looked */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context, *skb2;
+	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
 
@@ -282,6 +400,13 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
+		dev->rx_xfers++;
+
+		/* the stack isn't keeping up; drop instead of queueing */
+		if (skb_queue_len(&dev->rx_frames) > RX_FRAMES_MAX) {
+			dev->net->stats.rx_dropped++;
+			break;
+		}
 
 		if (dev->unwrap) {
 			unsigned long	flags;
@@ -301,28 +426,10 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
-		}
+		if (status < 0)
+			dev->net->stats.rx_errors++;
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(&dev->napi);
 		break;
 
 	/* software-driven interface shutdown */
@@ -457,6 +564,8 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_flush(struct eth_dev *dev);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -473,7 +582,7 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case 0:
 		dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	dev->net->stats.tx_packets += TX_FRAMES(skb);
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
@@ -481,6 +590,11 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	dev_kfree_skb_any(skb);
 
 	atomic_dec(&dev->tx_qlen);
+
+	/* frames batched up while this transfer was busy go out next */
+	if (!skb_queue_empty(&dev->tx_frames))
+		tx_flush(dev);
+
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
@@ -490,21 +604,183 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/* give back a request that couldn't be queued */
+static void tx_recycle(struct eth_dev *dev, struct usb_request *req)
+{
+	unsigned long	flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+/* queue one IN transfer carrying @frames network frames; on failure the
+ * skb is freed and the request recycled
+ */
+static void tx_submit(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, struct sk_buff *skb, unsigned frames)
+{
+	int		length = skb->len;
+	int		retval;
+
+	/* no buffer copies needed, unless the network stack did it
+	 * or the hardware can't use skb buffers.
+	 * or there's not enough space for extra headers we need
+	 */
+	req->buf = skb->data;
+	req->context = skb;
+	req->complete = tx_complete;
+	TX_FRAMES(skb) = frames;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	req->zero = 1;
+	if (!dev->zlp && (length % in->maxpacket) == 0)
+		length++;
+
+	req->length = length;
+
+	/* throttle highspeed IRQ rate back slightly */
+	if (gadget_is_dualspeed(dev->gadget))
+		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH)
+			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
+			: 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		DBG(dev, "tx queue err %d\n", retval);
+		break;
+	case 0:
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		dev->tx_xfers++;
+	}
+
+	if (retval) {
+		dev_kfree_skb_any(skb);
+		dev->net->stats.tx_dropped += frames;
+		tx_recycle(dev, req);
+	}
+}
+
+/*
+ * Multi-frame IN transfers.  Frames collect in tx_frames until the
+ * batch is full, the link is idle, or tx_flush_usecs pass; then the
+ * function's wrap_list() merges them into a single transfer.  While
+ * one transfer is on the bus the next batch fills up, so under load
+ * the completion rate drops well below the packet rate.
+ */
+
+static void tx_flush(struct eth_dev *dev)
+{
+	struct sk_buff_head	list;
+	struct usb_request	*req;
+	struct sk_buff		*skb = NULL;
+	struct usb_ep		*in = NULL;
+	unsigned		frames;
+	unsigned long		flags;
+
+	__skb_queue_head_init(&list);
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (skb_queue_empty(&dev->tx_frames) || list_empty(&dev->tx_reqs)) {
+		/* tx_complete() will be back for the rest */
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return;
+	}
+	req = container_of(dev->tx_reqs.next, struct usb_request, list);
+	list_del(&req->list);
+	skb_queue_splice_init(&dev->tx_frames, &list);
+	dev->tx_frames_len = 0;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	frames = skb_queue_len(&list);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb && dev->port_usb->wrap_list) {
+		in = dev->port_usb->in_ep;
+		skb = dev->port_usb->wrap_list(dev->port_usb, &list);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+	__skb_queue_purge(&list);
+
+	if (!skb) {
+		dev->net->stats.tx_dropped += frames;
+		tx_recycle(dev, req);
+		return;
+	}
+	tx_submit(dev, in, req, skb, frames);
+}
+
+static enum hrtimer_restart tx_timer_fn(struct hrtimer *timer)
+{
+	tx_flush(container_of(timer, struct eth_dev, tx_timer));
+	return HRTIMER_NORESTART;
+}
+
+static netdev_tx_t tx_batch(struct eth_dev *dev, struct sk_buff *skb,
+		unsigned max_frames, u32 max_size, u32 header_len)
+{
+	struct net_device	*net = dev->net;
+	unsigned long		flags;
+	u32			frame = net->mtu + ETH_HLEN + header_len;
+	bool			full;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	__skb_queue_tail(&dev->tx_frames, skb);
+	dev->tx_frames_len += skb->len + header_len;
+
+	/* full once another maximum size frame might not fit */
+	full = skb_queue_len(&dev->tx_frames) >= max_frames
+		|| dev->tx_frames_len + frame > max_size;
+
+	if (full && list_empty(&dev->tx_reqs)) {
+		/* tx_complete() flushes and wakes us */
+		netif_stop_queue(net);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return NETDEV_TX_OK;
+	}
+
+	if (!full && atomic_read(&dev->tx_qlen)) {
+		/* transfers in flight; let this batch grow a bit */
+		if (!hrtimer_is_queued(&dev->tx_timer))
+			hrtimer_start(&dev->tx_timer,
+				ktime_set(0, tx_flush_usecs * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return NETDEV_TX_OK;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	tx_flush(dev);
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
 	struct eth_dev		*dev = netdev_priv(net);
-	int			length = skb->len;
-	int			retval;
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	unsigned		max_frames = 0;
+	u32			max_size = 0, header_len = 0;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		if (dev->port_usb->wrap_list) {
+			max_frames = dev->port_usb->tx_max_frames;
+			max_size = dev->port_usb->tx_max_size;
+			header_len = dev->port_usb->header_len;
+		}
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -538,6 +814,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (max_frames)
+		return tx_batch(dev, skb, max_frames, max_size, header_len);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -557,10 +836,6 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		netif_stop_queue(net);
 	spin_unlock_irqrestore(&dev->req_lock, flags);
 
-	/* no buffer copies needed, unless the network stack did it
-	 * or the hardware can't use skb buffers.
-	 * or there's not enough space for extra headers we need
-	 */
 	if (dev->wrap) {
 		unsigned long	flags;
 
@@ -568,51 +843,14 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		if (dev->port_usb)
 			skb = dev->wrap(dev->port_usb, skb);
 		spin_unlock_irqrestore(&dev->lock, flags);
-		if (!skb)
-			goto drop;
-
-		length = skb->len;
-	}
-	req->buf = skb->data;
-	req->context = skb;
-	req->complete = tx_complete;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	req->zero = 1;
-	if (!dev->zlp && (length % in->maxpacket) == 0)
-		length++;
-
-	req->length = length;
-
-	/* throttle highspeed IRQ rate back slightly */
-	if (gadget_is_dualspeed(dev->gadget))
-		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH)
-			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
-			: 0;
-
-	retval = usb_ep_queue(in, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		DBG(dev, "tx queue err %d\n", retval);
-		break;
-	case 0:
-		net->trans_start = jiffies;
-		atomic_inc(&dev->tx_qlen);
+		if (!skb) {
+			dev->net->stats.tx_dropped++;
+			tx_recycle(dev, req);
+			return NETDEV_TX_OK;
+		}
 	}
 
-	if (retval) {
-		dev_kfree_skb_any(skb);
-drop:
-		dev->net->stats.tx_dropped++;
-		spin_lock_irqsave(&dev->req_lock, flags);
-		if (list_empty(&dev->tx_reqs))
-			netif_start_queue(net);
-		list_add(&req->list, &dev->tx_reqs);
-		spin_unlock_irqrestore(&dev->req_lock, flags);
-	}
+	tx_submit(dev, in, req, skb, 1);
 	return NETDEV_TX_OK;
 }
 
@@ -636,6 +874,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -656,6 +895,13 @@ static int eth_stop(struct net_device *net)
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
 
+	/* drop frames still waiting for a multi-frame transfer */
+	hrtimer_cancel(&dev->tx_timer);
+	spin_lock_irqsave(&dev->req_lock, flags);
+	__skb_queue_purge(&dev->tx_frames);
+	dev->tx_frames_len = 0;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
 		dev->net->stats.rx_errors, dev->net->stats.tx_errors
@@ -688,6 +934,9 @@ static int eth_stop(struct net_device *net)
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	napi_disable(&dev->napi);
+	skb_queue_purge(&dev->rx_frames);
+
 	return 0;
 }
 
@@ -780,10 +1029,15 @@ int __init gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->tx_frames);
+	hrtimer_init(&dev->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_timer.function = tx_timer_fn;
 
 	/* network device setup */
 	dev->net = net;
 	strcpy(net->name, "usb%d");
+	net->features |= NETIF_F_GRO;
+	netif_napi_add(net, &dev->napi, eth_poll, NAPI_WEIGHT);
 
 	if (get_ether_addr(dev_addr, net->dev_addr))
 		dev_warn(&g->dev,
@@ -835,6 +1089,9 @@ void gether_cleanup(void)
 		return;
 
 	unregister_netdev(the_dev->net);
+	hrtimer_cancel(&the_dev->tx_timer);
+	skb_queue_purge(&the_dev->rx_frames);
+	skb_queue_purge(&the_dev->tx_frames);
 	free_netdev(the_dev->net);
 
 	/* assuming we used keventd, it must quiesce too */
@@ -950,6 +1207,13 @@ void gether_disconnect(struct gether *link)
 	netif_stop_queue(dev->net);
 	netif_carrier_off(dev->net);
 
+	/* drop frames still waiting for a multi-frame transfer */
+	hrtimer_cancel(&dev->tx_timer);
+	spin_lock(&dev->req_lock);
+	__skb_queue_purge(&dev->tx_frames);
+	dev->tx_frames_len = 0;
+	spin_unlock(&dev->req_lock);
+
 	/* disable endpoints, forcing (synchronous) completion
 	 * of all pending i/o.  then free the request objects
 	 * and forget about the endpoints.
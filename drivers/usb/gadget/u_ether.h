@@ -68,6 +68,19 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* multi-frame transfers, for framings that allow them (RNDIS,
+	 * NCM).  When tx_max_frames is nonzero, wrap_list() replaces
+	 * wrap(): it turns up to tx_max_frames frames, totalling at most
+	 * tx_max_size bytes including header_len per frame, into one IN
+	 * transfer.  OUT transfers may be up to rx_max_size bytes, with
+	 * unwrap() splitting them into frames.
+	 */
+	unsigned			tx_max_frames;
+	u32				tx_max_size;
+	u32				rx_max_size;
+	struct sk_buff			*(*wrap_list)(struct gether *port,
+						struct sk_buff_head *list);
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -111,6 +124,7 @@ static inline bool can_support_ecm(struct usb_gadget *gadget)
 int geth_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN]);
 int ecm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN]);
 int eem_bind_config(struct usb_configuration *c);
+int ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN]);
 
 #ifdef USB_ETH_RNDIS
 
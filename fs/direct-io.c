@@ -125,6 +125,7 @@ struct dio {
 	unsigned long refcount;		/* direct_io_worker() and bios */
 	struct bio *bio_list;		/* singly linked via bi_private */
 	struct task_struct *waiter;	/* waiting task (NULL if none) */
+	struct request_queue *poll_queue; /* queue of the last bio */
 
 	/* AIO related stuff */
 	struct kiocb *iocb;		/* kiocb */
@@ -340,6 +341,7 @@ static void dio_bio_submit(struct dio *dio)
 	if (dio->is_async && dio->rw == READ)
 		bio_set_pages_dirty(bio);
 
+	dio->poll_queue = bdev_get_queue(bio->bi_bdev);
 	submit_bio(dio->rw, bio);
 
 	dio->bio = NULL;
@@ -355,6 +357,17 @@ static void dio_cleanup(struct dio *dio)
 		page_cache_release(dio_get_page(dio));
 }
 
+/*
+ * blk_poll() callback: true once dio_await_one() would not have to sleep.
+ */
+static int dio_bio_ready(void *data)
+{
+	struct dio *dio = data;
+
+	return ACCESS_ONCE(dio->refcount) == 1 ||
+		ACCESS_ONCE(dio->bio_list) != NULL;
+}
+
 /*
  * Wait for the next BIO to complete.  Remove it and return it.  NULL is
  * returned once all BIOs have been completed.  This must only be called once
@@ -366,6 +379,13 @@ static struct bio *dio_await_one(struct dio *dio)
 	unsigned long flags;
 	struct bio *bio = NULL;
 
+	/*
+	 * Spin for the completion first if the device wants that, the
+	 * check below is repeated under bio_lock either way.
+	 */
+	if (dio->poll_queue && !dio_bio_ready(dio))
+		blk_poll(dio->poll_queue, dio_bio_ready, dio);
+
 	spin_lock_irqsave(&dio->bio_lock, flags);
 
 	/*
@@ -38,6 +38,10 @@ typedef int (congested_fn)(void *, int);
 enum bdi_stat_item {
 	BDI_RECLAIMABLE,
 	BDI_WRITEBACK,
+	BDI_RA_SUBMITTED,	/* pages submitted by windowed readahead */
+	BDI_RA_HIT,		/* readahead pages the reader went on to use */
+	BDI_RA_MISS,		/* readahead pages the reader left behind */
+	BDI_RA_EVICTED,		/* readahead markers reclaimed before use */
 	NR_BDI_STAT_ITEMS
 };
 
@@ -78,6 +82,13 @@ struct backing_dev_info {
 	unsigned int min_ratio;
 	unsigned int max_ratio, max_prop_frac;
 
+	unsigned int ra_adaptive;	/* learn the readahead window */
+	unsigned long ra_learned;	/* learned window, 0 if none yet */
+	spinlock_t ra_lock;		/* protects the learning state below */
+	unsigned long ra_acc_hit;	/* used pages this learning period */
+	unsigned long ra_acc_miss;	/* wasted pages this learning period */
+	s64 ra_evicted_seen;		/* BDI_RA_EVICTED at the last period */
+
 	struct bdi_writeback wb;  /* default writeback info for this bdi */
 	spinlock_t wb_lock;	  /* protects update side of wb_list */
 	struct list_head wb_list; /* the flusher threads hanging off this bdi */
@@ -122,6 +133,16 @@ static inline void __add_bdi_stat(struct backing_dev_info *bdi,
 	__percpu_counter_add(&bdi->bdi_stat[item], amount, BDI_STAT_BATCH);
 }
 
+static inline void add_bdi_stat(struct backing_dev_info *bdi,
+		enum bdi_stat_item item, s64 amount)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	__add_bdi_stat(bdi, item, amount);
+	local_irq_restore(flags);
+}
+
 static inline void __inc_bdi_stat(struct backing_dev_info *bdi,
 		enum bdi_stat_item item)
 {
@@ -196,6 +217,8 @@ static inline unsigned long bdi_stat_error(struct backing_dev_info *bdi)
 int bdi_set_min_ratio(struct backing_dev_info *bdi, unsigned int min_ratio);
 int bdi_set_max_ratio(struct backing_dev_info *bdi, unsigned int max_ratio);
 
+unsigned long bdi_ra_pages(struct backing_dev_info *bdi);
+
 /*
  * Flags in backing_dev_info::capability
  *
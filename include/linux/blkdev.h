@@ -115,6 +115,7 @@ enum rq_flag_bits {
 	__REQ_NOIDLE,		/* Don't anticipate more IO after this one */
 	__REQ_IO_STAT,		/* account I/O stat */
 	__REQ_MIXED_MERGE,	/* merge of different types, fail separately */
+	__REQ_SECURE,		/* secure discard (used with __REQ_DISCARD) */
 	__REQ_NR_BITS,		/* stops here */
 };
 
@@ -144,6 +145,7 @@ enum rq_flag_bits {
 #define REQ_NOIDLE	(1 << __REQ_NOIDLE)
 #define REQ_IO_STAT	(1 << __REQ_IO_STAT)
 #define REQ_MIXED_MERGE	(1 << __REQ_MIXED_MERGE)
+#define REQ_SECURE	(1 << __REQ_SECURE)
 
 #define REQ_FAILFAST_MASK	(REQ_FAILFAST_DEV | REQ_FAILFAST_TRANSPORT | \
 				 REQ_FAILFAST_DRIVER)
@@ -193,6 +195,11 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
+	/* for the latency histograms, zero unless they are enabled */
+	u64 start_time_ns;
+	u64 io_start_time_ns;
+	/* when the completion IPI was sent, with adaptive rq_affinity */
+	u64 ipi_time_ns;
 
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -274,6 +281,7 @@ typedef void (prepare_flush_fn) (struct request_queue *, struct request *);
 typedef void (softirq_done_fn)(struct request *);
 typedef int (dma_drain_needed_fn)(struct request *);
 typedef int (lld_busy_fn) (struct request_queue *q);
+typedef int (poll_fn) (struct request_queue *q);
 
 enum blk_eh_timer_return {
 	BLK_EH_NOT_HANDLED,
@@ -325,6 +333,36 @@ struct queue_limits {
 	signed char		discard_zeroes_data;
 };
 
+/*
+ * Request latency histograms, see Documentation/block/queue-sysfs.txt.
+ * Bucket 0 counts requests that took less than a microsecond, bucket n
+ * those that took at least 2^(n-1) and less than 2^n microseconds.  The
+ * last bucket counts everything from there up.
+ */
+enum {
+	BLK_LAT_READ,
+	BLK_LAT_WRITE,
+	BLK_LAT_SYNC_WRITE,
+	BLK_LAT_TYPES,
+};
+
+#define BLK_LAT_BUCKETS		22
+
+struct blk_lat_stats {
+	/* from allocation until the driver started the request */
+	unsigned long		queue[BLK_LAT_TYPES][BLK_LAT_BUCKETS];
+	/* from then until it completed */
+	unsigned long		service[BLK_LAT_TYPES][BLK_LAT_BUCKETS];
+};
+
+/*
+ * Where softirq completions ran, kept per CPU
+ */
+struct blk_comp_stats {
+	unsigned long		local;	/* on the CPU that took the interrupt */
+	unsigned long		remote;	/* sent to another CPU by IPI */
+};
+
 struct request_queue
 {
 	/*
@@ -349,6 +387,7 @@ struct request_queue
 	rq_timed_out_fn		*rq_timed_out_fn;
 	dma_drain_needed_fn	*dma_drain_needed;
 	lld_busy_fn		*lld_busy_fn;
+	poll_fn			*poll_fn;
 
 	/*
 	 * Dispatch queue sorting
@@ -439,6 +478,23 @@ struct request_queue
 
 	struct mutex		sysfs_lock;
 
+	/* updated under queue_lock */
+	struct blk_lat_stats	lat_stats;
+
+	/*
+	 * polled completions, see blk_poll()
+	 */
+	unsigned int		poll_usecs;	/* max time to spin */
+	atomic_long_t		poll_hits;	/* waits ended by polling */
+	atomic_long_t		poll_misses;	/* waits that had to sleep */
+
+	/*
+	 * completion CPU selection, see __blk_complete_request()
+	 */
+	struct blk_comp_stats	*comp_stats;	/* per cpu */
+	unsigned long		comp_ipi_ns;	/* average IPI delivery time */
+	unsigned int		comp_ipi_max_ns;
+
 #if defined(CONFIG_BLK_DEV_BSG)
 	struct bsg_class_device bsg_dev;
 #endif
@@ -463,6 +519,11 @@ struct request_queue
 #define QUEUE_FLAG_IO_STAT     15	/* do IO stats */
 #define QUEUE_FLAG_CQ	       16	/* hardware does queuing */
 #define QUEUE_FLAG_DISCARD     17	/* supports DISCARD */
+#define QUEUE_FLAG_SECDISCARD  18	/* supports SECDISCARD */
+#define QUEUE_FLAG_LAT_STAT    19	/* keep latency histograms */
+#define QUEUE_FLAG_POLL	       20	/* poll for sync I/O completion */
+#define QUEUE_FLAG_SAME_FORCE  21	/* complete on the exact same CPU */
+#define QUEUE_FLAG_SAME_ADAPT  22	/* same CPU while IPIs are cheap */
 
 #define QUEUE_FLAG_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
 				 (1 << QUEUE_FLAG_CLUSTER) |		\
@@ -591,10 +652,14 @@ enum {
 #define blk_queue_nomerges(q)	test_bit(QUEUE_FLAG_NOMERGES, &(q)->queue_flags)
 #define blk_queue_nonrot(q)	test_bit(QUEUE_FLAG_NONROT, &(q)->queue_flags)
 #define blk_queue_io_stat(q)	test_bit(QUEUE_FLAG_IO_STAT, &(q)->queue_flags)
+#define blk_queue_lat_stat(q)	test_bit(QUEUE_FLAG_LAT_STAT, &(q)->queue_flags)
+#define blk_queue_poll(q)	test_bit(QUEUE_FLAG_POLL, &(q)->queue_flags)
 #define blk_queue_flushing(q)	((q)->ordseq)
 #define blk_queue_stackable(q)	\
 	test_bit(QUEUE_FLAG_STACKABLE, &(q)->queue_flags)
 #define blk_queue_discard(q)	test_bit(QUEUE_FLAG_DISCARD, &(q)->queue_flags)
+#define blk_queue_secdiscard(q)	(blk_queue_discard(q) && \
+	test_bit(QUEUE_FLAG_SECDISCARD, &(q)->queue_flags))
 
 #define blk_fs_request(rq)	((rq)->cmd_type == REQ_TYPE_FS)
 #define blk_pc_request(rq)	((rq)->cmd_type == REQ_TYPE_BLOCK_PC)
@@ -778,6 +843,7 @@ extern void blk_insert_request(struct request_queue *, struct request *, int, vo
 extern void blk_requeue_request(struct request_queue *, struct request *);
 extern int blk_rq_check_limits(struct request_queue *q, struct request *rq);
 extern int blk_lld_busy(struct request_queue *q);
+extern int blk_poll(struct request_queue *q, int (*done)(void *), void *data);
 extern int blk_rq_prep_clone(struct request *rq, struct request *rq_src,
 			     struct bio_set *bs, gfp_t gfp_mask,
 			     int (*bio_ctr)(struct bio *, struct bio *, void *),
@@ -953,6 +1019,7 @@ extern int blk_queue_dma_drain(struct request_queue *q,
 			       dma_drain_needed_fn *dma_drain_needed,
 			       void *buf, unsigned int size);
 extern void blk_queue_lld_busy(struct request_queue *q, lld_busy_fn *fn);
+extern void blk_queue_poll_fn(struct request_queue *q, poll_fn *fn);
 extern void blk_queue_segment_boundary(struct request_queue *, unsigned long);
 extern void blk_queue_prep_rq(struct request_queue *, prep_rq_fn *pfn);
 extern void blk_queue_merge_bvec(struct request_queue *, merge_bvec_fn *);
@@ -1003,6 +1070,7 @@ static inline struct request *blk_map_queue_find_tag(struct blk_queue_tag *bqt,
 extern int blkdev_issue_flush(struct block_device *, sector_t *);
 #define DISCARD_FL_WAIT		0x01	/* wait for completion */
 #define DISCARD_FL_BARRIER	0x02	/* issue DISCARD_BARRIER request */
+#define DISCARD_FL_SECURE	0x04	/* secure discard */
 extern int blkdev_issue_discard(struct block_device *, sector_t sector,
 		sector_t nr_sects, gfp_t, int flags);
 
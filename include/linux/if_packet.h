@@ -52,6 +52,12 @@ struct tpacket_stats {
 	unsigned int	tp_drops;
 };
 
+struct tpacket_stats_v3 {
+	unsigned int	tp_packets;
+	unsigned int	tp_drops;
+	unsigned int	tp_freeze_q_cnt;	/* times the ring was full */
+};
+
 struct tpacket_auxdata {
 	__u32		tp_status;
 	__u32		tp_len;
@@ -67,6 +73,7 @@ struct tpacket_auxdata {
 #define TP_STATUS_COPY		0x2
 #define TP_STATUS_LOSING	0x4
 #define TP_STATUS_CSUMNOTREADY	0x8
+#define TP_STATUS_BLK_TMO	0x20	/* V3 block retired by timeout */
 
 /* Tx ring - header status */
 #define TP_STATUS_AVAILABLE	0x0
@@ -101,9 +108,67 @@ struct tpacket2_hdr {
 
 #define TPACKET2_HDRLEN		(TPACKET_ALIGN(sizeof(struct tpacket2_hdr)) + sizeof(struct sockaddr_ll))
 
+struct tpacket_hdr_variant1 {
+	__u32		tp_rxhash;	/* reserved, 0 */
+	__u32		tp_vlan_tci;
+};
+
+struct tpacket3_hdr {
+	__u32		tp_next_offset;	/* to the next packet of the block, 0 if last */
+	__u32		tp_sec;
+	__u32		tp_nsec;
+	__u32		tp_snaplen;
+	__u32		tp_len;
+	__u32		tp_status;
+	__u16		tp_mac;
+	__u16		tp_net;
+	/* pkt_hdr variants */
+	union {
+		struct tpacket_hdr_variant1 hv1;
+	};
+};
+
+#define TPACKET3_HDRLEN		(TPACKET_ALIGN(sizeof(struct tpacket3_hdr)) + sizeof(struct sockaddr_ll))
+
+struct tpacket_bd_ts {
+	unsigned int	ts_sec;
+	union {
+		unsigned int	ts_usec;
+		unsigned int	ts_nsec;
+	};
+};
+
+struct tpacket_hdr_v1 {
+	__u32		block_status;
+	__u32		num_pkts;
+	__u32		offset_to_first_pkt;
+
+	/* Bytes of the block used, headers and private area included */
+	__u32		blk_len;
+
+	/* Sequence number of the block, counting from 1.  Lets user space
+	 * see whether it missed a wrap of the ring. */
+	__u64		seq_num __attribute__((aligned(8)));
+
+	/* Time of the first and last packet of the block, or of the
+	 * retirement if the block timed out empty */
+	struct tpacket_bd_ts	ts_first_pkt, ts_last_pkt;
+};
+
+union tpacket_bd_header_u {
+	struct tpacket_hdr_v1 bh1;
+};
+
+struct tpacket_block_desc {
+	__u32		version;
+	__u32		offset_to_priv;
+	union tpacket_bd_header_u hdr;
+};
+
 enum tpacket_versions {
 	TPACKET_V1,
 	TPACKET_V2,
+	TPACKET_V3,
 };
 
 /*
@@ -117,6 +182,21 @@ enum tpacket_versions {
    - Start+tp_mac: [ Optional MAC header ]
    - Start+tp_net: Packet data, aligned to TPACKET_ALIGNMENT=16.
    - Pad to align to TPACKET_ALIGNMENT=16
+
+   With TPACKET_V3 each block of the ring is handed to user space as a
+   whole, with the kernel packing packets into it back to back:
+
+   - Start. struct tpacket_block_desc
+   - Start+offset_to_priv: private area of tp_sizeof_priv bytes, unused
+     by the kernel
+   - Start+offset_to_first_pkt: the first frame, laid out as above with
+     struct tpacket3_hdr, and padded to 8 bytes; tp_next_offset leads to
+     the next one
+
+   A block is passed to user space, by setting TP_STATUS_USER in its
+   block_status, when the next packet does not fit, or when the block
+   retire timeout expires with packets in it.  User space gives it back
+   by writing TP_STATUS_KERNEL.
  */
 
 struct tpacket_req {
@@ -126,6 +206,21 @@ struct tpacket_req {
 	unsigned int	tp_frame_nr;	/* Total number of frames */
 };
 
+struct tpacket_req3 {
+	unsigned int	tp_block_size;	/* Minimal size of contiguous block */
+	unsigned int	tp_block_nr;	/* Number of blocks */
+	unsigned int	tp_frame_size;	/* Largest frame */
+	unsigned int	tp_frame_nr;	/* Total number of frames */
+	unsigned int	tp_retire_blk_tov; /* Block retire timeout in msecs */
+	unsigned int	tp_sizeof_priv;	/* Private area per block */
+	unsigned int	tp_feature_req_word; /* Reserved, 0 */
+};
+
+union tpacket_req_u {
+	struct tpacket_req	req;
+	struct tpacket_req3	req3;
+};
+
 struct packet_mreq {
 	int		mr_ifindex;
 	unsigned short	mr_type;
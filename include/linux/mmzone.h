@@ -173,6 +173,18 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* high and batch as sized for the zone, adapted from there */
+	int base_high;
+	int base_batch;
+	unsigned long adapt_stamp;	/* jiffies of the last adaptation */
+	unsigned long last_refills;	/* refills at the last adaptation */
+	unsigned long last_drains;	/* drains at the last adaptation */
+
+	unsigned long refills;	/* batches taken from the buddy lists */
+	unsigned long drains;	/* batches given back to the buddy lists */
+	unsigned long resizes;	/* adaptive changes of high and batch */
+	u64 lock_ns;		/* zone->lock hold time for the above */
 };
 
 struct per_cpu_pageset {
@@ -760,6 +772,9 @@ int min_free_kbytes_sysctl_handler(struct ctl_table *, int,
 extern int sysctl_lowmem_reserve_ratio[MAX_NR_ZONES-1];
 int lowmem_reserve_ratio_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
+extern int percpu_pagelist_adaptive;
+int percpu_pagelist_adaptive_sysctl_handler(struct ctl_table *, int,
+					void __user *, size_t *, loff_t *);
 int percpu_pagelist_fraction_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
 int sysctl_min_unmapped_ratio_sysctl_handler(struct ctl_table *, int,
@@ -0,0 +1,105 @@
+/*
+ *  linux/include/linux/net_coalesce.h
+ *
+ *  Adaptive interrupt coalescing for NAPI drivers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ */
+
+#ifndef __NET_COALESCE_H_
+#define __NET_COALESCE_H_
+
+#include <linux/types.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+
+struct net_device;
+struct ethtool_coalesce;
+
+/*
+ * Coalescing levels.  NET_COALESCE_MID uses the plain rx_coalesce_usecs
+ * and rx_max_coalesced_frames of struct ethtool_coalesce, the other two
+ * its _low and _high variants.
+ */
+enum {
+	NET_COALESCE_LOW,
+	NET_COALESCE_MID,
+	NET_COALESCE_HIGH,
+	NET_COALESCE_LEVELS,
+};
+
+/*
+ * Coalescing statistics
+ */
+struct net_coalesce_stats {
+	unsigned long samples;
+	unsigned long raised;		/* moves to a higher level */
+	unsigned long lowered;		/* moves to a lower level */
+};
+
+/*
+ * Per device coalescing state.  Drivers embed this in their private data,
+ * feed it from their NAPI poll through net_coalesce_sample() and program
+ * the hardware from @usecs and @frames in their ethtool set_coalesce().
+ */
+struct net_coalesce {
+	struct net_device *dev;
+
+	/* ethtool parameters */
+	int adaptive;
+	u32 pkt_rate_low;		/* packets per second */
+	u32 pkt_rate_high;
+	u32 level_usecs[NET_COALESCE_LEVELS];
+	u32 level_frames[NET_COALESCE_LEVELS];
+
+	/* settings the hardware should run with */
+	u32 usecs;
+	u32 frames;
+
+	/* rate sampling, only touched from the NAPI poll */
+	unsigned int level;
+	unsigned long sample_start;
+	u32 sample_packets;
+
+	struct delayed_work work;
+	struct delayed_work idle_work;	/* drops an idle device to LOW */
+	struct net_coalesce_stats stats;
+};
+
+extern void net_coalesce_init(struct net_coalesce *nc, struct net_device *dev);
+extern void net_coalesce_start(struct net_coalesce *nc);
+extern void net_coalesce_stop(struct net_coalesce *nc);
+extern void net_coalesce_get(struct net_coalesce *nc,
+			     struct ethtool_coalesce *ec);
+extern int net_coalesce_set(struct net_coalesce *nc,
+			    const struct ethtool_coalesce *ec);
+extern void __net_coalesce_update(struct net_coalesce *nc);
+
+/* Rate samples are taken over this period */
+#define NET_COALESCE_SAMPLE_JIFFIES	(HZ / 20 ? HZ / 20 : 1)
+
+/**
+ *	net_coalesce_sample - account received packets
+ *	@nc: coalescing state
+ *	@packets: packets handled by this NAPI poll
+ *
+ *	Called at the end of each NAPI poll.  Once a sample period has passed
+ *	this picks the coalescing level for the measured packet rate and, if
+ *	it changed, has the new settings applied.
+ */
+static inline void net_coalesce_sample(struct net_coalesce *nc,
+				       unsigned int packets)
+{
+	if (!nc->adaptive)
+		return;
+
+	nc->sample_packets += packets;
+	if (time_after_eq(jiffies,
+			  nc->sample_start + NET_COALESCE_SAMPLE_JIFFIES))
+		__net_coalesce_update(nc);
+}
+
+#endif
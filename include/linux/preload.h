@@ -0,0 +1,41 @@
+#ifndef _LINUX_PRELOAD_H
+#define _LINUX_PRELOAD_H
+
+/*
+ * Boot-time page cache preload, see mm/preload.c
+ */
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_PAGECACHE_PRELOAD
+
+extern int preload_recording;
+extern void __preload_record(struct file *file, pgoff_t index,
+			     unsigned long nr);
+extern void preload_boot(void);
+
+/*
+ * Note that pages [@index, @index + @nr) of @file had to be read into the
+ * page cache.  Called from the page cache miss paths.
+ */
+static inline void preload_record(struct file *file, pgoff_t index,
+				  unsigned long nr)
+{
+	if (unlikely(preload_recording) && file && nr)
+		__preload_record(file, index, nr);
+}
+
+#else
+
+static inline void preload_record(struct file *file, pgoff_t index,
+				  unsigned long nr)
+{
+}
+
+static inline void preload_boot(void)
+{
+}
+
+#endif /* CONFIG_PAGECACHE_PRELOAD */
+
+#endif /* _LINUX_PRELOAD_H */
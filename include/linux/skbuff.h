@@ -450,6 +450,43 @@ static inline struct sk_buff *alloc_skb_fclone(unsigned int size,
 
 extern int skb_recycle_check(struct sk_buff *skb, int skb_size);
 
+/*
+ * A pool of receive buffers, refilled with the skbs a driver transmitted
+ * instead of handing them back to slab.  The lists are per CPU, so a
+ * NAPI driver recycles on the CPU it polls on without any locking.
+ */
+struct skb_pool_cpu {
+	struct sk_buff_head	list;
+	unsigned long		hits;		/* allocations from the list */
+	unsigned long		misses;		/* allocations from slab */
+	unsigned long		recycled;	/* frees onto the list */
+};
+
+struct skb_pool {
+	struct skb_pool_cpu	*cpu;
+	unsigned int		skb_size;
+	unsigned int		max;
+};
+
+struct skb_pool_stats {
+	unsigned long		hits;
+	unsigned long		misses;
+	unsigned long		recycled;
+};
+
+extern int skb_pool_init(struct skb_pool *pool, unsigned int skb_size,
+			 unsigned int max);
+extern void skb_pool_destroy(struct skb_pool *pool);
+extern void skb_pool_purge(struct skb_pool *pool);
+extern void skb_pool_fill(struct skb_pool *pool, struct net_device *dev,
+			  unsigned int nr);
+extern struct sk_buff *skb_pool_alloc(struct skb_pool *pool,
+				      struct net_device *dev,
+				      unsigned int length);
+extern void skb_pool_free(struct skb_pool *pool, struct sk_buff *skb);
+extern void skb_pool_get_stats(const struct skb_pool *pool,
+			       struct skb_pool_stats *stats);
+
 extern struct sk_buff *skb_morph(struct sk_buff *dst, struct sk_buff *src);
 extern struct sk_buff *skb_clone(struct sk_buff *skb,
 				 gfp_t priority);
@@ -1737,6 +1774,8 @@ static inline void skb_frag_add_head(struct sk_buff *skb, struct sk_buff *frag)
 #define skb_walk_frags(skb, iter)	\
 	for (iter = skb_shinfo(skb)->frag_list; iter; iter = iter->next)
 
+extern int	       __skb_wait_for_more_packets(struct sock *sk, int *err,
+						   long *timeo_p);
 extern struct sk_buff *__skb_recv_datagram(struct sock *sk, unsigned flags,
 					   int *peeked, int *err);
 extern struct sk_buff *skb_recv_datagram(struct sock *sk, unsigned flags,
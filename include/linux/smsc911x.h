@@ -22,6 +22,7 @@
 #define __LINUX_SMSC911X_H__
 
 #include <linux/phy.h>
+#include <linux/dmaengine.h>
 
 /* platform_device configuration data, should be assigned to
  * the platform_device's dev.platform_data */
@@ -31,6 +32,19 @@ struct smsc911x_platform_config {
 	unsigned int flags;
 	phy_interface_t phy_interface;
 	unsigned char mac[6];
+
+	/* Optional DMA for the data FIFOs (32 bit buses only).  With
+	 * dma_filter, slave channels are requested through it, passing
+	 * dma_rx_param or dma_tx_param; they must know the FIFO address.
+	 * Otherwise, if fifo_dma_size is set, any memcpy channel is used
+	 * with fifo_dma_addr: a bus window of that many bytes in which
+	 * every access reaches the data FIFOs (FIFO_SEL asserted).  The
+	 * window must hold a whole frame. */
+	dma_filter_fn dma_filter;
+	void *dma_rx_param;
+	void *dma_tx_param;
+	dma_addr_t fifo_dma_addr;
+	unsigned int fifo_dma_size;
 };
 
 /* Constants for platform_device irq polarity configuration */
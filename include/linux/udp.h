@@ -81,6 +81,14 @@ struct udp_sock {
 	 * For encapsulation sockets.
 	 */
 	int (*encap_rcv)(struct sock *sk, struct sk_buff *skb);
+	/*
+	 * Receive side: datagrams are spliced over from sk_receive_queue in
+	 * batches and consumed from here, and the memory they free is
+	 * returned to the socket in forward_deficit sized chunks.  Both are
+	 * protected by reader_queue.lock.
+	 */
+	struct sk_buff_head reader_queue;
+	int		 forward_deficit;
 };
 
 static inline struct udp_sock *udp_sk(const struct sock *sk)
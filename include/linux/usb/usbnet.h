@@ -56,7 +56,12 @@ struct usbnet {
 	struct sk_buff_head	rxq_pause;
 	struct urb		*interrupt;
 	struct usb_anchor	deferred;
-	struct tasklet_struct	bh;
+	struct napi_struct	napi;
+
+	/* rx batching statistics, see usbnet_get_ethtool_stats() */
+	unsigned long		rx_polls;	/* NAPI polls run */
+	unsigned long		rx_poll_frames;	/* urbs completed by them */
+	unsigned long		rx_gro_merged;	/* frames merged by GRO */
 
 	struct work_struct	kevent;
 	unsigned long		flags;
@@ -213,6 +218,10 @@ extern u32 usbnet_get_msglevel (struct net_device *);
 extern void usbnet_set_msglevel (struct net_device *, u32);
 extern void usbnet_get_drvinfo (struct net_device *, struct ethtool_drvinfo *);
 extern int usbnet_nway_reset(struct net_device *net);
+extern int usbnet_get_sset_count(struct net_device *net, int sset);
+extern void usbnet_get_strings(struct net_device *net, u32 sset, u8 *data);
+extern void usbnet_get_ethtool_stats(struct net_device *net,
+		struct ethtool_stats *stats, u64 *data);
 
 /* messaging support includes the interface name, so it must not be
  * used before it has one ... notably, in minidriver bind() calls.
@@ -34,6 +34,9 @@ struct vm_struct {
 	void			*caller;
 };
 
+extern int sysctl_vmap_lazy_max_kb;
+extern int sysctl_vmap_flush_all_kb;
+
 /*
  *	Highlevel APIs for driver use
  */
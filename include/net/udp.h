@@ -171,6 +171,14 @@ extern int	udp_sendmsg(struct kiocb *iocb, struct sock *sk,
 extern void	udp_flush_pending_frames(struct sock *sk);
 
 extern int	udp_rcv(struct sk_buff *skb);
+extern int	udp_init_sock(struct sock *sk);
+extern void	udp_destruct_sock(struct sock *sk);
+extern int	__udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb);
+extern struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
+				      int *peeked, int *err);
+extern int	skb_kill_udp(struct sock *sk, struct sk_buff *skb,
+			     unsigned int flags);
+extern void	skb_free_udp(struct sock *sk, struct sk_buff *skb);
 extern int	udp_ioctl(struct sock *sk, int cmd, unsigned long arg);
 extern int	udp_disconnect(struct sock *sk, int flags);
 extern unsigned int udp_poll(struct file *file, struct socket *sock,
@@ -69,6 +69,7 @@
 #include <linux/kmemtrace.h>
 #include <linux/sfi.h>
 #include <linux/shmem_fs.h>
+#include <linux/preload.h>
 #include <trace/boot.h>
 
 #include <asm/io.h>
@@ -891,6 +892,8 @@ static int __init kernel_init(void * unused)
 		prepare_namespace();
 	}
 
+	preload_boot();
+
 	/*
 	 * Ok, we have completed the initial bootup, and
 	 * we're essentially up and running. Get rid of the
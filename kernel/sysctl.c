@@ -1125,6 +1125,15 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_fraction_sysctl_handler,
 		.extra1		= &min_percpu_pagelist_fract,
 	},
+	{
+		.procname	= "percpu_pagelist_adaptive",
+		.data		= &percpu_pagelist_adaptive,
+		.maxlen		= sizeof(percpu_pagelist_adaptive),
+		.mode		= 0644,
+		.proc_handler	= percpu_pagelist_adaptive_sysctl_handler,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 #ifdef CONFIG_MMU
 	{
 		.procname	= "max_map_count",
@@ -1134,6 +1143,22 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= proc_dointvec,
 		.extra1		= &zero,
 	},
+	{
+		.procname	= "vmap_lazy_max_kb",
+		.data		= &sysctl_vmap_lazy_max_kb,
+		.maxlen		= sizeof(sysctl_vmap_lazy_max_kb),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "vmap_flush_all_kb",
+		.data		= &sysctl_vmap_flush_all_kb,
+		.maxlen		= sizeof(sysctl_vmap_flush_all_kb),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 #else
 	{
 		.procname	= "nr_trim_pages",
@@ -161,6 +161,7 @@ static ssize_t read_ahead_kb_store(struct device *dev,
 	read_ahead_kb = simple_strtoul(buf, &end, 10);
 	if (*buf && (end[0] == '\0' || (end[0] == '\n' && end[1] == '\0'))) {
 		bdi->ra_pages = read_ahead_kb >> (PAGE_SHIFT - 10);
+		bdi->ra_learned = 0;
 		ret = count;
 	}
 	return ret;
@@ -215,12 +216,42 @@ static ssize_t max_ratio_store(struct device *dev,
 }
 BDI_SHOW(max_ratio, bdi->max_ratio)
 
+static ssize_t ra_adaptive_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	char *end;
+	unsigned long adaptive;
+	ssize_t ret = -EINVAL;
+
+	adaptive = simple_strtoul(buf, &end, 10);
+	if (*buf && (end[0] == '\0' || (end[0] == '\n' && end[1] == '\0'))) {
+		bdi->ra_adaptive = !!adaptive;
+		bdi->ra_learned = 0;
+		ret = count;
+	}
+	return ret;
+}
+BDI_SHOW(ra_adaptive, bdi->ra_adaptive)
+
+BDI_SHOW(ra_learned_kb, K(bdi_ra_pages(bdi)))
+BDI_SHOW(ra_submitted, bdi_stat_sum(bdi, BDI_RA_SUBMITTED))
+BDI_SHOW(ra_hits, bdi_stat_sum(bdi, BDI_RA_HIT))
+BDI_SHOW(ra_misses, bdi_stat_sum(bdi, BDI_RA_MISS))
+BDI_SHOW(ra_evicted, bdi_stat_sum(bdi, BDI_RA_EVICTED))
+
 #define __ATTR_RW(attr) __ATTR(attr, 0644, attr##_show, attr##_store)
 
 static struct device_attribute bdi_dev_attrs[] = {
 	__ATTR_RW(read_ahead_kb),
 	__ATTR_RW(min_ratio),
 	__ATTR_RW(max_ratio),
+	__ATTR_RW(ra_adaptive),
+	__ATTR_RO(ra_learned_kb),
+	__ATTR_RO(ra_submitted),
+	__ATTR_RO(ra_hits),
+	__ATTR_RO(ra_misses),
+	__ATTR_RO(ra_evicted),
 	__ATTR_NULL,
 };
 
@@ -652,6 +683,12 @@ int bdi_init(struct backing_dev_info *bdi)
 	bdi->min_ratio = 0;
 	bdi->max_ratio = 100;
 	bdi->max_prop_frac = PROP_FRAC_BASE;
+	bdi->ra_adaptive = 1;
+	bdi->ra_learned = 0;
+	spin_lock_init(&bdi->ra_lock);
+	bdi->ra_acc_hit = 0;
+	bdi->ra_acc_miss = 0;
+	bdi->ra_evicted_seen = 0;
 	spin_lock_init(&bdi->wb_lock);
 	INIT_RCU_HEAD(&bdi->rcu_head);
 	INIT_LIST_HEAD(&bdi->bdi_list);
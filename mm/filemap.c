@@ -34,6 +34,7 @@
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
+#include <linux/preload.h>
 #include "internal.h"
 
 /*
@@ -1158,6 +1159,7 @@ no_cached_page:
 			desc->error = error;
 			goto out;
 		}
+		preload_record(filp, index, 1);
 		goto readpage;
 	}
 
@@ -1381,10 +1383,12 @@ static int page_cache_read(struct file *file, pgoff_t offset)
 			return -ENOMEM;
 
 		ret = add_to_page_cache_lru(page, mapping, offset, GFP_KERNEL);
-		if (ret == 0)
+		if (ret == 0) {
+			preload_record(file, offset, 1);
 			ret = mapping->a_ops->readpage(file, page);
-		else if (ret == -EEXIST)
+		} else if (ret == -EEXIST) {
 			ret = 0; /* losing race to add is OK */
+		}
 
 		page_cache_release(page);
 
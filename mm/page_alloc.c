@@ -73,6 +73,7 @@ EXPORT_SYMBOL(node_states);
 unsigned long totalram_pages __read_mostly;
 unsigned long totalreserve_pages __read_mostly;
 int percpu_pagelist_fraction;
+int percpu_pagelist_adaptive = 1;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 
 #ifdef CONFIG_HUGETLB_PAGE_SIZE_VARIABLE
@@ -562,6 +563,58 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+#define PCP_ADAPT_INTERVAL	(HZ / 10)
+#define PCP_ADAPT_BURST		4	/* refills and drains per interval */
+#define PCP_ADAPT_MAX_SCALE	4	/* how far batch may grow over base */
+
+/*
+ * Resize a per-cpu pageset from how often it had to go to the buddy lists
+ * lately.  A pageset that both refilled and drained several batches within
+ * an interval is moving bursts larger than its high mark through
+ * zone->lock a batch at a time: double batch and high.  One that saw less
+ * traffic than that shrinks back towards the size set up for the zone.
+ *
+ * Called with interrupts disabled, after each refill or drain.
+ */
+static void pcp_adapt(struct per_cpu_pages *pcp)
+{
+	unsigned long elapsed = jiffies - pcp->adapt_stamp;
+	unsigned long refills, drains;
+	int batch;
+
+	if (!percpu_pagelist_adaptive || !pcp->base_high ||
+	    elapsed < PCP_ADAPT_INTERVAL)
+		return;
+
+	refills = pcp->refills - pcp->last_refills;
+	drains = pcp->drains - pcp->last_drains;
+
+	batch = pcp->batch;
+	if (refills >= PCP_ADAPT_BURST && drains >= PCP_ADAPT_BURST &&
+	    elapsed < 2 * PCP_ADAPT_INTERVAL)
+		batch = min(batch * 2, pcp->base_batch * PCP_ADAPT_MAX_SCALE);
+	else if ((refills + drains) * PCP_ADAPT_INTERVAL <
+		 PCP_ADAPT_BURST * elapsed)
+		batch = max(batch / 2, pcp->base_batch);
+
+	if (batch != pcp->batch) {
+		pcp->high = pcp->base_high * batch / pcp->base_batch;
+		pcp->batch = batch;
+		pcp->resizes++;
+	}
+
+	pcp->last_refills = pcp->refills;
+	pcp->last_drains = pcp->drains;
+	pcp->adapt_stamp = jiffies;
+}
+
+/* Back to the zone's sizing, e.g. when memory gets tight */
+static void pcp_reset(struct per_cpu_pages *pcp)
+{
+	pcp->high = pcp->base_high;
+	pcp->batch = pcp->base_batch;
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -1013,6 +1066,7 @@ static void drain_pages(unsigned int cpu)
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		pcp_reset(pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1123,8 +1177,13 @@ static void free_hot_cold_page(struct page *page, int cold)
 		list_add(&page->lru, &pcp->lists[migratetype]);
 	pcp->count++;
 	if (pcp->count >= pcp->high) {
+		u64 start = sched_clock();
+
 		free_pcppages_bulk(zone, pcp->batch, pcp);
+		pcp->lock_ns += sched_clock() - start;
 		pcp->count -= pcp->batch;
+		pcp->drains++;
+		pcp_adapt(pcp);
 	}
 
 out:
@@ -1191,9 +1250,14 @@ again:
 		list = &pcp->lists[migratetype];
 		local_irq_save(flags);
 		if (list_empty(list)) {
+			u64 start = sched_clock();
+
 			pcp->count += rmqueue_bulk(zone, 0,
 					pcp->batch, list,
 					migratetype, cold);
+			pcp->lock_ns += sched_clock() - start;
+			pcp->refills++;
+			pcp_adapt(pcp);
 			if (unlikely(list_empty(list)))
 				goto failed;
 		}
@@ -3060,6 +3124,9 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->count = 0;
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
+	pcp->base_high = pcp->high;
+	pcp->base_batch = pcp->batch;
+	pcp->adapt_stamp = jiffies;
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
 }
@@ -3079,6 +3146,8 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	pcp->base_high = pcp->high;
+	pcp->base_batch = pcp->batch;
 }
 
 
@@ -4804,6 +4873,28 @@ int percpu_pagelist_fraction_sysctl_handler(ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * percpu_pagelist_adaptive - turns resizing of the hot per cpu pagelists
+ * on and off.  Turning it off puts each pagelist back to the size set up
+ * for its zone.
+ */
+int percpu_pagelist_adaptive_sysctl_handler(ctl_table *table, int write,
+	void __user *buffer, size_t *length, loff_t *ppos)
+{
+	struct zone *zone;
+	unsigned int cpu;
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || ret < 0 || percpu_pagelist_adaptive)
+		return ret;
+	for_each_populated_zone(zone) {
+		for_each_online_cpu(cpu)
+			pcp_reset(&zone_pcp(zone, cpu)->pcp);
+	}
+	return 0;
+}
+
 int hashdist = HASHDIST_DEFAULT;
 
 #ifdef CONFIG_NUMA
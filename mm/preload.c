@@ -0,0 +1,645 @@
+/*
+ * mm/preload.c - boot-time page cache preload.
+ *
+ * Cold boot spends much of its time faulting binaries and libraries into
+ * the page cache a few pages at a time.  This records which ranges of
+ * which files had to be read during a boot, and replays that record on
+ * later boots as large, sorted readahead requests issued before userspace
+ * gets to ask for the data.
+ *
+ * Recording is enabled with "preload_record=<seconds>".  For that many
+ * seconds after the page cache comes up, every range read in by the miss
+ * paths in mm/filemap.c and mm/readahead.c is logged against its file.
+ * When the window closes, the ranges of each file are sorted and merged
+ * and the result is made available as a compact binary trace in
+ * /proc/preload_trace, to be saved by userspace.
+ *
+ * Replay is enabled with "preload=<path to saved trace>".  Right after
+ * the root filesystem is mounted a kernel thread reads the trace and
+ * issues readahead for every range, file by file in the order the files
+ * were first touched.  After "preload_check=<seconds>" (60 by default)
+ * it walks the ranges again and counts how many of the preloaded pages
+ * were used, left unused, or already reclaimed.
+ *
+ * Statistics of both phases are in /proc/preload_stats.  Recording and
+ * replay exclude each other: pages brought in by a replay would never
+ * miss, and so would be missing from the new trace.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/mount.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/hash.h>
+#include <linux/sort.h>
+#include <linux/kthread.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/delay.h>
+#include <linux/preload.h>
+
+#define PRELOAD_MAGIC		0x504c4431	/* "PLD1" */
+#define PRELOAD_MAX_FILES	4096
+#define PRELOAD_MAX_RANGES	65536
+#define PRELOAD_MAX_TRACE	(4 << 20)
+#define PRELOAD_MERGE_GAP	4		/* pages */
+#define PRELOAD_HASH_BITS	8
+
+/*
+ * On-disk trace layout, in native byte order:
+ *
+ *	struct preload_trace_header
+ *	nr_files times:
+ *		struct preload_trace_file
+ *		path, NUL terminated, padded to 4 bytes
+ *		nr_ranges times struct preload_trace_range
+ */
+struct preload_trace_header {
+	u32 magic;
+	u32 page_shift;
+	u32 nr_files;
+	u32 nr_ranges;
+};
+
+struct preload_trace_file {
+	u32 nr_ranges;
+	u32 path_len;		/* including the NUL */
+};
+
+struct preload_trace_range {
+	u32 start;
+	u32 nr;
+};
+
+struct preload_file {
+	struct list_head list;		/* in first access order */
+	struct hlist_node hash;
+	dev_t dev;
+	unsigned long ino;
+	char *path;
+	unsigned int nr_ranges;
+	unsigned int max_ranges;
+	struct preload_trace_range *ranges;
+};
+
+int preload_recording __read_mostly;
+
+static DEFINE_MUTEX(preload_mutex);
+static LIST_HEAD(preload_files);
+static struct hlist_head preload_hash[1 << PRELOAD_HASH_BITS];
+static unsigned int preload_seconds;
+static char *preload_path;
+static unsigned int preload_check = 60;
+
+static void *preload_trace;		/* trace built at end of recording */
+static size_t preload_trace_len;
+
+static struct {
+	unsigned long rec_files;
+	unsigned long rec_ranges;
+	unsigned long rec_pages;
+	unsigned long rec_dropped;
+	unsigned long files;
+	unsigned long files_missing;
+	unsigned long ranges;
+	unsigned long pages_issued;
+	unsigned long pages_used;
+	unsigned long pages_unused;
+	unsigned long pages_evicted;
+	unsigned long usecs;
+} preload_stats;
+
+static int __init preload_record_setup(char *str)
+{
+	preload_seconds = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+__setup("preload_record=", preload_record_setup);
+
+static int __init preload_setup(char *str)
+{
+	preload_path = str;
+	return 1;
+}
+__setup("preload=", preload_setup);
+
+static int __init preload_check_setup(char *str)
+{
+	preload_check = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+__setup("preload_check=", preload_check_setup);
+
+static struct hlist_head *preload_hash_head(dev_t dev, unsigned long ino)
+{
+	return &preload_hash[hash_long(ino ^ dev, PRELOAD_HASH_BITS)];
+}
+
+static struct preload_file *preload_find(struct inode *inode)
+{
+	struct preload_file *pf;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(pf, node,
+			preload_hash_head(inode->i_sb->s_dev, inode->i_ino), hash)
+		if (pf->dev == inode->i_sb->s_dev && pf->ino == inode->i_ino)
+			return pf;
+	return NULL;
+}
+
+static struct preload_file *preload_add_file(struct file *file)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct preload_file *pf;
+	char *buf, *path;
+
+	if (preload_stats.rec_files >= PRELOAD_MAX_FILES)
+		return NULL;
+
+	buf = kmalloc(PATH_MAX, GFP_NOFS);
+	if (!buf)
+		return NULL;
+	path = d_path(&file->f_path, buf, PATH_MAX);
+	if (IS_ERR(path))
+		goto out;
+
+	pf = kzalloc(sizeof(*pf), GFP_NOFS);
+	if (!pf)
+		goto out;
+	pf->path = kstrdup(path, GFP_NOFS);
+	if (!pf->path) {
+		kfree(pf);
+		goto out;
+	}
+	pf->dev = inode->i_sb->s_dev;
+	pf->ino = inode->i_ino;
+	list_add_tail(&pf->list, &preload_files);
+	hlist_add_head(&pf->hash, preload_hash_head(pf->dev, pf->ino));
+	preload_stats.rec_files++;
+	kfree(buf);
+	return pf;
+out:
+	kfree(buf);
+	return NULL;
+}
+
+static void preload_add_range(struct preload_file *pf, pgoff_t index,
+			      unsigned long nr)
+{
+	struct preload_trace_range *r;
+
+	/* The trace holds 32-bit page offsets */
+	if ((u64)index + nr > 0xffffffffULL)
+		return;
+
+	if (pf->nr_ranges) {
+		r = &pf->ranges[pf->nr_ranges - 1];
+		if (index >= r->start &&
+		    index <= r->start + r->nr + PRELOAD_MERGE_GAP) {
+			if (index + nr > r->start + r->nr) {
+				preload_stats.rec_pages +=
+					index + nr - (r->start + r->nr);
+				r->nr = index + nr - r->start;
+			}
+			return;
+		}
+	}
+
+	if (preload_stats.rec_ranges >= PRELOAD_MAX_RANGES) {
+		preload_stats.rec_dropped++;
+		return;
+	}
+
+	if (pf->nr_ranges == pf->max_ranges) {
+		unsigned int max = pf->max_ranges ? pf->max_ranges * 2 : 8;
+
+		r = krealloc(pf->ranges, max * sizeof(*r), GFP_NOFS);
+		if (!r) {
+			preload_stats.rec_dropped++;
+			return;
+		}
+		pf->ranges = r;
+		pf->max_ranges = max;
+	}
+
+	r = &pf->ranges[pf->nr_ranges++];
+	r->start = index;
+	r->nr = nr;
+	preload_stats.rec_ranges++;
+	preload_stats.rec_pages += nr;
+}
+
+void __preload_record(struct file *file, pgoff_t index, unsigned long nr)
+{
+	struct preload_file *pf;
+
+	mutex_lock(&preload_mutex);
+	if (!preload_recording)
+		goto out;
+
+	pf = preload_find(file->f_mapping->host);
+	if (!pf)
+		pf = preload_add_file(file);
+	if (pf)
+		preload_add_range(pf, index, nr);
+out:
+	mutex_unlock(&preload_mutex);
+}
+
+static int preload_range_cmp(const void *a, const void *b)
+{
+	const struct preload_trace_range *ra = a, *rb = b;
+
+	if (ra->start < rb->start)
+		return -1;
+	return ra->start > rb->start;
+}
+
+/*
+ * Sort the ranges of a file by offset and merge those that overlap or
+ * are separated by no more than PRELOAD_MERGE_GAP pages.
+ */
+static unsigned int preload_merge_ranges(struct preload_trace_range *ranges,
+					 unsigned int nr_ranges)
+{
+	unsigned int i, n = 0;
+
+	if (!nr_ranges)
+		return 0;
+
+	sort(ranges, nr_ranges, sizeof(*ranges), preload_range_cmp, NULL);
+	for (i = 1; i < nr_ranges; i++) {
+		struct preload_trace_range *last = &ranges[n];
+		u64 end = (u64)last->start + last->nr;
+
+		if (ranges[i].start <= end + PRELOAD_MERGE_GAP) {
+			if ((u64)ranges[i].start + ranges[i].nr > end)
+				last->nr = ranges[i].start + ranges[i].nr -
+					   last->start;
+		} else {
+			ranges[++n] = ranges[i];
+		}
+	}
+	return n + 1;
+}
+
+/*
+ * Close the recording window: merge what was recorded into a trace and
+ * drop the per-file state.
+ */
+static void preload_stop(struct work_struct *work)
+{
+	struct preload_trace_header *hdr;
+	struct preload_file *pf, *next;
+	size_t len = sizeof(*hdr);
+	void *p;
+
+	mutex_lock(&preload_mutex);
+	preload_recording = 0;
+
+	list_for_each_entry(pf, &preload_files, list) {
+		pf->nr_ranges = preload_merge_ranges(pf->ranges,
+						     pf->nr_ranges);
+		len += sizeof(struct preload_trace_file) +
+		       ALIGN(strlen(pf->path) + 1, 4) +
+		       pf->nr_ranges * sizeof(struct preload_trace_range);
+	}
+
+	p = hdr = vmalloc(len);
+	if (!hdr) {
+		printk(KERN_WARNING "preload: no memory for %zu byte trace\n",
+		       len);
+		goto free;
+	}
+	memset(hdr, 0, len);
+	hdr->magic = PRELOAD_MAGIC;
+	hdr->page_shift = PAGE_CACHE_SHIFT;
+	p += sizeof(*hdr);
+
+	list_for_each_entry(pf, &preload_files, list) {
+		struct preload_trace_file *tf = p;
+		size_t size;
+
+		if (!pf->nr_ranges)
+			continue;
+		tf->nr_ranges = pf->nr_ranges;
+		tf->path_len = strlen(pf->path) + 1;
+		p += sizeof(*tf);
+		memcpy(p, pf->path, tf->path_len);
+		p += ALIGN(tf->path_len, 4);
+		size = pf->nr_ranges * sizeof(struct preload_trace_range);
+		memcpy(p, pf->ranges, size);
+		p += size;
+
+		hdr->nr_files++;
+		hdr->nr_ranges += pf->nr_ranges;
+	}
+
+	preload_trace = hdr;
+	preload_trace_len = p - (void *)hdr;
+	printk(KERN_INFO "preload: recorded %u ranges in %u files\n",
+	       hdr->nr_ranges, hdr->nr_files);
+free:
+	list_for_each_entry_safe(pf, next, &preload_files, list) {
+		list_del(&pf->list);
+		hlist_del(&pf->hash);
+		kfree(pf->ranges);
+		kfree(pf->path);
+		kfree(pf);
+	}
+	mutex_unlock(&preload_mutex);
+}
+
+static DECLARE_DELAYED_WORK(preload_stop_work, preload_stop);
+
+static void *preload_read_trace(const char *path, size_t *lenp)
+{
+	struct preload_trace_header *hdr;
+	struct file *file;
+	loff_t size;
+	void *buf = NULL;
+	int ret;
+
+	file = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file)) {
+		printk(KERN_WARNING "preload: cannot open %s (%ld)\n",
+		       path, PTR_ERR(file));
+		return NULL;
+	}
+
+	size = i_size_read(file->f_mapping->host);
+	if (size < sizeof(*hdr) || size > PRELOAD_MAX_TRACE)
+		goto bad;
+
+	buf = vmalloc(size);
+	if (!buf)
+		goto out;
+	ret = kernel_read(file, 0, buf, size);
+	if (ret != size)
+		goto bad;
+
+	hdr = buf;
+	if (hdr->magic != PRELOAD_MAGIC ||
+	    hdr->page_shift != PAGE_CACHE_SHIFT ||
+	    hdr->nr_files > PRELOAD_MAX_FILES)
+		goto bad;
+
+	*lenp = size;
+	goto out;
+bad:
+	printk(KERN_WARNING "preload: %s is not a valid trace\n", path);
+	vfree(buf);
+	buf = NULL;
+out:
+	filp_close(file, NULL);
+	return buf;
+}
+
+/*
+ * Walk the trace, calling @fn for each file entry that fits in the buffer.
+ * Returns the number of well-formed entries.
+ */
+static unsigned int preload_walk(void *buf, size_t len,
+		void (*fn)(struct preload_trace_file *, char *,
+			   struct preload_trace_range *, void *),
+		void *data)
+{
+	struct preload_trace_header *hdr = buf;
+	void *p = buf + sizeof(*hdr), *end = buf + len;
+	unsigned int i;
+
+	for (i = 0; i < hdr->nr_files; i++) {
+		struct preload_trace_file *tf = p;
+		char *path;
+		size_t size;
+
+		if (end - p < sizeof(*tf) || !tf->path_len ||
+		    tf->path_len > PATH_MAX)
+			break;
+		size = sizeof(*tf) + ALIGN(tf->path_len, 4) +
+		       (size_t)tf->nr_ranges *
+		       sizeof(struct preload_trace_range);
+		if (tf->nr_ranges > PRELOAD_MAX_RANGES || end - p < size)
+			break;
+		path = p + sizeof(*tf);
+		if (path[tf->path_len - 1] != '\0')
+			break;
+
+		fn(tf, path, (void *)path + ALIGN(tf->path_len, 4), data);
+		p += size;
+	}
+	return i;
+}
+
+struct preload_open {
+	struct file **files;
+	unsigned int nr;
+};
+
+static void preload_issue(struct preload_trace_file *tf, char *path,
+			  struct preload_trace_range *ranges, void *data)
+{
+	struct preload_open *open = data;
+	struct file *file;
+	unsigned int i, n;
+
+	file = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file)) {
+		open->files[open->nr++] = NULL;
+		preload_stats.files_missing++;
+		return;
+	}
+	open->files[open->nr++] = file;
+	preload_stats.files++;
+
+	/*
+	 * Traces come out of preload_stop() sorted and merged, but they may
+	 * have been edited since.  Ranges merged away are left empty so the
+	 * layout of the trace does not change.
+	 */
+	n = preload_merge_ranges(ranges, tf->nr_ranges);
+	for (i = n; i < tf->nr_ranges; i++)
+		ranges[i].nr = 0;
+
+	for (i = 0; i < n; i++) {
+		int ret;
+
+		ret = force_page_cache_readahead(file->f_mapping, file,
+						 ranges[i].start, ranges[i].nr);
+		if (ret > 0)
+			preload_stats.pages_issued += ret;
+		preload_stats.ranges++;
+	}
+}
+
+/*
+ * A preloaded page counts as used if it has been read or mapped since;
+ * both mark_page_accessed() and a mapping take it off the plain inactive,
+ * unreferenced state readahead left it in.
+ */
+static void preload_account(struct preload_trace_file *tf, char *path,
+			    struct preload_trace_range *ranges, void *data)
+{
+	struct preload_open *open = data;
+	struct file *file = open->files[open->nr++];
+	unsigned int i;
+	pgoff_t index;
+
+	if (!file)
+		return;
+
+	for (i = 0; i < tf->nr_ranges; i++) {
+		for (index = ranges[i].start;
+		     index < (pgoff_t)ranges[i].start + ranges[i].nr; index++) {
+			struct page *page;
+
+			page = find_get_page(file->f_mapping, index);
+			if (!page) {
+				preload_stats.pages_evicted++;
+				continue;
+			}
+			if (PageReferenced(page) || PageActive(page) ||
+			    page_mapped(page))
+				preload_stats.pages_used++;
+			else
+				preload_stats.pages_unused++;
+			page_cache_release(page);
+		}
+		cond_resched();
+	}
+	filp_close(file, NULL);
+}
+
+static int preload_thread(void *unused)
+{
+	struct preload_trace_header *hdr;
+	struct preload_open open;
+	struct timeval start, end;
+	size_t len;
+	void *buf;
+
+	buf = preload_read_trace(preload_path, &len);
+	if (!buf)
+		return 0;
+	hdr = buf;
+
+	open.files = vmalloc(hdr->nr_files * sizeof(struct file *));
+	if (!open.files)
+		goto out;
+
+	do_gettimeofday(&start);
+	open.nr = 0;
+	preload_walk(buf, len, preload_issue, &open);
+	do_gettimeofday(&end);
+	preload_stats.usecs = (end.tv_sec - start.tv_sec) * USEC_PER_SEC +
+			      end.tv_usec - start.tv_usec;
+	printk(KERN_INFO "preload: issued %lu pages in %lu files\n",
+	       preload_stats.pages_issued, preload_stats.files);
+
+	ssleep(preload_check);
+
+	open.nr = 0;
+	preload_walk(buf, len, preload_account, &open);
+	vfree(open.files);
+out:
+	vfree(buf);
+	return 0;
+}
+
+/*
+ * Called from init once the root filesystem is mounted.
+ */
+void preload_boot(void)
+{
+	struct task_struct *tsk;
+
+	if (!preload_path)
+		return;
+
+	tsk = kthread_run(preload_thread, NULL, "kpreload");
+	if (IS_ERR(tsk))
+		printk(KERN_WARNING "preload: cannot start thread\n");
+}
+
+static ssize_t preload_trace_read(struct file *file, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&preload_mutex);
+	ret = simple_read_from_buffer(buf, count, ppos, preload_trace,
+				      preload_trace_len);
+	mutex_unlock(&preload_mutex);
+	return ret;
+}
+
+static const struct file_operations preload_trace_fops = {
+	.read		= preload_trace_read,
+};
+
+static int preload_stats_show(struct seq_file *m, void *v)
+{
+	seq_printf(m,
+		   "recording:       %8d\n"
+		   "rec_files:       %8lu\n"
+		   "rec_ranges:      %8lu\n"
+		   "rec_pages:       %8lu\n"
+		   "rec_dropped:     %8lu\n"
+		   "trace_bytes:     %8zu\n"
+		   "files:           %8lu\n"
+		   "files_missing:   %8lu\n"
+		   "ranges:          %8lu\n"
+		   "pages_issued:    %8lu\n"
+		   "pages_used:      %8lu\n"
+		   "pages_unused:    %8lu\n"
+		   "pages_evicted:   %8lu\n"
+		   "issue_usecs:     %8lu\n",
+		   preload_recording,
+		   preload_stats.rec_files, preload_stats.rec_ranges,
+		   preload_stats.rec_pages, preload_stats.rec_dropped,
+		   preload_trace_len,
+		   preload_stats.files, preload_stats.files_missing,
+		   preload_stats.ranges, preload_stats.pages_issued,
+		   preload_stats.pages_used, preload_stats.pages_unused,
+		   preload_stats.pages_evicted, preload_stats.usecs);
+	return 0;
+}
+
+static int preload_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, preload_stats_show, NULL);
+}
+
+static const struct file_operations preload_stats_fops = {
+	.open		= preload_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init preload_init(void)
+{
+	proc_create("preload_trace", S_IRUSR, NULL, &preload_trace_fops);
+	proc_create("preload_stats", S_IRUGO, NULL, &preload_stats_fops);
+
+	if (!preload_seconds)
+		return 0;
+	if (preload_path) {
+		printk(KERN_WARNING
+		       "preload: not recording while replaying a trace\n");
+		return 0;
+	}
+
+	preload_recording = 1;
+	schedule_delayed_work(&preload_stop_work, preload_seconds * HZ);
+	return 0;
+}
+core_initcall(preload_init);
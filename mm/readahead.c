@@ -16,6 +16,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/preload.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -24,7 +25,7 @@
 void
 file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
-	ra->ra_pages = mapping->backing_dev_info->ra_pages;
+	ra->ra_pages = bdi_ra_pages(mapping->backing_dev_info);
 	ra->prev_pos = -1;
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
@@ -148,6 +149,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	struct inode *inode = mapping->host;
 	struct page *page;
 	unsigned long end_index;	/* The last page we want to read */
+	pgoff_t first = 0, last = 0;	/* span of the pages we allocate */
 	LIST_HEAD(page_pool);
 	int page_idx;
 	int ret = 0;
@@ -180,6 +182,9 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
+		if (!ret)
+			first = page_offset;
+		last = page_offset;
 		ret++;
 	}
 
@@ -188,8 +193,10 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
+		preload_record(filp, first, last - first + 1);
 		read_pages(mapping, filp, &page_pool, ret);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -248,6 +255,9 @@ unsigned long ra_submit(struct file_ra_state *ra,
 
 	actual = __do_page_cache_readahead(mapping, filp,
 					ra->start, ra->size, ra->async_size);
+	if (actual > 0)
+		add_bdi_stat(mapping->backing_dev_info,
+			     BDI_RA_SUBMITTED, actual);
 
 	return actual;
 }
@@ -348,6 +358,152 @@ static pgoff_t count_history_pages(struct address_space *mapping,
 	return offset - 1 - head;
 }
 
+/*
+ * Readahead window learning.
+ *
+ * A readahead stream is accounted as the reader walks through it.  Every
+ * time the reader reaches the readahead marker of a window, the pages
+ * between the previous accounting point (ra->acct) and the reader were read
+ * ahead and then used.  When the stream is given up, i.e. its window gets
+ * replaced by a fresh one, whatever lies between the reader's last position
+ * and the end of the old window was read for nothing: either the reader
+ * went elsewhere, or the pages were reclaimed before it got to them.
+ *
+ * Each file shrinks its own maximum window when a stream wasted more than
+ * it used, and grows it while streams keep running into that maximum.  The
+ * backing device keeps a learned window that seeds new files: it is moved
+ * by the waste ratio seen over RA_LEARN_PERIOD windows, and backs off
+ * whenever reclaim threw away readahead markers that were never reached.
+ * The learned window stays within twice the configured ra_pages, which is
+ * also what POSIX_FADV_SEQUENTIAL grants.
+ */
+#define RA_LEARN_PERIOD		16
+
+static unsigned long ra_min_pages(void)
+{
+	return max_t(unsigned long, VM_MIN_READAHEAD * 1024 / PAGE_CACHE_SIZE, 1);
+}
+
+/**
+ * bdi_ra_pages - initial readahead window for files on a device
+ * @bdi: the backing device
+ *
+ * Returns the learned readahead window of @bdi if window learning is
+ * enabled and has settled on one, and the configured ra_pages otherwise.
+ */
+unsigned long bdi_ra_pages(struct backing_dev_info *bdi)
+{
+	unsigned long learned = bdi->ra_learned;
+
+	if (!bdi->ra_adaptive || !learned || !bdi->ra_pages)
+		return bdi->ra_pages;
+
+	return min(learned, 2 * bdi->ra_pages);
+}
+EXPORT_SYMBOL_GPL(bdi_ra_pages);
+
+static void bdi_ra_feedback(struct backing_dev_info *bdi,
+			    unsigned long hit, unsigned long miss)
+{
+	unsigned long window, total;
+	s64 evicted;
+
+	if (hit)
+		add_bdi_stat(bdi, BDI_RA_HIT, hit);
+	if (miss)
+		add_bdi_stat(bdi, BDI_RA_MISS, miss);
+
+	if (!bdi->ra_adaptive || !bdi->ra_pages)
+		return;
+
+	spin_lock(&bdi->ra_lock);
+	bdi->ra_acc_hit += hit;
+	bdi->ra_acc_miss += miss;
+	window = bdi_ra_pages(bdi);
+	total = bdi->ra_acc_hit + bdi->ra_acc_miss;
+	if (total < RA_LEARN_PERIOD * window)
+		goto out;
+
+	/*
+	 * More than 1/8 wasted, or markers thrashed: back off by a quarter.
+	 * Less than 1/32 wasted: the window can safely grow by a quarter.
+	 */
+	evicted = bdi_stat(bdi, BDI_RA_EVICTED);
+	if (evicted != bdi->ra_evicted_seen || bdi->ra_acc_miss * 8 > total)
+		window -= window / 4;
+	else if (bdi->ra_acc_miss * 32 < total)
+		window += max(window / 4, 1UL);
+
+	bdi->ra_learned = clamp_t(unsigned long, window,
+				  ra_min_pages(), 2 * bdi->ra_pages);
+	bdi->ra_evicted_seen = evicted;
+	bdi->ra_acc_hit = 0;
+	bdi->ra_acc_miss = 0;
+out:
+	spin_unlock(&bdi->ra_lock);
+}
+
+/*
+ * The reader has reached @offset while following the current stream:
+ * everything read ahead before it has been used.
+ */
+static void ra_account_hit(struct address_space *mapping,
+			   struct file_ra_state *ra, pgoff_t offset,
+			   unsigned long max)
+{
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
+
+	if (offset > ra->acct && offset - ra->acct <= max)
+		bdi_ra_feedback(bdi, offset - ra->acct, 0);
+	ra->acct = offset;
+
+	/*
+	 * The stream keeps hitting the ceiling of this file's window,
+	 * let it grow.
+	 */
+	if (bdi->ra_adaptive && ra->size >= max &&
+	    ra->ra_pages < 2 * bdi->ra_pages)
+		ra->ra_pages = min_t(unsigned long,
+				     ra->ra_pages + max(ra->ra_pages / 4, 1U),
+				     2 * bdi->ra_pages);
+}
+
+/*
+ * The current stream is about to be replaced by a new one: account what
+ * the reader used of it and what it left behind.
+ */
+static void ra_account_miss(struct address_space *mapping,
+			    struct file_ra_state *ra, unsigned long max)
+{
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
+	loff_t isize = i_size_read(mapping->host);
+	pgoff_t end = ra->start + ra->size;
+	pgoff_t next;
+	unsigned long hit, miss;
+
+	if (!ra->size || !isize)
+		return;
+
+	end = min_t(pgoff_t, end, ((isize - 1) >> PAGE_CACHE_SHIFT) + 1);
+	if (ra->acct >= end || end - ra->acct > 2 * max)
+		return;
+
+	next = ra->acct;
+	if (ra->prev_pos != -1)
+		next = max_t(pgoff_t, next,
+			     (ra->prev_pos >> PAGE_CACHE_SHIFT) + 1);
+	next = min(next, end);
+
+	hit = next - ra->acct;
+	miss = end - next;
+	bdi_ra_feedback(bdi, hit, miss);
+	ra->acct = end;
+
+	if (bdi->ra_adaptive && miss > hit)
+		ra->ra_pages = max_t(unsigned long, ra->ra_pages / 2,
+				     ra_min_pages());
+}
+
 /*
  * page cache context based read-ahead
  */
@@ -375,6 +531,8 @@ static int try_context_readahead(struct address_space *mapping,
 	if (size >= offset)
 		size *= 2;
 
+	ra_account_miss(mapping, ra, max);
+	ra->acct = offset + req_size;
 	ra->start = offset;
 	ra->size = get_init_ra_size(size + req_size, max);
 	ra->async_size = ra->size;
@@ -405,6 +563,7 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
+		ra_account_hit(mapping, ra, offset, max);
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -427,6 +586,7 @@ ondemand_readahead(struct address_space *mapping,
 		if (!start || start - offset > max)
 			return 0;
 
+		ra->acct = offset;
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
@@ -461,6 +621,8 @@ ondemand_readahead(struct address_space *mapping,
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
+	ra_account_miss(mapping, ra, max);
+	ra->acct = offset + req_size;
 	ra->start = offset;
 	ra->size = get_init_ra_size(req_size, max);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
@@ -0,0 +1,110 @@
+/*
+ * mm/slab-bulk-bench.c
+ *
+ * Compare kmem_cache_alloc_bulk()/kmem_cache_free_bulk() against loops of
+ * kmem_cache_alloc()/kmem_cache_free() for a range of object and batch
+ * sizes.  Results are reported in cycles per object when the module is
+ * loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/timex.h>
+
+#define MAX_BATCH	256
+
+static unsigned int loops = 10000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Number of alloc/free rounds per measurement");
+
+static const size_t obj_sizes[] = { 64, 256, 1024 };
+static const size_t batches[] = { 1, 8, 16, 32, 64, 128, MAX_BATCH };
+
+static void *objs[MAX_BATCH];
+
+static unsigned long bench_loop(struct kmem_cache *cache, size_t batch)
+{
+	cycles_t start, end;
+	unsigned int n;
+	size_t i;
+
+	start = get_cycles();
+	for (n = 0; n < loops; n++) {
+		for (i = 0; i < batch; i++) {
+			objs[i] = kmem_cache_alloc(cache, GFP_KERNEL);
+			if (!objs[i])
+				break;
+		}
+		while (i--)
+			kmem_cache_free(cache, objs[i]);
+	}
+	end = get_cycles();
+
+	return (unsigned long)(end - start) / (loops * batch);
+}
+
+static unsigned long bench_bulk(struct kmem_cache *cache, size_t batch)
+{
+	cycles_t start, end;
+	unsigned int n;
+
+	start = get_cycles();
+	for (n = 0; n < loops; n++) {
+		if (!kmem_cache_alloc_bulk(cache, GFP_KERNEL, batch, objs))
+			continue;
+		kmem_cache_free_bulk(cache, batch, objs);
+	}
+	end = get_cycles();
+
+	return (unsigned long)(end - start) / (loops * batch);
+}
+
+static int __init slab_bulk_bench_init(void)
+{
+	struct kmem_cache *cache;
+	unsigned int s, b;
+
+	if (!loops)
+		return -EINVAL;
+
+	printk(KERN_INFO "slab-bulk-bench: cycles per object, %u rounds\n",
+	       loops);
+	printk(KERN_INFO "slab-bulk-bench:  size batch     loop     bulk\n");
+
+	for (s = 0; s < ARRAY_SIZE(obj_sizes); s++) {
+		cache = kmem_cache_create("slab_bulk_bench", obj_sizes[s], 0,
+					  0, NULL);
+		if (!cache)
+			return -ENOMEM;
+
+		for (b = 0; b < ARRAY_SIZE(batches); b++) {
+			unsigned long loop, bulk;
+
+			loop = bench_loop(cache, batches[b]);
+			bulk = bench_bulk(cache, batches[b]);
+			printk(KERN_INFO "slab-bulk-bench: %5zu %5zu %8lu %8lu\n",
+			       obj_sizes[s], batches[b], loop, bulk);
+			cond_resched();
+		}
+		kmem_cache_destroy(cache);
+	}
+
+	return 0;
+}
+module_init(slab_bulk_bench_init);
+
+static void __exit slab_bulk_bench_exit(void)
+{
+}
+module_exit(slab_bulk_bench_exit);
+
+MODULE_DESCRIPTION("Slab bulk allocation benchmark");
+MODULE_LICENSE("GPL");
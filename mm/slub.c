@@ -1754,6 +1754,69 @@ void *kmem_cache_alloc(struct kmem_cache *s, gfp_t gfpflags)
 }
 EXPORT_SYMBOL(kmem_cache_alloc);
 
+/**
+ * kmem_cache_alloc_bulk - allocate an array of objects
+ * @s: the cache to allocate from
+ * @flags: GFP flags, as for kmem_cache_alloc()
+ * @size: number of objects to allocate
+ * @p: array to store the objects in
+ *
+ * The lockless freelist of the cpu slab is drained with interrupts
+ * disabled only once for the whole array; the slow path is taken
+ * whenever it runs dry.  Returns @size, or 0 if not all objects could be
+ * allocated, in which case none are.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
+	size_t i, j;
+
+	flags &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(flags);
+	might_sleep_if(flags & __GFP_WAIT);
+
+	if (should_failslab(s->objsize, flags))
+		return 0;
+
+	local_irq_save(irqflags);
+	c = get_cpu_slab(s, smp_processor_id());
+	for (i = 0; i < size; i++) {
+		void **object = c->freelist;
+
+		if (unlikely(!object)) {
+			object = __slab_alloc(s, flags, -1, _RET_IP_, c);
+			if (unlikely(!object))
+				break;
+			/* we may have slept and moved to another cpu */
+			c = get_cpu_slab(s, smp_processor_id());
+		} else {
+			c->freelist = object[c->offset];
+			stat(c, ALLOC_FASTPATH);
+		}
+		p[i] = object;
+	}
+	local_irq_restore(irqflags);
+
+	for (j = 0; j < i; j++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[j], 0, s->objsize);
+		kmemcheck_slab_alloc(s, flags, p[j], s->objsize);
+		kmemleak_alloc_recursive(p[j], s->objsize, 1, s->flags, flags);
+		trace_kmem_cache_alloc(_RET_IP_, p[j], s->objsize, s->size,
+				       flags);
+	}
+
+	if (unlikely(i < size)) {
+		kmem_cache_free_bulk(s, i, p);
+		return 0;
+	}
+	return size;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 #ifdef CONFIG_TRACING
 void *kmem_cache_alloc_notrace(struct kmem_cache *s, gfp_t gfpflags)
 {
@@ -1863,16 +1926,12 @@ debug:
  * If fastpath is not possible then fall back to __slab_free where we deal
  * with all sorts of special processing.
  */
-static __always_inline void slab_free(struct kmem_cache *s,
-			struct page *page, void *x, unsigned long addr)
+static __always_inline void __slab_free_irqoff(struct kmem_cache *s,
+			struct kmem_cache_cpu *c, struct page *page, void *x,
+			unsigned long addr)
 {
 	void **object = (void *)x;
-	struct kmem_cache_cpu *c;
-	unsigned long flags;
 
-	kmemleak_free_recursive(x, s->flags);
-	local_irq_save(flags);
-	c = get_cpu_slab(s, smp_processor_id());
 	kmemcheck_slab_free(s, object, c->objsize);
 	debug_check_no_locks_freed(object, c->objsize);
 	if (!(s->flags & SLAB_DEBUG_OBJECTS))
@@ -1883,7 +1942,17 @@ static __always_inline void slab_free(struct kmem_cache *s,
 		stat(c, FREE_FASTPATH);
 	} else
 		__slab_free(s, page, x, addr, c->offset);
+}
+
+static __always_inline void slab_free(struct kmem_cache *s,
+			struct page *page, void *x, unsigned long addr)
+{
+	unsigned long flags;
 
+	kmemleak_free_recursive(x, s->flags);
+	local_irq_save(flags);
+	__slab_free_irqoff(s, get_cpu_slab(s, smp_processor_id()),
+			   page, x, addr);
 	local_irq_restore(flags);
 }
 
@@ -1899,6 +1968,35 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_free_bulk - free an array of objects
+ * @s: the cache the objects belong to
+ * @size: number of objects in @p
+ * @p: the objects
+ *
+ * Frees all objects in @p with interrupts disabled only once, so that
+ * objects going back to the cpu slab cost no more than a list insertion.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		kmemleak_free_recursive(p[i], s->flags);
+
+	local_irq_save(flags);
+	c = get_cpu_slab(s, smp_processor_id());
+	for (i = 0; i < size; i++) {
+		__slab_free_irqoff(s, c, virt_to_head_page(p[i]), p[i],
+				   _RET_IP_);
+		trace_kmem_cache_free(_RET_IP_, p[i]);
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
 /* Figure out on which slab page the object resides */
 static struct page *get_object_page(const void *x)
 {
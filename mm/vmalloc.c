@@ -26,6 +26,7 @@
 #include <linux/rcupdate.h>
 #include <linux/pfn.h>
 #include <linux/kmemleak.h>
+#include <linux/debugfs.h>
 #include <asm/atomic.h>
 #include <asm/uaccess.h>
 #include <asm/tlbflush.h>
@@ -502,6 +503,9 @@ static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
 
+	if (sysctl_vmap_lazy_max_kb)
+		return sysctl_vmap_lazy_max_kb >> (PAGE_SHIFT - 10);
+
 	log = fls(num_online_cpus());
 
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
@@ -509,6 +513,55 @@ static unsigned long lazy_max_pages(void)
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
+/*
+ * Tunables: the amount of lazily freed space that triggers a purge (0 means
+ * the lazy_max_pages() default), and the amount of space above which a purge
+ * flushes the whole TLB rather than walking its ranges page by page.
+ */
+int sysctl_vmap_lazy_max_kb;
+int sysctl_vmap_flush_all_kb = 256;
+
+/* Purge statistics, updated under purge_lock */
+static struct vmap_purge_stats {
+	unsigned long purges;
+	unsigned long areas;
+	unsigned long max_areas;
+	unsigned long pages;
+	unsigned long flush_all;
+	unsigned long flush_span;
+	unsigned long flush_areas;
+	u64 ns;
+	u64 max_ns;
+} vmap_purge_stats;
+
+/*
+ * Flush the TLB for a purge.  The areas being purged can be scattered
+ * over the vmalloc space; flushing the span from the lowest to the highest
+ * of them costs as much as the span on architectures that flush page by
+ * page (ARM does), so flush each area on its own when they are sparse,
+ * and the whole TLB once there is more to flush than it is worth walking.
+ */
+static void vmap_flush_tlb(struct list_head *valist, int nr_areas,
+			   unsigned long nr, unsigned long start,
+			   unsigned long end, int force_flush)
+{
+	unsigned long span = (end - start) >> PAGE_SHIFT;
+	struct vmap_area *va;
+
+	if (max(nr, force_flush ? span : 0UL) >
+	    (sysctl_vmap_flush_all_kb >> (PAGE_SHIFT - 10))) {
+		flush_tlb_all();
+		vmap_purge_stats.flush_all++;
+	} else if (force_flush || nr_areas == 1 || span <= 2 * nr) {
+		flush_tlb_kernel_range(start, end);
+		vmap_purge_stats.flush_span++;
+	} else {
+		list_for_each_entry(va, valist, purge_list)
+			flush_tlb_kernel_range(va->va_start, va->va_end);
+		vmap_purge_stats.flush_areas++;
+	}
+}
+
 /*
  * Purges all lazily-freed vmap areas.
  *
@@ -526,7 +579,8 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	LIST_HEAD(valist);
 	struct vmap_area *va;
 	struct vmap_area *n_va;
-	int nr = 0;
+	int nr = 0, nr_areas = 0;
+	u64 t0, delta;
 
 	/*
 	 * If sync is 0 but force_flush is 1, we'll go sync anyway but callers
@@ -539,6 +593,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	} else
 		spin_lock(&purge_lock);
 
+	t0 = sched_clock();
 	rcu_read_lock();
 	list_for_each_entry_rcu(va, &vmap_area_list, list) {
 		if (va->flags & VM_LAZY_FREE) {
@@ -547,6 +602,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 			if (va->va_end > *end)
 				*end = va->va_end;
 			nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
+			nr_areas++;
 			unmap_vmap_area(va);
 			list_add_tail(&va->purge_list, &valist);
 			va->flags |= VM_LAZY_FREEING;
@@ -561,7 +617,8 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	}
 
 	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+		vmap_flush_tlb(&valist, nr_areas, nr, *start, *end,
+			       force_flush);
 
 	if (nr) {
 		spin_lock(&vmap_area_lock);
@@ -569,6 +626,18 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 			__free_vmap_area(va);
 		spin_unlock(&vmap_area_lock);
 	}
+
+	if (nr || force_flush) {
+		delta = sched_clock() - t0;
+		vmap_purge_stats.purges++;
+		vmap_purge_stats.areas += nr_areas;
+		vmap_purge_stats.pages += nr;
+		vmap_purge_stats.ns += delta;
+		if (nr_areas > vmap_purge_stats.max_areas)
+			vmap_purge_stats.max_areas = nr_areas;
+		if (delta > vmap_purge_stats.max_ns)
+			vmap_purge_stats.max_ns = delta;
+	}
 	spin_unlock(&purge_lock);
 }
 
@@ -671,6 +740,11 @@ struct vmap_block_queue {
 	struct list_head free;
 	struct list_head dirty;
 	unsigned int nr_dirty;
+
+	/* statistics */
+	unsigned long alloc_reuse;	/* allocations from an existing block */
+	unsigned long alloc_new;	/* allocations that needed a new block */
+	unsigned long blocks_freed;	/* blocks fully dirtied and released */
 };
 
 struct vmap_block {
@@ -760,6 +834,7 @@ static struct vmap_block *new_vmap_block(gfp_t gfp_mask)
 	vb->vbq = vbq;
 	spin_lock(&vbq->lock);
 	list_add(&vb->free_list, &vbq->free);
+	vbq->alloc_new++;
 	spin_unlock(&vbq->lock);
 	put_cpu_var(vmap_block_queue);
 
@@ -786,6 +861,10 @@ static void free_vmap_block(struct vmap_block *vb)
 	spin_unlock(&vmap_block_tree_lock);
 	BUG_ON(tmp != vb);
 
+	spin_lock(&vb->vbq->lock);
+	vb->vbq->blocks_freed++;
+	spin_unlock(&vb->vbq->lock);
+
 	free_unmap_vmap_area_noflush(vb->va);
 	call_rcu(&vb->rcu_head, rcu_free_vb);
 }
@@ -796,6 +875,7 @@ static void *vb_alloc(unsigned long size, gfp_t gfp_mask)
 	struct vmap_block *vb;
 	unsigned long addr = 0;
 	unsigned int order;
+	int new_block = 0;
 
 	BUG_ON(size & ~PAGE_MASK);
 	BUG_ON(size > PAGE_SIZE*VMAP_MAX_ALLOC);
@@ -826,6 +906,9 @@ again:
 		}
 		spin_unlock(&vb->lock);
 	}
+	/* After new_vmap_block() the block found is the one just counted */
+	if (addr && !new_block)
+		vbq->alloc_reuse++;
 	put_cpu_var(vmap_block_queue);
 	rcu_read_unlock();
 
@@ -833,6 +916,7 @@ again:
 		vb = new_vmap_block(gfp_mask);
 		if (IS_ERR(vb))
 			return vb;
+		new_block = 1;
 		goto again;
 	}
 
@@ -2403,3 +2487,61 @@ static int __init proc_vmalloc_init(void)
 module_init(proc_vmalloc_init);
 #endif
 
+#ifdef CONFIG_DEBUG_FS
+static int vmap_stats_show(struct seq_file *m, void *v)
+{
+	struct vmap_purge_stats *ps = &vmap_purge_stats;
+	int cpu;
+
+	seq_printf(m,
+		   "lazy_pages:       %8d\n"
+		   "lazy_max_pages:   %8lu\n"
+		   "purges:           %8lu\n"
+		   "areas_purged:     %8lu\n"
+		   "areas_per_purge:  %8lu\n"
+		   "max_areas:        %8lu\n"
+		   "pages_purged:     %8lu\n"
+		   "flush_all:        %8lu\n"
+		   "flush_span:       %8lu\n"
+		   "flush_areas:      %8lu\n"
+		   "purge_usecs:      %8llu\n"
+		   "max_purge_usecs:  %8llu\n",
+		   atomic_read(&vmap_lazy_nr), lazy_max_pages(),
+		   ps->purges, ps->areas,
+		   ps->purges ? ps->areas / ps->purges : 0,
+		   ps->max_areas, ps->pages,
+		   ps->flush_all, ps->flush_span, ps->flush_areas,
+		   (unsigned long long)div_u64(ps->ns, NSEC_PER_USEC),
+		   (unsigned long long)div_u64(ps->max_ns, NSEC_PER_USEC));
+
+	seq_printf(m, "\ncpu  block_reuse  block_new  blocks_freed\n");
+	for_each_possible_cpu(cpu) {
+		struct vmap_block_queue *vbq = &per_cpu(vmap_block_queue, cpu);
+
+		seq_printf(m, "%3d %12lu %10lu %13lu\n", cpu,
+			   vbq->alloc_reuse, vbq->alloc_new,
+			   vbq->blocks_freed);
+	}
+	return 0;
+}
+
+static int vmap_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vmap_stats_show, NULL);
+}
+
+static const struct file_operations vmap_stats_fops = {
+	.open		= vmap_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init vmap_debugfs_init(void)
+{
+	debugfs_create_file("vmap_stats", 0444, NULL, NULL, &vmap_stats_fops);
+	return 0;
+}
+late_initcall(vmap_debugfs_init);
+#endif
+
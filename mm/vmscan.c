@@ -475,6 +475,13 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		spin_unlock_irq(&mapping->tree_lock);
 		swapcache_free(swap, page);
 	} else {
+		/*
+		 * A readahead marker that is reclaimed before the reader got
+		 * to it means the window behind it is being thrashed.
+		 */
+		if (unlikely(PageReadahead(page)))
+			__inc_bdi_stat(mapping->backing_dev_info,
+				       BDI_RA_EVICTED);
 		__remove_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -746,11 +746,20 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   "\n    cpu: %i"
 			   "\n              count: %i"
 			   "\n              high:  %i"
-			   "\n              batch: %i",
+			   "\n              batch: %i"
+			   "\n              refills: %lu"
+			   "\n              drains:  %lu"
+			   "\n              resizes: %lu"
+			   "\n              lock_usecs: %llu",
 			   i,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
-			   pageset->pcp.batch);
+			   pageset->pcp.batch,
+			   pageset->pcp.refills,
+			   pageset->pcp.drains,
+			   pageset->pcp.resizes,
+			   (unsigned long long)div_u64(pageset->pcp.lock_ns,
+						       NSEC_PER_USEC));
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
@@ -0,0 +1,267 @@
+/*
+ *  linux/net/core/coalesce.c
+ *
+ *  Adaptive interrupt coalescing for NAPI drivers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * A NAPI driver reports how many packets each poll handled.  Every
+ * NET_COALESCE_SAMPLE_JIFFIES the packet rate is worked out and mapped
+ * to one of three coalescing levels: no coalescing below pkt_rate_low,
+ * so a lone packet is not held back, heavy coalescing above
+ * pkt_rate_high, where interrupts would otherwise eat the CPU, and the
+ * configured rx_coalesce_usecs/rx_max_coalesced_frames in between.
+ * A level change is applied through the driver's own ethtool
+ * set_coalesce(), so it goes through the same code as "ethtool -C".
+ * An idle device takes no samples, so above the lowest level a timer
+ * checks that samples are still coming and drops the level if not.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/ethtool.h>
+#include <linux/rtnetlink.h>
+#include <linux/net_coalesce.h>
+#include <asm/div64.h>
+
+/*
+ * Defaults, sized for 10/100 MACs: a 100Mbit link carries about 8k full
+ * sized frames a second.
+ */
+#define NET_COALESCE_RATE_LOW		10000
+#define NET_COALESCE_RATE_HIGH		50000
+
+/* No sample for this long means the device went idle */
+#define NET_COALESCE_IDLE_JIFFIES	(4 * NET_COALESCE_SAMPLE_JIFFIES)
+
+static const u32 net_coalesce_default_usecs[NET_COALESCE_LEVELS] = {
+	[NET_COALESCE_LOW]	= 0,
+	[NET_COALESCE_MID]	= 50,
+	[NET_COALESCE_HIGH]	= 200,
+};
+
+static const u32 net_coalesce_default_frames[NET_COALESCE_LEVELS] = {
+	[NET_COALESCE_LOW]	= 1,
+	[NET_COALESCE_MID]	= 8,
+	[NET_COALESCE_HIGH]	= 32,
+};
+
+static void net_coalesce_apply(struct net_coalesce *nc, unsigned int level)
+{
+	nc->usecs = nc->level_usecs[level];
+	nc->frames = nc->level_frames[level];
+}
+
+static void net_coalesce_work(struct work_struct *work)
+{
+	struct net_coalesce *nc =
+		container_of(work, struct net_coalesce, work.work);
+	struct net_device *dev = nc->dev;
+	const struct ethtool_ops *ops = dev->ethtool_ops;
+	struct ethtool_coalesce ec = { .cmd = ETHTOOL_GCOALESCE };
+
+	/* net_coalesce_stop() waits for us with the RTNL held */
+	if (!rtnl_trylock()) {
+		schedule_delayed_work(&nc->work, 1);
+		return;
+	}
+
+	if (netif_running(dev) && nc->adaptive &&
+	    !ops->get_coalesce(dev, &ec)) {
+		ec.cmd = ETHTOOL_SCOALESCE;
+		ops->set_coalesce(dev, &ec);
+		if (nc->level != NET_COALESCE_LOW)
+			schedule_delayed_work(&nc->idle_work,
+					      NET_COALESCE_IDLE_JIFFIES);
+	}
+
+	rtnl_unlock();
+}
+
+/*
+ * Without NAPI polls the level would stay wherever the last burst left it,
+ * holding back the next packet for no reason.  A poll racing with us
+ * closes a sample that spans the idle time, so it picks the lowest level
+ * as well.
+ */
+static void net_coalesce_idle_work(struct work_struct *work)
+{
+	struct net_coalesce *nc =
+		container_of(work, struct net_coalesce, idle_work.work);
+
+	if (!netif_running(nc->dev) || !nc->adaptive ||
+	    ACCESS_ONCE(nc->level) == NET_COALESCE_LOW)
+		return;
+
+	if (time_before(jiffies, ACCESS_ONCE(nc->sample_start) +
+				 NET_COALESCE_IDLE_JIFFIES)) {
+		schedule_delayed_work(&nc->idle_work,
+				      NET_COALESCE_IDLE_JIFFIES);
+		return;
+	}
+
+	nc->level = NET_COALESCE_LOW;
+	nc->stats.lowered++;
+	schedule_delayed_work(&nc->work, 0);
+}
+
+/**
+ *	net_coalesce_init - set up coalescing state
+ *	@nc: coalescing state
+ *	@dev: device, its ethtool_ops must have get_coalesce and set_coalesce
+ *
+ *	Adaptive coalescing starts out enabled.  Drivers may change the
+ *	defaults after this returns.
+ */
+void net_coalesce_init(struct net_coalesce *nc, struct net_device *dev)
+{
+	memset(nc, 0, sizeof(*nc));
+	nc->dev = dev;
+	nc->adaptive = 1;
+	nc->pkt_rate_low = NET_COALESCE_RATE_LOW;
+	nc->pkt_rate_high = NET_COALESCE_RATE_HIGH;
+	memcpy(nc->level_usecs, net_coalesce_default_usecs,
+	       sizeof(nc->level_usecs));
+	memcpy(nc->level_frames, net_coalesce_default_frames,
+	       sizeof(nc->level_frames));
+	nc->level = NET_COALESCE_LOW;
+	net_coalesce_apply(nc, nc->level);
+	INIT_DELAYED_WORK(&nc->work, net_coalesce_work);
+	INIT_DELAYED_WORK(&nc->idle_work, net_coalesce_idle_work);
+}
+EXPORT_SYMBOL(net_coalesce_init);
+
+/**
+ *	net_coalesce_start - restart rate sampling
+ *	@nc: coalescing state
+ *
+ *	Called from ndo_open before NAPI is enabled.  The driver programs the
+ *	hardware from @nc->usecs and @nc->frames afterwards.
+ */
+void net_coalesce_start(struct net_coalesce *nc)
+{
+	nc->level = NET_COALESCE_LOW;
+	nc->sample_start = jiffies;
+	nc->sample_packets = 0;
+	net_coalesce_apply(nc, nc->adaptive ? nc->level : NET_COALESCE_MID);
+}
+EXPORT_SYMBOL(net_coalesce_start);
+
+/**
+ *	net_coalesce_stop - stop applying level changes
+ *	@nc: coalescing state
+ *
+ *	Called from ndo_stop once NAPI is disabled.
+ */
+void net_coalesce_stop(struct net_coalesce *nc)
+{
+	/* the idle check queues the level change, so it goes first */
+	cancel_delayed_work_sync(&nc->idle_work);
+	cancel_delayed_work_sync(&nc->work);
+}
+EXPORT_SYMBOL(net_coalesce_stop);
+
+/**
+ *	net_coalesce_get - report coalescing parameters
+ *	@nc: coalescing state
+ *	@ec: filled in for ethtool get_coalesce
+ *
+ *	Drivers fill in the fields their hardware has beyond these.
+ */
+void net_coalesce_get(struct net_coalesce *nc, struct ethtool_coalesce *ec)
+{
+	ec->use_adaptive_rx_coalesce = nc->adaptive;
+	ec->pkt_rate_low = nc->pkt_rate_low;
+	ec->pkt_rate_high = nc->pkt_rate_high;
+
+	ec->rx_coalesce_usecs_low = nc->level_usecs[NET_COALESCE_LOW];
+	ec->rx_max_coalesced_frames_low = nc->level_frames[NET_COALESCE_LOW];
+	ec->rx_coalesce_usecs = nc->level_usecs[NET_COALESCE_MID];
+	ec->rx_max_coalesced_frames = nc->level_frames[NET_COALESCE_MID];
+	ec->rx_coalesce_usecs_high = nc->level_usecs[NET_COALESCE_HIGH];
+	ec->rx_max_coalesced_frames_high = nc->level_frames[NET_COALESCE_HIGH];
+}
+EXPORT_SYMBOL(net_coalesce_get);
+
+/**
+ *	net_coalesce_set - take coalescing parameters
+ *	@nc: coalescing state
+ *	@ec: as passed to ethtool set_coalesce
+ *
+ *	Updates @nc->usecs and @nc->frames for the current level, the caller
+ *	then programs the hardware with them.  Without adaptive coalescing
+ *	rx_coalesce_usecs and rx_max_coalesced_frames are used as they are.
+ */
+int net_coalesce_set(struct net_coalesce *nc, const struct ethtool_coalesce *ec)
+{
+	if (ec->use_adaptive_rx_coalesce &&
+	    ec->pkt_rate_low > ec->pkt_rate_high)
+		return -EINVAL;
+
+	nc->adaptive = !!ec->use_adaptive_rx_coalesce;
+	nc->pkt_rate_low = ec->pkt_rate_low;
+	nc->pkt_rate_high = ec->pkt_rate_high;
+
+	nc->level_usecs[NET_COALESCE_LOW] = ec->rx_coalesce_usecs_low;
+	nc->level_frames[NET_COALESCE_LOW] = ec->rx_max_coalesced_frames_low;
+	nc->level_usecs[NET_COALESCE_MID] = ec->rx_coalesce_usecs;
+	nc->level_frames[NET_COALESCE_MID] = ec->rx_max_coalesced_frames;
+	nc->level_usecs[NET_COALESCE_HIGH] = ec->rx_coalesce_usecs_high;
+	nc->level_frames[NET_COALESCE_HIGH] = ec->rx_max_coalesced_frames_high;
+
+	net_coalesce_apply(nc, nc->adaptive ? ACCESS_ONCE(nc->level) :
+					      NET_COALESCE_MID);
+	return 0;
+}
+EXPORT_SYMBOL(net_coalesce_set);
+
+/*
+ * Level for @rate.  Moving down takes the rate to fall an eighth below
+ * the threshold, so a rate hovering around it does not flip the level on
+ * every sample.
+ */
+static unsigned int net_coalesce_pick(struct net_coalesce *nc, u32 rate)
+{
+	u32 low = nc->pkt_rate_low, high = nc->pkt_rate_high;
+
+	if (rate > high)
+		return NET_COALESCE_HIGH;
+	if (nc->level == NET_COALESCE_HIGH && rate > high - high / 8)
+		return NET_COALESCE_HIGH;
+	if (rate > low)
+		return NET_COALESCE_MID;
+	if (nc->level != NET_COALESCE_LOW && rate > low - low / 8)
+		return NET_COALESCE_MID;
+	return NET_COALESCE_LOW;
+}
+
+/* Slow path of net_coalesce_sample(): close the sample, pick a level */
+void __net_coalesce_update(struct net_coalesce *nc)
+{
+	unsigned long now = jiffies;
+	u64 rate = (u64)nc->sample_packets * HZ;
+	unsigned int level;
+
+	do_div(rate, (u32)(now - nc->sample_start));
+	nc->sample_start = now;
+	nc->sample_packets = 0;
+	nc->stats.samples++;
+
+	level = net_coalesce_pick(nc, rate > ~0U ? ~0U : (u32)rate);
+	if (level == nc->level)
+		return;
+
+	if (level > nc->level)
+		nc->stats.raised++;
+	else
+		nc->stats.lowered++;
+	nc->level = level;
+
+	/* NAPI runs in softirq context, set_coalesce() wants the RTNL */
+	schedule_delayed_work(&nc->work, 0);
+}
+EXPORT_SYMBOL(__net_coalesce_update);
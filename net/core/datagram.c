@@ -80,7 +80,7 @@ static int receiver_wake_function(wait_queue_t *wait, unsigned mode, int sync,
 /*
  * Wait for a packet..
  */
-static int wait_for_packet(struct sock *sk, int *err, long *timeo_p)
+int __skb_wait_for_more_packets(struct sock *sk, int *err, long *timeo_p)
 {
 	int error;
 	DEFINE_WAIT_FUNC(wait, receiver_wake_function);
@@ -126,6 +126,7 @@ out_noerr:
 	error = 1;
 	goto out;
 }
+EXPORT_SYMBOL(__skb_wait_for_more_packets);
 
 /**
  *	__skb_recv_datagram - Receive a datagram skbuff
@@ -200,7 +201,7 @@ struct sk_buff *__skb_recv_datagram(struct sock *sk, unsigned flags,
 		if (!timeo)
 			goto no_packet;
 
-	} while (!wait_for_packet(sk, err, &timeo));
+	} while (!__skb_wait_for_more_packets(sk, err, &timeo));
 
 	return NULL;
 
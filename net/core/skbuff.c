@@ -526,6 +526,191 @@ int skb_recycle_check(struct sk_buff *skb, int skb_size)
 }
 EXPORT_SYMBOL(skb_recycle_check);
 
+/**
+ *	skb_pool_init - set up a pool of recycled receive buffers
+ *	@pool: pool to initialise
+ *	@skb_size: size of the receive buffers, as for __netdev_alloc_skb()
+ *	@max: most buffers kept on each CPU
+ *
+ *	Returns 0, or -ENOMEM if the per CPU lists could not be allocated.
+ */
+int skb_pool_init(struct skb_pool *pool, unsigned int skb_size,
+		  unsigned int max)
+{
+	int cpu;
+
+	pool->cpu = alloc_percpu(struct skb_pool_cpu);
+	if (!pool->cpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		skb_queue_head_init(&per_cpu_ptr(pool->cpu, cpu)->list);
+
+	pool->skb_size = skb_size;
+	pool->max = max;
+	return 0;
+}
+EXPORT_SYMBOL(skb_pool_init);
+
+/**
+ *	skb_pool_purge - free all buffers held in a pool
+ *	@pool: pool to empty
+ *
+ *	The caller must make sure that nothing allocates from or frees to
+ *	the pool meanwhile, e.g. by stopping the device.
+ */
+void skb_pool_purge(struct skb_pool *pool)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		skb_queue_purge(&per_cpu_ptr(pool->cpu, cpu)->list);
+}
+EXPORT_SYMBOL(skb_pool_purge);
+
+/**
+ *	skb_pool_destroy - free a pool and all buffers it holds
+ *	@pool: pool set up by skb_pool_init()
+ */
+void skb_pool_destroy(struct skb_pool *pool)
+{
+	if (!pool->cpu)
+		return;
+
+	skb_pool_purge(pool);
+	free_percpu(pool->cpu);
+	pool->cpu = NULL;
+}
+EXPORT_SYMBOL(skb_pool_destroy);
+
+/**
+ *	skb_pool_fill - preallocate receive buffers
+ *	@pool: pool to fill
+ *	@dev: network device receiving into the buffers
+ *	@nr: number of buffers to have ready
+ *
+ *	Fills the list of the current CPU up to @nr buffers, but no further
+ *	than the pool maximum.  Stops quietly when memory runs out.
+ */
+void skb_pool_fill(struct skb_pool *pool, struct net_device *dev,
+		   unsigned int nr)
+{
+	struct skb_pool_cpu *pc;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	nr = min(nr, pool->max);
+	for (;;) {
+		skb = __netdev_alloc_skb(dev, pool->skb_size, GFP_KERNEL);
+		if (!skb)
+			break;
+
+		local_irq_save(flags);
+		pc = per_cpu_ptr(pool->cpu, smp_processor_id());
+		if (skb_queue_len(&pc->list) >= nr) {
+			local_irq_restore(flags);
+			kfree_skb(skb);
+			break;
+		}
+		__skb_queue_tail(&pc->list, skb);
+		local_irq_restore(flags);
+	}
+}
+EXPORT_SYMBOL(skb_pool_fill);
+
+/**
+ *	skb_pool_alloc - allocate a receive buffer
+ *	@pool: pool to allocate from
+ *	@dev: network device receiving into the buffer
+ *	@length: size needed
+ *
+ *	Like netdev_alloc_skb(), but takes a recycled buffer when there is
+ *	one.  Requests larger than the pool's buffers always go to slab;
+ *	others allocate the pool's size, so that the buffer can be recycled
+ *	later.  May be called in any context.
+ */
+struct sk_buff *skb_pool_alloc(struct skb_pool *pool, struct net_device *dev,
+			       unsigned int length)
+{
+	struct skb_pool_cpu *pc;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	if (unlikely(length > pool->skb_size))
+		return __netdev_alloc_skb(dev, length, GFP_ATOMIC);
+
+	local_irq_save(flags);
+	pc = per_cpu_ptr(pool->cpu, smp_processor_id());
+	skb = __skb_dequeue(&pc->list);
+	if (likely(skb))
+		pc->hits++;
+	else
+		pc->misses++;
+	local_irq_restore(flags);
+
+	if (unlikely(!skb))
+		return __netdev_alloc_skb(dev, pool->skb_size, GFP_ATOMIC);
+
+	skb->dev = dev;
+	return skb;
+}
+EXPORT_SYMBOL(skb_pool_alloc);
+
+/**
+ *	skb_pool_free - free a transmitted buffer
+ *	@pool: pool to recycle into
+ *	@skb: buffer
+ *
+ *	Keeps @skb for skb_pool_alloc() if skb_recycle_check() accepts it
+ *	and the current CPU's list is not full, and frees it otherwise.
+ *	Since skb_recycle_check() refuses buffers with interrupts disabled,
+ *	drivers should free outside of their irqsave locks to recycle.
+ */
+void skb_pool_free(struct skb_pool *pool, struct sk_buff *skb)
+{
+	struct skb_pool_cpu *pc;
+	unsigned long flags;
+
+	if (!skb_recycle_check(skb, pool->skb_size)) {
+		dev_kfree_skb_any(skb);
+		return;
+	}
+
+	local_irq_save(flags);
+	pc = per_cpu_ptr(pool->cpu, smp_processor_id());
+	if (likely(skb_queue_len(&pc->list) < pool->max)) {
+		__skb_queue_head(&pc->list, skb);
+		pc->recycled++;
+		skb = NULL;
+	}
+	local_irq_restore(flags);
+
+	if (unlikely(skb))
+		kfree_skb(skb);
+}
+EXPORT_SYMBOL(skb_pool_free);
+
+/**
+ *	skb_pool_get_stats - sum the counters of all CPUs
+ *	@pool: pool
+ *	@stats: where to store the sums
+ */
+void skb_pool_get_stats(const struct skb_pool *pool,
+			struct skb_pool_stats *stats)
+{
+	struct skb_pool_cpu *pc;
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(pool->cpu, cpu);
+		stats->hits += pc->hits;
+		stats->misses += pc->misses;
+		stats->recycled += pc->recycled;
+	}
+}
+EXPORT_SYMBOL(skb_pool_get_stats);
+
 static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 {
 	new->tstamp		= old->tstamp;
@@ -1034,6 +1034,259 @@ out:
 }
 
 
+/*
+ * UDP receive queue
+ *
+ * The softirq side appends datagrams to sk->sk_receive_queue holding only
+ * that queue's lock: it neither takes the socket lock nor uses the backlog.
+ * Readers consume from udp_sk(sk)->reader_queue, which the softirq side
+ * never touches, and refill it by splicing over the whole receive queue
+ * once it runs dry, so producers and consumers meet once per batch rather
+ * than once per datagram.
+ *
+ * Receive memory (sk_forward_alloc, sk_rmem_alloc) is charged under the
+ * receive queue lock.  Datagrams taken off the reader queue add their
+ * truesize to up->forward_deficit instead of uncharging it one by one; the
+ * deficit is handed back when it exceeds a quarter of the receive buffer
+ * or when the reader queue runs empty.  Nothing may reclaim the forward
+ * allocation without that lock, which is why in-kernel readers have to use
+ * __skb_recv_udp() and skb_free_udp() rather than the generic datagram
+ * helpers.
+ */
+static void udp_rmem_uncharge(struct sock *sk, int size)
+{
+	struct sk_buff_head *sk_queue = &sk->sk_receive_queue;
+
+	spin_lock_bh(&sk_queue->lock);
+	sk_mem_uncharge(sk, size);
+	sk_mem_reclaim_partial(sk);
+	atomic_sub(size, &sk->sk_rmem_alloc);
+	spin_unlock_bh(&sk_queue->lock);
+}
+
+/* Destructor of datagrams that are freed without going through the reader */
+static void udp_skb_destructor(struct sk_buff *skb)
+{
+	udp_rmem_uncharge(skb->sk, skb->truesize);
+}
+
+/* Called with reader_queue.lock held, after @skb was unlinked from it */
+static void udp_skb_dequeued(struct sock *sk, struct sk_buff *skb)
+{
+	struct udp_sock *up = udp_sk(sk);
+
+	skb->destructor = NULL;
+	skb->sk = NULL;
+
+	up->forward_deficit += skb->truesize;
+	if (up->forward_deficit < (sk->sk_rcvbuf >> 2) &&
+	    !skb_queue_empty(&up->reader_queue))
+		return;
+
+	udp_rmem_uncharge(sk, up->forward_deficit);
+	up->forward_deficit = 0;
+}
+
+/**
+ *	__udp_enqueue_schedule_skb - charge a datagram and queue it for reading
+ *	@sk: socket
+ *	@skb: datagram
+ *
+ *	Softirq counterpart of sock_queue_rcv_skb() for UDP sockets.  Returns
+ *	0 on success and a negative errno if @skb was not queued; in the
+ *	latter case the caller still owns @skb.
+ */
+int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
+{
+	struct sk_buff_head *list = &sk->sk_receive_queue;
+	int size = skb->truesize;
+	int skb_len;
+	int err;
+
+	if (atomic_read(&sk->sk_rmem_alloc) + size >= (unsigned)sk->sk_rcvbuf)
+		goto drop_nomem;
+
+	err = sk_filter(sk, skb);
+	if (err)
+		return err;
+
+	/*
+	 * Several CPUs may be queueing to this socket at once, so the test
+	 * above can race: charge first, then back out if that took us past
+	 * the receive buffer.
+	 */
+	if (atomic_add_return(size, &sk->sk_rmem_alloc) >
+	    (unsigned)sk->sk_rcvbuf) {
+		atomic_sub(size, &sk->sk_rmem_alloc);
+		goto drop_nomem;
+	}
+
+	spin_lock(&list->lock);
+	if (!sk_rmem_schedule(sk, size)) {
+		spin_unlock(&list->lock);
+		atomic_sub(size, &sk->sk_rmem_alloc);
+		atomic_inc(&sk->sk_drops);
+		return -ENOBUFS;
+	}
+	sk_mem_charge(sk, size);
+
+	skb->dev = NULL;
+	skb->sk = sk;
+	skb->destructor = udp_skb_destructor;
+	skb->dropcount = atomic_read(&sk->sk_drops);
+
+	/* @skb belongs to the readers as soon as the lock is dropped */
+	skb_len = skb->len;
+	__skb_queue_tail(list, skb);
+	spin_unlock(&list->lock);
+
+	if (!sock_flag(sk, SOCK_DEAD))
+		sk->sk_data_ready(sk, skb_len);
+	return 0;
+
+drop_nomem:
+	atomic_inc(&sk->sk_drops);
+	return -ENOMEM;
+}
+EXPORT_SYMBOL(__udp_enqueue_schedule_skb);
+
+/* Refill the reader queue from the receive queue, reader_queue.lock held */
+static void udp_refill_reader_queue(struct sock *sk)
+{
+	struct sk_buff_head *sk_queue = &sk->sk_receive_queue;
+
+	if (skb_queue_empty(sk_queue))
+		return;
+
+	spin_lock(&sk_queue->lock);
+	skb_queue_splice_tail_init(sk_queue, &udp_sk(sk)->reader_queue);
+	spin_unlock(&sk_queue->lock);
+}
+
+static struct sk_buff *udp_try_dequeue(struct sock *sk, unsigned int flags,
+				       int *peeked)
+{
+	struct sk_buff_head *queue = &udp_sk(sk)->reader_queue;
+	struct sk_buff *skb;
+
+	skb = skb_peek(queue);
+	if (!skb) {
+		udp_refill_reader_queue(sk);
+		skb = skb_peek(queue);
+		if (!skb)
+			return NULL;
+	}
+
+	*peeked = skb->peeked;
+	if (flags & MSG_PEEK) {
+		skb->peeked = 1;
+		atomic_inc(&skb->users);
+	} else {
+		__skb_unlink(skb, queue);
+		udp_skb_dequeued(sk, skb);
+	}
+	return skb;
+}
+
+/**
+ *	__skb_recv_udp - receive a datagram from a UDP socket
+ *	@sk: socket
+ *	@flags: MSG_ flags
+ *	@peeked: returns non-zero if this packet has been seen before
+ *	@err: error code returned
+ *
+ *	UDP version of __skb_recv_datagram().  A datagram returned without
+ *	MSG_PEEK is no longer charged to the socket and is released with
+ *	consume_skb() or kfree_skb(); no socket lock is needed for that.
+ */
+struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
+			       int *peeked, int *err)
+{
+	struct sk_buff_head *queue = &udp_sk(sk)->reader_queue;
+	struct sk_buff *skb;
+	long timeo;
+	int error = sock_error(sk);
+
+	if (error)
+		goto no_packet;
+
+	timeo = sock_rcvtimeo(sk, flags & MSG_DONTWAIT);
+
+	do {
+		spin_lock_bh(&queue->lock);
+		skb = udp_try_dequeue(sk, flags, peeked);
+		spin_unlock_bh(&queue->lock);
+
+		if (skb)
+			return skb;
+
+		/* User doesn't want to wait */
+		error = -EAGAIN;
+		if (!timeo)
+			goto no_packet;
+
+	} while (!__skb_wait_for_more_packets(sk, err, &timeo));
+
+	return NULL;
+
+no_packet:
+	*err = error;
+	return NULL;
+}
+EXPORT_SYMBOL(__skb_recv_udp);
+
+/**
+ *	skb_kill_udp - free a datagram that failed its checksum
+ *	@sk: socket
+ *	@skb: datagram returned by __skb_recv_udp()
+ *	@flags: MSG_ flags passed to __skb_recv_udp()
+ *
+ *	Returns 0 if the datagram was removed by us, as skb_kill_datagram().
+ */
+int skb_kill_udp(struct sock *sk, struct sk_buff *skb, unsigned int flags)
+{
+	struct sk_buff_head *queue = &udp_sk(sk)->reader_queue;
+	int err = 0;
+
+	if (flags & MSG_PEEK) {
+		err = -ENOENT;
+		spin_lock_bh(&queue->lock);
+		if (skb == skb_peek(queue)) {
+			__skb_unlink(skb, queue);
+			atomic_dec(&skb->users);
+			err = 0;
+		}
+		spin_unlock_bh(&queue->lock);
+	}
+
+	kfree_skb(skb);
+	atomic_inc(&sk->sk_drops);
+
+	return err;
+}
+EXPORT_SYMBOL(skb_kill_udp);
+
+/**
+ *	skb_free_udp - free a datagram received from a UDP socket
+ *	@sk: socket
+ *	@skb: datagram returned by __skb_recv_udp()
+ *
+ *	UDP version of skb_free_datagram() for in-kernel readers.  The
+ *	forward allocation is only ever touched under the receive queue lock,
+ *	so that is where the partial reclaim has to be done as well.
+ */
+void skb_free_udp(struct sock *sk, struct sk_buff *skb)
+{
+	struct sk_buff_head *sk_queue = &sk->sk_receive_queue;
+
+	consume_skb(skb);
+
+	spin_lock_bh(&sk_queue->lock);
+	sk_mem_reclaim_partial(sk);
+	spin_unlock_bh(&sk_queue->lock);
+}
+EXPORT_SYMBOL(skb_free_udp);
+
 /**
  *	first_packet_length	- return length of first packet in receive queue
  *	@sk: socket
@@ -1043,15 +1296,19 @@ out:
  */
 static unsigned int first_packet_length(struct sock *sk)
 {
-	struct sk_buff_head list_kill, *rcvq = &sk->sk_receive_queue;
+	struct sk_buff_head list_kill, *rcvq = &udp_sk(sk)->reader_queue;
 	struct sk_buff *skb;
 	unsigned int res;
 
 	__skb_queue_head_init(&list_kill);
 
 	spin_lock_bh(&rcvq->lock);
-	while ((skb = skb_peek(rcvq)) != NULL &&
-		udp_lib_checksum_complete(skb)) {
+	for (;;) {
+		if (skb_queue_empty(rcvq))
+			udp_refill_reader_queue(sk);
+		skb = skb_peek(rcvq);
+		if (!skb || !udp_lib_checksum_complete(skb))
+			break;
 		UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS,
 				 IS_UDPLITE(sk));
 		atomic_inc(&sk->sk_drops);
@@ -1061,12 +1318,8 @@ static unsigned int first_packet_length(struct sock *sk)
 	res = skb ? skb->len : 0;
 	spin_unlock_bh(&rcvq->lock);
 
-	if (!skb_queue_empty(&list_kill)) {
-		lock_sock(sk);
-		__skb_queue_purge(&list_kill);
-		sk_mem_reclaim_partial(sk);
-		release_sock(sk);
-	}
+	/* still charged, their destructor gives the memory back */
+	__skb_queue_purge(&list_kill);
 	return res;
 }
 
@@ -1133,8 +1386,8 @@ int udp_recvmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		return ip_recv_error(sk, msg, len);
 
 try_again:
-	skb = __skb_recv_datagram(sk, flags | (noblock ? MSG_DONTWAIT : 0),
-				  &peeked, &err);
+	skb = __skb_recv_udp(sk, flags | (noblock ? MSG_DONTWAIT : 0),
+			     &peeked, &err);
 	if (!skb)
 		goto out;
 
@@ -1192,15 +1445,13 @@ try_again:
 		err = ulen;
 
 out_free:
-	skb_free_datagram_locked(sk, skb);
+	consume_skb(skb);
 out:
 	return err;
 
 csum_copy_err:
-	lock_sock(sk);
-	if (!skb_kill_datagram(sk, skb, flags))
+	if (!skb_kill_udp(sk, skb, flags))
 		UDP_INC_STATS_USER(sock_net(sk), UDP_MIB_INERRORS, is_udplite);
-	release_sock(sk);
 
 	if (noblock)
 		return -EAGAIN;
@@ -1259,7 +1510,7 @@ EXPORT_SYMBOL(udp_lib_unhash);
 
 static int __udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
-	int rc = sock_queue_rcv_skb(sk, skb);
+	int rc = __udp_enqueue_schedule_skb(sk, skb);
 
 	if (rc < 0) {
 		int is_udplite = IS_UDPLITE(sk);
@@ -1288,7 +1539,6 @@ static int __udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct udp_sock *up = udp_sk(sk);
-	int rc;
 	int is_udplite = IS_UDPLITE(sk);
 
 	/*
@@ -1368,16 +1618,7 @@ int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 			goto drop;
 	}
 
-	rc = 0;
-
-	bh_lock_sock(sk);
-	if (!sock_owned_by_user(sk))
-		rc = __udp_queue_rcv_skb(sk, skb);
-	else
-		sk_add_backlog(sk, skb);
-	bh_unlock_sock(sk);
-
-	return rc;
+	return __udp_queue_rcv_skb(sk, skb);
 
 drop:
 	UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS, is_udplite);
@@ -1612,6 +1853,31 @@ int udp_rcv(struct sk_buff *skb)
 	return __udp4_lib_rcv(skb, &udp_table, IPPROTO_UDP);
 }
 
+/*
+ * Sockets whose recvmsg is udp_recvmsg() or udpv6_recvmsg() must be set up
+ * here, see "UDP receive queue" above.
+ */
+int udp_init_sock(struct sock *sk)
+{
+	skb_queue_head_init(&udp_sk(sk)->reader_queue);
+	sk->sk_destruct = udp_destruct_sock;
+	return 0;
+}
+EXPORT_SYMBOL(udp_init_sock);
+
+void udp_destruct_sock(struct sock *sk)
+{
+	struct udp_sock *up = udp_sk(sk);
+
+	__skb_queue_purge(&up->reader_queue);
+	if (up->forward_deficit) {
+		udp_rmem_uncharge(sk, up->forward_deficit);
+		up->forward_deficit = 0;
+	}
+	inet_sock_destruct(sk);
+}
+EXPORT_SYMBOL(udp_destruct_sock);
+
 void udp_destroy_sock(struct sock *sk)
 {
 	lock_sock(sk);
@@ -1804,6 +2070,9 @@ unsigned int udp_poll(struct file *file, struct socket *sock, poll_table *wait)
 	unsigned int mask = datagram_poll(file, sock, wait);
 	struct sock *sk = sock->sk;
 
+	if (!skb_queue_empty(&udp_sk(sk)->reader_queue))
+		mask |= POLLIN | POLLRDNORM;
+
 	/* Check for false positives due to checksum errors */
 	if ((mask & POLLRDNORM) && !(file->f_flags & O_NONBLOCK) &&
 	    !(sk->sk_shutdown & RCV_SHUTDOWN) && !first_packet_length(sk))
@@ -1821,6 +2090,7 @@ struct proto udp_prot = {
 	.connect	   = ip4_datagram_connect,
 	.disconnect	   = udp_disconnect,
 	.ioctl		   = udp_ioctl,
+	.init		   = udp_init_sock,
 	.destroy	   = udp_destroy_sock,
 	.setsockopt	   = udp_setsockopt,
 	.getsockopt	   = udp_getsockopt,
@@ -157,9 +157,35 @@ struct packet_mreq_max {
 };
 
 #ifdef CONFIG_PACKET_MMAP
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		int closing, int tx_ring);
 
+/* State of a TPACKET_V3 rx ring */
+struct tpacket_kbdq_core {
+	char			**pkbdq;
+	unsigned int		knum_blocks;
+	unsigned int		kblk_size;
+	unsigned int		blk_sizeof_priv;
+
+	unsigned int		kactive_blk_num;
+	unsigned int		last_kactive_blk_num;
+	unsigned char		reset_pending_on_curr_blk;
+	unsigned char		delete_blk_timer;
+
+	char			*pkblk_start;
+	char			*pkblk_end;
+	char			*prev;
+	char			*nxt_offset;
+	u64			knxt_seq_num;
+
+	/* packets being copied into the current block */
+	atomic_t		blk_fill_in_prog;
+
+	unsigned int		retire_blk_tov;
+	unsigned long		tov_in_jiffies;
+	struct timer_list	retire_blk_timer;
+};
+
 struct packet_ring_buffer {
 	char			**pg_vec;
 	unsigned int		head;
@@ -172,6 +198,8 @@ struct packet_ring_buffer {
 	unsigned int		pg_vec_len;
 
 	atomic_t		pending;
+
+	struct tpacket_kbdq_core	prb_bdqc;
 };
 
 struct packet_sock;
@@ -183,7 +211,7 @@ static void packet_flush_mclist(struct sock *sk);
 struct packet_sock {
 	/* struct sock has to be the first member of packet_sock */
 	struct sock		sk;
-	struct tpacket_stats	stats;
+	struct tpacket_stats_v3	stats;
 #ifdef CONFIG_PACKET_MMAP
 	struct packet_ring_buffer	rx_ring;
 	struct packet_ring_buffer	tx_ring;
@@ -313,6 +341,290 @@ static inline void packet_increment_head(struct packet_ring_buffer *buff)
 	buff->head = buff->head != buff->frame_max ? buff->head+1 : 0;
 }
 
+/*
+ * TPACKET_V3: packets are packed into the current block of the rx ring
+ * until the next one does not fit, or the retire timer fires a timeout
+ * after the block was opened with packets in it; then the block is
+ * closed, handed to user space and the next one opened.  If user space still holds that next
+ * block, the ring is frozen and packets are dropped until it is given
+ * back.  All of it runs under the receive queue lock, except copying
+ * the packet data, which blk_fill_in_prog counts so that a block is
+ * only closed once its copies are done.
+ */
+
+#define V3_ALIGNMENT		(8)
+#define BLK_HDR_LEN		(ALIGN(sizeof(struct tpacket_block_desc), \
+				       V3_ALIGNMENT))
+#define BLK_PLUS_PRIV(sz_of_priv) \
+	(BLK_HDR_LEN + ALIGN((sz_of_priv), V3_ALIGNMENT))
+#define TOTAL_PKT_LEN_INCL_ALIGN(length) (ALIGN((length), V3_ALIGNMENT))
+
+#define PRB_DEF_RETIRE_BLK_TOV	(8)	/* msecs */
+
+#define GET_PBDQC_FROM_RB(x)	((struct tpacket_kbdq_core *)(&(x)->prb_bdqc))
+#define GET_PBLOCK_DESC(x, bid)	\
+	((struct tpacket_block_desc *)((x)->pkbdq[(bid)]))
+#define GET_CURR_PBLOCK_DESC_FROM_CORE(x)	\
+	((struct tpacket_block_desc *)((x)->pkbdq[(x)->kactive_blk_num]))
+#define GET_NEXT_PRB_BLK_NUM(x) \
+	(((x)->kactive_blk_num < ((x)->knum_blocks-1)) ? \
+	((x)->kactive_blk_num+1) : 0)
+
+static void prb_retire_rx_blk_timer_expired(unsigned long data);
+
+static void prb_flush_block_desc(struct tpacket_block_desc *pbd)
+{
+	flush_dcache_page(virt_to_page(pbd));
+}
+
+static void _prb_refresh_rx_retire_blk_timer(struct tpacket_kbdq_core *pkc)
+{
+	mod_timer(&pkc->retire_blk_timer, jiffies + pkc->tov_in_jiffies);
+	pkc->last_kactive_blk_num = pkc->kactive_blk_num;
+}
+
+/* Opens pbd, the current block, for packets */
+static void prb_open_block(struct tpacket_kbdq_core *pkc,
+			   struct tpacket_block_desc *pbd)
+{
+	struct tpacket_hdr_v1 *h1 = &pbd->hdr.bh1;
+	struct timespec ts;
+
+	smp_rmb();
+
+	getnstimeofday(&ts);
+
+	pbd->version = TPACKET_V3;
+	pbd->offset_to_priv = BLK_HDR_LEN;
+	h1->seq_num = pkc->knxt_seq_num++;
+	h1->num_pkts = 0;
+	h1->ts_first_pkt.ts_sec = ts.tv_sec;
+	h1->ts_first_pkt.ts_nsec = ts.tv_nsec;
+	h1->ts_last_pkt = h1->ts_first_pkt;
+	h1->offset_to_first_pkt = BLK_PLUS_PRIV(pkc->blk_sizeof_priv);
+	h1->blk_len = h1->offset_to_first_pkt;
+
+	pkc->pkblk_start = (char *)pbd;
+	pkc->nxt_offset = pkc->pkblk_start + h1->offset_to_first_pkt;
+	pkc->prev = pkc->nxt_offset;
+	pkc->pkblk_end = pkc->pkblk_start + pkc->kblk_size;
+
+	pkc->reset_pending_on_curr_blk = 0;
+	_prb_refresh_rx_retire_blk_timer(pkc);
+
+	smp_wmb();
+}
+
+/* Hands pbd, the current block, to user space and moves to the next */
+static void prb_close_block(struct tpacket_kbdq_core *pkc,
+			    struct tpacket_block_desc *pbd,
+			    struct packet_sock *po, unsigned int status)
+{
+	struct tpacket_hdr_v1 *h1 = &pbd->hdr.bh1;
+	struct tpacket3_hdr *last_pkt;
+	struct timespec ts;
+
+	if (po->stats.tp_drops)
+		status |= TP_STATUS_LOSING;
+
+	if (h1->num_pkts) {
+		last_pkt = (struct tpacket3_hdr *)pkc->prev;
+		last_pkt->tp_next_offset = 0;
+		h1->ts_last_pkt.ts_sec = last_pkt->tp_sec;
+		h1->ts_last_pkt.ts_nsec = last_pkt->tp_nsec;
+	} else {
+		getnstimeofday(&ts);
+		h1->ts_first_pkt.ts_sec = ts.tv_sec;
+		h1->ts_first_pkt.ts_nsec = ts.tv_nsec;
+		h1->ts_last_pkt = h1->ts_first_pkt;
+	}
+
+	/* the packets must be visible before the block status */
+	smp_wmb();
+	h1->block_status = status;
+	prb_flush_block_desc(pbd);
+
+	po->sk.sk_data_ready(&po->sk, 0);
+
+	pkc->kactive_blk_num = GET_NEXT_PRB_BLK_NUM(pkc);
+}
+
+static int prb_curr_blk_in_use(struct tpacket_block_desc *pbd)
+{
+	flush_dcache_page(virt_to_page(pbd));
+	smp_rmb();
+	return TP_STATUS_USER & pbd->hdr.bh1.block_status;
+}
+
+/* Opens the next block, or freezes the ring if user space holds it */
+static void *prb_dispatch_next_block(struct tpacket_kbdq_core *pkc,
+				     struct packet_sock *po)
+{
+	struct tpacket_block_desc *pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+
+	if (prb_curr_blk_in_use(pbd)) {
+		pkc->reset_pending_on_curr_blk = 1;
+		po->stats.tp_freeze_q_cnt++;
+		return NULL;
+	}
+
+	prb_open_block(pkc, pbd);
+	return pkc->nxt_offset;
+}
+
+static void prb_retire_current_block(struct tpacket_kbdq_core *pkc,
+				     struct packet_sock *po,
+				     unsigned int status)
+{
+	struct tpacket_block_desc *pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+
+	/* wait for the copies into this block on other CPUs */
+	while (atomic_read(&pkc->blk_fill_in_prog))
+		cpu_relax();
+
+	prb_close_block(pkc, pbd, po, status | TP_STATUS_USER);
+}
+
+/*
+ * Retires the current block if it holds any packets and is still the one
+ * that was current when the timer was armed, however recently the last
+ * packet arrived; this bounds how long a packet waits for user space to
+ * one timeout.  Also reopens a block the ring froze on once user space
+ * gave it back.
+ */
+static void prb_retire_rx_blk_timer_expired(unsigned long data)
+{
+	struct packet_sock *po = (struct packet_sock *)data;
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
+	struct tpacket_block_desc *pbd;
+
+	spin_lock(&po->sk.sk_receive_queue.lock);
+
+	if (unlikely(pkc->delete_blk_timer))
+		goto out;
+
+	pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+
+	if (pkc->reset_pending_on_curr_blk) {
+		if (!prb_curr_blk_in_use(pbd)) {
+			prb_open_block(pkc, pbd);
+			goto out;
+		}
+	} else if (pkc->last_kactive_blk_num == pkc->kactive_blk_num &&
+		   pbd->hdr.bh1.num_pkts) {
+		prb_retire_current_block(pkc, po, TP_STATUS_BLK_TMO);
+		if (prb_dispatch_next_block(pkc, po))
+			goto out;
+	}
+
+	_prb_refresh_rx_retire_blk_timer(pkc);
+out:
+	spin_unlock(&po->sk.sk_receive_queue.lock);
+}
+
+static void prb_fill_curr_block(char *curr, struct tpacket_kbdq_core *pkc,
+				struct tpacket_block_desc *pbd,
+				unsigned int len)
+{
+	struct tpacket3_hdr *ppd = (struct tpacket3_hdr *)curr;
+
+	ppd->tp_next_offset = TOTAL_PKT_LEN_INCL_ALIGN(len);
+	pkc->prev = curr;
+	pkc->nxt_offset += TOTAL_PKT_LEN_INCL_ALIGN(len);
+	pbd->hdr.bh1.blk_len += TOTAL_PKT_LEN_INCL_ALIGN(len);
+	pbd->hdr.bh1.num_pkts++;
+	atomic_inc(&pkc->blk_fill_in_prog);
+}
+
+/*
+ * Reserves len bytes for a packet in the current block, moving to the
+ * next block if needed.  Called with the receive queue lock held; the
+ * caller ends the reservation with prb_clear_blk_fill_status() once the
+ * packet is copied.  Returns NULL if the ring is full.
+ */
+static void *__packet_lookup_frame_in_block(struct packet_sock *po,
+					    unsigned int len)
+{
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
+	struct tpacket_block_desc *pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+	char *curr;
+
+	/* the ring froze on this block, is it back from user space? */
+	if (pkc->reset_pending_on_curr_blk) {
+		if (prb_curr_blk_in_use(pbd))
+			return NULL;
+		prb_open_block(pkc, pbd);
+	}
+
+	curr = pkc->nxt_offset;
+	if (curr + TOTAL_PKT_LEN_INCL_ALIGN(len) <= pkc->pkblk_end) {
+		prb_fill_curr_block(curr, pkc, pbd, len);
+		return curr;
+	}
+
+	prb_retire_current_block(pkc, po, 0);
+	curr = prb_dispatch_next_block(pkc, po);
+	if (curr) {
+		pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+		prb_fill_curr_block(curr, pkc, pbd, len);
+	}
+	return curr;
+}
+
+static void prb_clear_blk_fill_status(struct packet_ring_buffer *rb)
+{
+	atomic_dec(&GET_PBDQC_FROM_RB(rb)->blk_fill_in_prog);
+}
+
+/* The block before the current one, if user space does not hold it */
+static void *prb_previous_blk(struct packet_ring_buffer *rb, int status)
+{
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(rb);
+	unsigned int prev = pkc->kactive_blk_num ?
+			pkc->kactive_blk_num - 1 : pkc->knum_blocks - 1;
+	struct tpacket_block_desc *pbd = GET_PBLOCK_DESC(pkc, prev);
+
+	if (prb_curr_blk_in_use(pbd) != (status & TP_STATUS_USER))
+		return NULL;
+	return pbd;
+}
+
+static void init_prb_bdqc(struct packet_sock *po,
+			  struct packet_ring_buffer *rb,
+			  char **pg_vec, struct tpacket_req3 *req)
+{
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(rb);
+
+	memset(pkc, 0, sizeof(*pkc));
+
+	pkc->pkbdq = pg_vec;
+	pkc->kblk_size = req->tp_block_size;
+	pkc->knum_blocks = req->tp_block_nr;
+	pkc->knxt_seq_num = 1;
+	pkc->blk_sizeof_priv = req->tp_sizeof_priv;
+	pkc->retire_blk_tov = req->tp_retire_blk_tov ?
+			req->tp_retire_blk_tov : PRB_DEF_RETIRE_BLK_TOV;
+	pkc->tov_in_jiffies = msecs_to_jiffies(pkc->retire_blk_tov) ?: 1;
+	po->stats.tp_freeze_q_cnt = 0;
+
+	setup_timer(&pkc->retire_blk_timer, prb_retire_rx_blk_timer_expired,
+		    (unsigned long)po);
+
+	prb_open_block(pkc, GET_PBLOCK_DESC(pkc, 0));
+}
+
+static void prb_shutdown_retire_blk_timer(struct packet_sock *po,
+					  struct sk_buff_head *rb_queue)
+{
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
+
+	spin_lock_bh(&rb_queue->lock);
+	pkc->delete_blk_timer = 1;
+	spin_unlock_bh(&rb_queue->lock);
+
+	del_timer_sync(&pkc->retire_blk_timer);
+}
+
 #endif
 
 static inline struct packet_sock *pkt_sk(struct sock *sk)
@@ -657,6 +969,7 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	union {
 		struct tpacket_hdr *h1;
 		struct tpacket2_hdr *h2;
+		struct tpacket3_hdr *h3;
 		void *raw;
 	} h;
 	u8 *skb_head = skb->data;
@@ -727,10 +1040,15 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	}
 
 	spin_lock(&sk->sk_receive_queue.lock);
-	h.raw = packet_current_frame(po, &po->rx_ring, TP_STATUS_KERNEL);
+	if (po->tp_version == TPACKET_V3)
+		h.raw = __packet_lookup_frame_in_block(po, macoff + snaplen);
+	else
+		h.raw = packet_current_frame(po, &po->rx_ring,
+					     TP_STATUS_KERNEL);
 	if (!h.raw)
 		goto ring_is_full;
-	packet_increment_head(&po->rx_ring);
+	if (po->tp_version != TPACKET_V3)
+		packet_increment_head(&po->rx_ring);
 	po->stats.tp_packets++;
 	if (copy_skb) {
 		status |= TP_STATUS_COPY;
@@ -770,6 +1088,24 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		h.h2->tp_vlan_tci = vlan_tx_tag_get(skb);
 		hdrlen = sizeof(*h.h2);
 		break;
+	case TPACKET_V3:
+		/* tp_next_offset is set by the block code, and the block
+		 * status stands for TP_STATUS_USER */
+		h.h3->tp_status = status & ~TP_STATUS_USER;
+		h.h3->tp_len = skb->len;
+		h.h3->tp_snaplen = snaplen;
+		h.h3->tp_mac = macoff;
+		h.h3->tp_net = netoff;
+		if (skb->tstamp.tv64)
+			ts = ktime_to_timespec(skb->tstamp);
+		else
+			getnstimeofday(&ts);
+		h.h3->tp_sec = ts.tv_sec;
+		h.h3->tp_nsec = ts.tv_nsec;
+		h.h3->hv1.tp_rxhash = 0;
+		h.h3->hv1.tp_vlan_tci = vlan_tx_tag_get(skb);
+		hdrlen = sizeof(*h.h3);
+		break;
 	default:
 		BUG();
 	}
@@ -785,7 +1121,8 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	else
 		sll->sll_ifindex = dev->ifindex;
 
-	__packet_set_status(po, h.raw, status);
+	if (po->tp_version != TPACKET_V3)
+		__packet_set_status(po, h.raw, status);
 	smp_mb();
 	{
 		struct page *p_start, *p_end;
@@ -799,7 +1136,11 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		}
 	}
 
-	sk->sk_data_ready(sk, 0);
+	/* readers of a V3 ring are woken when a block is closed */
+	if (po->tp_version == TPACKET_V3)
+		prb_clear_blk_fill_status(&po->rx_ring);
+	else
+		sk->sk_data_ready(sk, 0);
 
 drop_n_restore:
 	if (skb_head != skb->data && skb_shared(skb)) {
@@ -1172,7 +1513,7 @@ static int packet_release(struct socket *sock)
 	struct packet_sock *po;
 	struct net *net;
 #ifdef CONFIG_PACKET_MMAP
-	struct tpacket_req req;
+	union tpacket_req_u req_u;
 #endif
 
 	if (!sk)
@@ -1203,13 +1544,13 @@ static int packet_release(struct socket *sock)
 	packet_flush_mclist(sk);
 
 #ifdef CONFIG_PACKET_MMAP
-	memset(&req, 0, sizeof(req));
+	memset(&req_u, 0, sizeof(req_u));
 
 	if (po->rx_ring.pg_vec)
-		packet_set_ring(sk, &req, 1, 0);
+		packet_set_ring(sk, &req_u, 1, 0);
 
 	if (po->tx_ring.pg_vec)
-		packet_set_ring(sk, &req, 1, 1);
+		packet_set_ring(sk, &req_u, 1, 1);
 #endif
 
 	/*
@@ -1736,13 +2077,26 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 	case PACKET_RX_RING:
 	case PACKET_TX_RING:
 	{
-		struct tpacket_req req;
+		union tpacket_req_u req_u;
+		int len;
 
-		if (optlen < sizeof(req))
+		switch (po->tp_version) {
+		case TPACKET_V1:
+		case TPACKET_V2:
+			len = sizeof(req_u.req);
+			break;
+		case TPACKET_V3:
+		default:
+			len = sizeof(req_u.req3);
+			break;
+		}
+		if (optlen < len)
 			return -EINVAL;
-		if (copy_from_user(&req, optval, sizeof(req)))
+		memset(&req_u, 0, sizeof(req_u));
+		if (copy_from_user(&req_u, optval, len))
 			return -EFAULT;
-		return packet_set_ring(sk, &req, 0, optname == PACKET_TX_RING);
+		return packet_set_ring(sk, &req_u, 0,
+				       optname == PACKET_TX_RING);
 	}
 	case PACKET_COPY_THRESH:
 	{
@@ -1769,6 +2123,7 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 		switch (val) {
 		case TPACKET_V1:
 		case TPACKET_V2:
+		case TPACKET_V3:
 			po->tp_version = val;
 			return 0;
 		default:
@@ -1839,7 +2194,7 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	struct sock *sk = sock->sk;
 	struct packet_sock *po = pkt_sk(sk);
 	void *data;
-	struct tpacket_stats st;
+	struct tpacket_stats_v3 st;
 
 	if (level != SOL_PACKET)
 		return -ENOPROTOOPT;
@@ -1852,8 +2207,12 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 
 	switch (optname) {
 	case PACKET_STATISTICS:
-		if (len > sizeof(struct tpacket_stats))
+		if (po->tp_version == TPACKET_V3) {
+			if (len > sizeof(struct tpacket_stats_v3))
+				len = sizeof(struct tpacket_stats_v3);
+		} else if (len > sizeof(struct tpacket_stats)) {
 			len = sizeof(struct tpacket_stats);
+		}
 		spin_lock_bh(&sk->sk_receive_queue.lock);
 		st = po->stats;
 		memset(&po->stats, 0, sizeof(st));
@@ -1895,6 +2254,9 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 		case TPACKET_V2:
 			val = sizeof(struct tpacket2_hdr);
 			break;
+		case TPACKET_V3:
+			val = sizeof(struct tpacket3_hdr);
+			break;
 		default:
 			return -EINVAL;
 		}
@@ -2046,8 +2408,13 @@ static unsigned int packet_poll(struct file *file, struct socket *sock,
 
 	spin_lock_bh(&sk->sk_receive_queue.lock);
 	if (po->rx_ring.pg_vec) {
-		if (!packet_previous_frame(po, &po->rx_ring, TP_STATUS_KERNEL))
+		if (po->tp_version == TPACKET_V3) {
+			if (!prb_previous_blk(&po->rx_ring, TP_STATUS_KERNEL))
+				mask |= POLLIN | POLLRDNORM;
+		} else if (!packet_previous_frame(po, &po->rx_ring,
+						  TP_STATUS_KERNEL)) {
 			mask |= POLLIN | POLLRDNORM;
+		}
 	}
 	spin_unlock_bh(&sk->sk_receive_queue.lock);
 	spin_lock_bh(&sk->sk_write_queue.lock);
@@ -2132,9 +2499,10 @@ out_free_pgvec:
 	goto out;
 }
 
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		int closing, int tx_ring)
 {
+	struct tpacket_req *req = &req_u->req;
 	char **pg_vec = NULL;
 	struct packet_sock *po = pkt_sk(sk);
 	int was_running, order = 0;
@@ -2167,6 +2535,9 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		case TPACKET_V2:
 			po->tp_hdrlen = TPACKET2_HDRLEN;
 			break;
+		case TPACKET_V3:
+			po->tp_hdrlen = TPACKET3_HDRLEN;
+			break;
 		}
 
 		err = -EINVAL;
@@ -2186,6 +2557,20 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		if (unlikely((rb->frames_per_block * req->tp_block_nr) !=
 					req->tp_frame_nr))
 			goto out;
+		if (po->tp_version == TPACKET_V3) {
+			/* no tx ring, and a frame of the largest size must
+			 * fit into an empty block */
+			if (unlikely(tx_ring))
+				goto out;
+			if (unlikely(req_u->req3.tp_sizeof_priv >=
+				     req->tp_block_size))
+				goto out;
+			if (unlikely(BLK_PLUS_PRIV(req_u->req3.tp_sizeof_priv) +
+				     req->tp_frame_size > req->tp_block_size))
+				goto out;
+			if (unlikely(req_u->req3.tp_feature_req_word))
+				goto out;
+		}
 
 		err = -ENOMEM;
 		order = get_order(req->tp_block_size);
@@ -2220,12 +2605,17 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 	mutex_lock(&po->pg_vec_lock);
 	if (closing || atomic_read(&po->mapped) == 0) {
 		err = 0;
+		/* a V3 rx ring's block timer must be gone with its pages */
+		if (rb->pg_vec && po->tp_version == TPACKET_V3 && !tx_ring)
+			prb_shutdown_retire_blk_timer(po, rb_queue);
 #define XC(a, b) ({ __typeof__ ((a)) __t; __t = (a); (a) = (b); __t; })
 		spin_lock_bh(&rb_queue->lock);
 		pg_vec = XC(rb->pg_vec, pg_vec);
 		rb->frame_max = (req->tp_frame_nr - 1);
 		rb->head = 0;
 		rb->frame_size = req->tp_frame_size;
+		if (rb->pg_vec && po->tp_version == TPACKET_V3)
+			init_prb_bdqc(po, rb, rb->pg_vec, &req_u->req3);
 		spin_unlock_bh(&rb_queue->lock);
 
 		order = XC(rb->pg_vec_order, order);
@@ -814,7 +814,7 @@ static void xs_udp_data_ready(struct sock *sk, int len)
 	struct rpc_xprt *xprt;
 	struct rpc_rqst *rovr;
 	struct sk_buff *skb;
-	int err, repsize, copied;
+	int err, repsize, copied, peeked;
 	u32 _xid;
 	__be32 *xp;
 
@@ -823,7 +823,7 @@ static void xs_udp_data_ready(struct sock *sk, int len)
 	if (!(xprt = xprt_from_sock(sk)))
 		goto out;
 
-	if ((skb = skb_recv_datagram(sk, 0, 1, &err)) == NULL)
+	if ((skb = __skb_recv_udp(sk, MSG_DONTWAIT, &peeked, &err)) == NULL)
 		goto out;
 
 	if (xprt->shutdown)
@@ -869,7 +869,7 @@ static void xs_udp_data_ready(struct sock *sk, int len)
  out_unlock:
 	spin_unlock(&xprt->transport_lock);
  dropit:
-	skb_free_datagram(sk, skb);
+	skb_free_udp(sk, skb);
  out:
 	read_unlock(&sk->sk_callback_lock);
 }
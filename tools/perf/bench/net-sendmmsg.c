@@ -0,0 +1,237 @@
+/*
+ *
+ * net-sendmmsg.c
+ *
+ * sendmmsg: Benchmark for batched datagram transmit
+ *
+ * Sends the same number of UDP datagrams over the loopback device with
+ * one sendmsg() per datagram and with sendmmsg() batches, and checks
+ * that sendmmsg() reports every datagram it sent.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DATAGRAMS_DEFAULT	1000000
+#define BATCH_DEFAULT		32
+#define BATCH_MAX		1024
+
+static int datagrams = DATAGRAMS_DEFAULT;
+static int batch = BATCH_DEFAULT;
+static int size = 64;
+static int connected;
+
+static const struct option options[] = {
+	OPT_INTEGER('n', "datagrams", &datagrams,
+		    "Specify number of datagrams to send"),
+	OPT_INTEGER('b', "batch", &batch,
+		    "Specify number of datagrams per sendmmsg() call"),
+	OPT_INTEGER('s', "size", &size,
+		    "Specify datagram payload size in bytes"),
+	OPT_BOOLEAN('c', "connected", &connected,
+		    "connect() the socket instead of addressing each datagram"),
+	OPT_END()
+};
+
+static const char * const bench_net_sendmmsg_usage[] = {
+	"perf bench net sendmmsg <options>",
+	NULL
+};
+
+#ifdef __NR_sendmmsg
+
+/* struct mmsghdr of the kernel, libc may not have it */
+struct bench_mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned int	msg_len;
+};
+
+static int sys_sendmmsg(int fd, struct bench_mmsghdr *mmsg,
+			unsigned int vlen, unsigned int flags)
+{
+	return syscall(__NR_sendmmsg, fd, mmsg, vlen, flags);
+}
+
+static double run_sendmsg(int fd, struct bench_mmsghdr *msgs)
+{
+	struct timeval start, stop, diff;
+	int i;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < datagrams; i++) {
+		if (sendmsg(fd, &msgs[0].msg_hdr, 0) < 0) {
+			perror("sendmsg");
+			exit(1);
+		}
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return diff.tv_sec + diff.tv_usec / 1000000.0;
+}
+
+static double run_sendmmsg(int fd, struct bench_mmsghdr *msgs)
+{
+	struct timeval start, stop, diff;
+	int sent = 0, ret, i;
+
+	gettimeofday(&start, NULL);
+	while (sent < datagrams) {
+		int vlen = datagrams - sent < batch ? datagrams - sent : batch;
+
+		for (i = 0; i < vlen; i++)
+			msgs[i].msg_len = 0;
+
+		ret = sys_sendmmsg(fd, msgs, vlen, 0);
+		if (ret < 0) {
+			perror("sendmmsg");
+			exit(1);
+		}
+		if (ret == 0) {
+			fprintf(stderr, "sendmmsg: no datagrams sent\n");
+			exit(1);
+		}
+		/* every datagram sent must have its length filled in */
+		for (i = 0; i < ret; i++) {
+			if (msgs[i].msg_len != (unsigned int)size) {
+				fprintf(stderr, "sendmmsg: datagram %d of %d: "
+					"msg_len %u, expected %d\n",
+					i, ret, msgs[i].msg_len, size);
+				exit(1);
+			}
+		}
+		sent += ret;
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return diff.tv_sec + diff.tv_usec / 1000000.0;
+}
+
+int bench_net_sendmmsg(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	struct bench_mmsghdr *msgs;
+	struct iovec iov;
+	double t_single, t_batch;
+	char *buf;
+	int rx, tx, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_sendmmsg_usage, 0);
+
+	if (datagrams <= 0 || batch <= 0 || batch > BATCH_MAX ||
+	    size <= 0 || size > 65507) {
+		usage_with_options(bench_net_sendmmsg_usage, options);
+		exit(1);
+	}
+
+	/* an unread receiver: datagrams past its buffer are dropped */
+	rx = socket(AF_INET, SOCK_DGRAM, 0);
+	tx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (rx < 0 || tx < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(rx, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(rx, (struct sockaddr *)&addr, &addrlen)) {
+		perror("bind");
+		exit(1);
+	}
+	if (connected &&
+	    connect(tx, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("connect");
+		exit(1);
+	}
+
+	buf = zalloc(size);
+	msgs = zalloc(batch * sizeof(*msgs));
+	if (!buf || !msgs) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	for (i = 0; i < batch; i++) {
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		if (!connected) {
+			msgs[i].msg_hdr.msg_name = &addr;
+			msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+		}
+	}
+
+	t_single = run_sendmsg(tx, msgs);
+	t_batch = run_sendmmsg(tx, msgs);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Sent %d datagrams of %d bytes to %s, "
+		       "%d per sendmmsg() call\n\n",
+		       datagrams, size,
+		       connected ? "a connected socket" : "an address",
+		       batch);
+
+		printf(" %14s: %.3f [sec] %14.3f usecs/datagram\n",
+		       "sendmsg", t_single, t_single * 1000000 / datagrams);
+		printf(" %14s: %.3f [sec] %14.3f usecs/datagram\n",
+		       "sendmmsg", t_batch, t_batch * 1000000 / datagrams);
+		if (t_batch > 0)
+			printf(" %14s: %.2fx\n", "speedup",
+			       t_single / t_batch);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.3f %.3f\n", t_single, t_batch);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(msgs);
+	free(buf);
+	close(tx);
+	close(rx);
+
+	return 0;
+}
+
+#else /* __NR_sendmmsg */
+
+int bench_net_sendmmsg(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	argc = parse_options(argc, argv, options,
+			     bench_net_sendmmsg_usage, 0);
+
+	fprintf(stderr, "sendmmsg() is not wired up on this architecture\n");
+	return 1;
+}
+
+#endif /* __NR_sendmmsg */
@@ -0,0 +1,259 @@
+/*
+ *
+ * net-udp-ingest.c
+ *
+ * udp-ingest: Benchmark for the UDP socket receive path
+ *
+ * Several sender processes, each pinned to its own CPU, send UDP
+ * datagrams over the loopback device to a single socket that one
+ * receiver drains.  Reports how many datagrams per second that one
+ * socket takes in and how many were dropped on the way.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DATAGRAMS_DEFAULT	200000
+
+static int senders;
+static int datagrams = DATAGRAMS_DEFAULT;
+static int size = 64;
+static int rcvbuf;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "senders", &senders,
+		    "Specify number of sender processes (default: CPUs - 1)"),
+	OPT_INTEGER('n', "datagrams", &datagrams,
+		    "Specify number of datagrams per sender"),
+	OPT_INTEGER('s', "size", &size,
+		    "Specify datagram payload size in bytes"),
+	OPT_INTEGER('r', "rcvbuf", &rcvbuf,
+		    "Specify SO_RCVBUF of the receiving socket"),
+	OPT_END()
+};
+
+static const char * const bench_net_udp_ingest_usage[] = {
+	"perf bench net udp-ingest <options>",
+	NULL
+};
+
+static int nr_cpus;
+
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu % nr_cpus, &mask);
+	/* not fatal: the numbers just get noisier */
+	if (sched_setaffinity(0, sizeof(mask), &mask))
+		perror("sched_setaffinity");
+}
+
+static void sender(int cpu, int start_fd, struct sockaddr_in *addr)
+{
+	char *buf, dummy;
+	int fd, i;
+
+	pin_to_cpu(cpu);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	if (connect(fd, (struct sockaddr *)addr, sizeof(*addr))) {
+		perror("connect");
+		exit(1);
+	}
+
+	buf = zalloc(size);
+	if (!buf) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	/* wait for the receiver to start the clock */
+	if (read(start_fd, &dummy, 1) != 1) {
+		perror("read");
+		exit(1);
+	}
+
+	for (i = 0; i < datagrams; i++) {
+		/* a full socket buffer shows up as a drop at the receiver */
+		if (send(fd, buf, size, 0) < 0 && errno != ENOBUFS) {
+			perror("send");
+			exit(1);
+		}
+	}
+
+	exit(0);
+}
+
+int bench_net_udp_ingest(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	struct timeval start, last, diff, timeout;
+	long long total, received = 0;
+	int start_pipe[2];
+	int rx, i, done = 0;
+	double elapsed;
+	char *buf;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_udp_ingest_usage, 0);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_cpus < 1)
+		nr_cpus = 1;
+	if (!senders)
+		senders = nr_cpus > 1 ? nr_cpus - 1 : 1;
+
+	if (senders <= 0 || datagrams <= 0 || rcvbuf < 0 ||
+	    size <= 0 || size > 65507) {
+		usage_with_options(bench_net_udp_ingest_usage, options);
+		exit(1);
+	}
+
+	rx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (rx < 0) {
+		perror("socket");
+		exit(1);
+	}
+	if (rcvbuf &&
+	    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf))) {
+		perror("setsockopt(SO_RCVBUF)");
+		exit(1);
+	}
+
+	/* lets the receiver notice senders that are done */
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 100000;
+	if (setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO,
+		       &timeout, sizeof(timeout))) {
+		perror("setsockopt(SO_RCVTIMEO)");
+		exit(1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(rx, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(rx, (struct sockaddr *)&addr, &addrlen)) {
+		perror("bind");
+		exit(1);
+	}
+
+	if (pipe(start_pipe)) {
+		perror("pipe");
+		exit(1);
+	}
+
+	/* the receiver has CPU 0, senders take the CPUs after it */
+	for (i = 0; i < senders; i++) {
+		switch (fork()) {
+		case -1:
+			perror("fork");
+			exit(1);
+		case 0:
+			close(start_pipe[1]);
+			close(rx);
+			sender(i + 1, start_pipe[0], &addr);
+		default:
+			break;
+		}
+	}
+	close(start_pipe[0]);
+	pin_to_cpu(0);
+
+	buf = zalloc(size);
+	if (!buf) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	total = (long long)senders * datagrams;
+
+	gettimeofday(&start, NULL);
+	last = start;
+	for (i = 0; i < senders; i++) {
+		if (write(start_pipe[1], "x", 1) != 1) {
+			perror("write");
+			exit(1);
+		}
+	}
+
+	while (received < total) {
+		if (recv(rx, buf, size, 0) >= 0) {
+			received++;
+			/* the final idle timeout is not ingest time */
+			gettimeofday(&last, NULL);
+			continue;
+		}
+		if (errno != EAGAIN && errno != EINTR) {
+			perror("recv");
+			exit(1);
+		}
+		/* idle: stop once every sender has finished */
+		while (waitpid(-1, NULL, WNOHANG) > 0)
+			done++;
+		if (done == senders)
+			break;
+	}
+	while (done < senders && wait(NULL) > 0)
+		done++;
+
+	timersub(&last, &start, &diff);
+	elapsed = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d senders sent %d datagrams of %d bytes each "
+		       "to one socket\n\n", senders, datagrams, size);
+
+		printf(" %14s: %lld\n", "received", received);
+		printf(" %14s: %lld (%.2f%%)\n", "dropped",
+		       total - received,
+		       (total - received) * 100.0 / total);
+		printf(" %14s: %.3f [sec]\n", "elapsed", elapsed);
+		if (elapsed > 0)
+			printf(" %14s: %.0f datagrams/sec\n", "ingest rate",
+			       received / elapsed);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lld %lld %.3f\n", received, total - received,
+		       elapsed);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(buf);
+	close(start_pipe[1]);
+	close(rx);
+
+	return 0;
+}
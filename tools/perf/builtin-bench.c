@@ -13,6 +13,7 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  net   ... network stack system calls
  *
  */
 
@@ -58,6 +59,19 @@ static struct bench_suite mem_suites[] = {
 	  NULL             }
 };
 
+static struct bench_suite net_suites[] = {
+	{ "sendmmsg",
+	  "Batched datagram transmit with sendmmsg() against sendmsg()",
+	  bench_net_sendmmsg },
+	{ "udp-ingest",
+	  "UDP datagrams from every CPU into one receiving socket",
+	  bench_net_udp_ingest },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL               }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -71,6 +85,9 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "net",
+	  "network stack system calls",
+	  net_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },